@@ -0,0 +1,104 @@
+#include "AllocationCounter.h"
+
+#include <atomic>
+#include <new>
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+namespace
+{
+    std::atomic<unsigned long long> g_allocationCount(0);
+    std::atomic<unsigned long long> g_allocatedBytes(0);
+
+    void* allocate(size_t size)
+    {
+        g_allocationCount.fetch_add(1, std::memory_order_relaxed);
+        g_allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+
+        void* memory = malloc(size > 0 ? size : 1);
+
+        if (memory == nullptr)
+        {
+            throw std::bad_alloc();
+        }
+
+        return memory;
+    }
+
+    void* allocateAligned(size_t size, std::align_val_t alignment)
+    {
+        g_allocationCount.fetch_add(1, std::memory_order_relaxed);
+        g_allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+
+        size_t const alignmentBytes = static_cast<size_t>(alignment);
+
+#ifdef _WIN32
+        void* memory = _aligned_malloc(size > 0 ? size : 1, alignmentBytes);
+#else
+        // aligned_alloc wants the size to be a multiple of the alignment
+        void* memory = aligned_alloc(alignmentBytes, size > 0 ? (size + alignmentBytes - 1) / alignmentBytes * alignmentBytes : alignmentBytes);
+#endif
+
+        if (memory == nullptr)
+        {
+            throw std::bad_alloc();
+        }
+
+        return memory;
+    }
+
+    void freeAligned(void* memory)
+    {
+#ifdef _WIN32
+        _aligned_free(memory);
+#else
+        free(memory);
+#endif
+    }
+}
+
+// the array and nothrow forms all default to calling these
+void* operator new(size_t size)
+{
+    return allocate(size);
+}
+
+void* operator new(size_t size, std::align_val_t alignment)
+{
+    return allocateAligned(size, alignment);
+}
+
+void operator delete(void* memory) noexcept
+{
+    free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept
+{
+    free(memory);
+}
+
+void operator delete(void* memory, std::align_val_t) noexcept
+{
+    freeAligned(memory);
+}
+
+void operator delete(void* memory, size_t, std::align_val_t) noexcept
+{
+    freeAligned(memory);
+}
+
+namespace Benchmark
+{
+    AllocationTotals getAllocationTotals()
+    {
+        AllocationTotals totals;
+        totals.count = g_allocationCount.load(std::memory_order_relaxed);
+        totals.bytes = g_allocatedBytes.load(std::memory_order_relaxed);
+
+        return totals;
+    }
+}
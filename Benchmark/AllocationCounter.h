@@ -0,0 +1,17 @@
+#ifndef ALLOCATIONCOUNTER_H
+#define ALLOCATIONCOUNTER_H
+
+namespace Benchmark
+{
+    struct AllocationTotals
+    {
+        unsigned long long count;
+        unsigned long long bytes;
+    };
+
+    // running totals kept by the replacement global operator new in AllocationCounter.cpp. Everything allocated with new in
+    // the process goes through it, so the difference across a stage is what that stage allocated
+    AllocationTotals getAllocationTotals();
+}
+
+#endif // ALLOCATIONCOUNTER_H
@@ -0,0 +1,309 @@
+// benchmarks the stages of a conversion on synthetic images: generating the test image, writing and loading it as a
+// bitmap, converting it to glyphs with every instruction set the CPU has, and writing the text out.
+// no dependencies beyond the converter's own sources. On Linux:
+//   g++ -std=c++17 -O2 -pthread Benchmark/*.cpp PictureToAsciiArt/Ascii/CpuFeatures.cpp PictureToAsciiArt/Ascii/GlyphAtlas.cpp
+//       PictureToAsciiArt/Ascii/GlyphRamp.cpp PictureToAsciiArt/Ascii/GlyphRowKernel.cpp PictureToAsciiArt/Ascii/OutputWriter.cpp
+//       PictureToAsciiArt/Ascii/ShapeMatchConverter.cpp PictureToAsciiArt/Bitmap/AreaDownscaler.cpp
+//       PictureToAsciiArt/Bitmap/ImageCanvas.cpp PictureToAsciiArt/Bitmap/ImageFile.cpp
+//       PictureToAsciiArt/Bitmap/MaskedPixelDecoder.cpp PictureToAsciiArt/Instrumentation/StageMetrics.cpp -o Benchmark
+//
+// usage: Benchmark [--size widthxheight]... [--iterations count] [--temp-dir directory] [--json]
+// results go to stdout as CSV, or JSON with --json, one record per stage and image size
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "AllocationCounter.h"
+#include "../PictureToAsciiArt/Ascii/GlyphAtlas.h"
+#include "../PictureToAsciiArt/Ascii/GlyphRamp.h"
+#include "../PictureToAsciiArt/Ascii/GlyphRowKernel.h"
+#include "../PictureToAsciiArt/Ascii/OutputWriter.h"
+#include "../PictureToAsciiArt/Ascii/ShapeMatchConverter.h"
+#include "../PictureToAsciiArt/Bitmap/ImageCanvas.h"
+#include "../PictureToAsciiArt/Bitmap/ImageFile.h"
+#include "../PictureToAsciiArt/Bitmap/ImageView.h"
+
+// the same as the converter
+unsigned int const c_charactersPerPixel = 2;
+
+struct ImageSize
+{
+    unsigned int width;
+    unsigned int height;
+};
+
+struct StageResult
+{
+    std::string stage;
+    ImageSize size;
+
+    unsigned int iterations;
+
+    double bestSeconds;
+    double totalSeconds;
+
+    // what the stage reads or writes in one iteration, for the throughput
+    unsigned long long bytesPerIteration;
+
+    // measured after a warm up iteration, so this is what the stage allocates once it's running steadily
+    double allocationsPerIteration;
+    double allocatedBytesPerIteration;
+};
+
+// times a stage that returns false on failure. One untimed warm up run first, so first touch page faults and buffers
+// growing to size don't count against the steady state
+template<typename STAGE>
+bool runStage(char const* const name, ImageSize size, unsigned int iterations, unsigned long long bytesPerIteration, STAGE const& stage, std::vector<StageResult>& results)
+{
+    if (!stage())
+    {
+        fprintf(stderr, "Stage \"%s\" failed at %u x %u\n", name, size.width, size.height);
+        return false;
+    }
+
+    StageResult result;
+    result.stage = name;
+    result.size = size;
+    result.iterations = iterations;
+    result.bestSeconds = 0.0;
+    result.totalSeconds = 0.0;
+    result.bytesPerIteration = bytesPerIteration;
+
+    Benchmark::AllocationTotals const allocationsBefore = Benchmark::getAllocationTotals();
+
+    for (unsigned int i = 0; i < iterations; ++i)
+    {
+        auto const startTime = std::chrono::steady_clock::now();
+        bool const succeeded = stage();
+        double const elapsedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+        if (!succeeded)
+        {
+            fprintf(stderr, "Stage \"%s\" failed at %u x %u\n", name, size.width, size.height);
+            return false;
+        }
+
+        result.bestSeconds = (i == 0 || elapsedSeconds < result.bestSeconds) ? elapsedSeconds : result.bestSeconds;
+        result.totalSeconds += elapsedSeconds;
+    }
+
+    Benchmark::AllocationTotals const allocationsAfter = Benchmark::getAllocationTotals();
+
+    result.allocationsPerIteration = static_cast<double>(allocationsAfter.count - allocationsBefore.count) / iterations;
+    result.allocatedBytesPerIteration = static_cast<double>(allocationsAfter.bytes - allocationsBefore.bytes) / iterations;
+
+    results.push_back(result);
+
+    return true;
+}
+
+bool benchmarkImageSize(ImageSize size, unsigned int iterations, std::string const& tempDirectory, std::vector<StageResult>& results)
+{
+    std::string const bitmapFileName = tempDirectory + "/benchmark_image.bmp";
+    std::string const textFileName = tempDirectory + "/benchmark_output.txt";
+
+    unsigned long long const pixelBytes = static_cast<unsigned long long>(size.width) * size.height * 3;
+
+    Bitmap::ImageFile imageFile;
+
+    unsigned long long const bitmapBytes = 14 + 40 + static_cast<unsigned long long>(size.width * 3 + imageFile.calculateNumberOfScanlinePaddingBytes(size.width)) * size.height;
+
+    Bitmap::ImageCanvas generated(0, 0);
+    Bitmap::ImageCanvas loaded(0, 0);
+
+    bool succeeded = runStage("generate", size, iterations, pixelBytes, [&]()
+    {
+        generated.resize(size.width, size.height);
+        generated.setCanvasToTestImage();
+        return true;
+    }, results);
+
+    succeeded = succeeded && runStage("bmp_write", size, iterations, bitmapBytes, [&]()
+    {
+        return imageFile.write(bitmapFileName.c_str(), generated) == Bitmap::FileHandlingErrors::OK;
+    }, results);
+
+    succeeded = succeeded && runStage("bmp_load", size, iterations, bitmapBytes, [&]()
+    {
+        return imageFile.load(bitmapFileName.c_str(), loaded) == Bitmap::FileHandlingErrors::OK;
+    }, results);
+
+    if (!succeeded)
+    {
+        return false;
+    }
+
+    Bitmap::ImageView const image = loaded.getTopDownView();
+
+    std::vector<char> text;
+
+    // every instruction set this machine can run, so the vector kernels can be compared against the scalar one
+    Ascii::GlyphRowKernel::InstructionSet const bestAvailable = Ascii::GlyphRowKernel::getBestAvailableInstructionSet();
+    Ascii::GlyphRowKernel::InstructionSet const instructionSets[] = { Ascii::GlyphRowKernel::InstructionSet::Scalar, Ascii::GlyphRowKernel::InstructionSet::Sse2, Ascii::GlyphRowKernel::InstructionSet::Avx2 };
+
+    for (Ascii::GlyphRowKernel::InstructionSet const instructionSet : instructionSets)
+    {
+        if (instructionSet > bestAvailable)
+        {
+            continue;
+        }
+
+        Ascii::GlyphRowKernel const kernel(Ascii::GlyphRamp::getDefault(), c_charactersPerPixel, instructionSet);
+
+        text.resize(static_cast<size_t>(kernel.getLineLength(size.width)) * size.height);
+
+        std::string const stageName = std::string("convert_") + Ascii::GlyphRowKernel::getInstructionSetName(kernel.getInstructionSet());
+
+        succeeded = succeeded && runStage(stageName.c_str(), size, iterations, pixelBytes, [&]()
+        {
+            kernel.convertLines(image, 0, size.height, text.data());
+            return true;
+        }, results);
+    }
+
+    Ascii::OutputWriter writer;
+
+    // shape matching writes through the writer, its text is tiny next to the pixels it reads
+    Ascii::ShapeMatchConverter const shapeConverter(Ascii::GlyphAtlas::getDefault());
+
+    if (succeeded && writer.open(textFileName.c_str()) == Bitmap::FileHandlingErrors::OK)
+    {
+        succeeded = runStage("convert_shapes", size, iterations, pixelBytes, [&]()
+        {
+            shapeConverter.writeLines(image, 0, size.height, writer);
+            return true;
+        }, results);
+
+        succeeded = writer.close() == Bitmap::FileHandlingErrors::OK && succeeded;
+    }
+
+    succeeded = succeeded && runStage("ascii_write", size, iterations, text.size(), [&]()
+    {
+        writer.open(textFileName.c_str());
+        writer.write(text.data(), text.size());
+
+        return writer.close() == Bitmap::FileHandlingErrors::OK;
+    }, results);
+
+    remove(bitmapFileName.c_str());
+    remove(textFileName.c_str());
+
+    return succeeded;
+}
+
+void printCsv(std::vector<StageResult> const& results)
+{
+    printf("stage,width,height,iterations,best_ns_per_pixel,mean_ns_per_pixel,best_mb_per_s,allocations_per_iteration,allocated_bytes_per_iteration\n");
+
+    for (StageResult const& result : results)
+    {
+        double const pixels = static_cast<double>(result.size.width) * result.size.height;
+
+        printf("%s,%u,%u,%u,%.4f,%.4f,%.1f,%.2f,%.0f\n"
+            , result.stage.c_str()
+            , result.size.width
+            , result.size.height
+            , result.iterations
+            , result.bestSeconds * 1e9 / pixels
+            , result.totalSeconds / result.iterations * 1e9 / pixels
+            , result.bytesPerIteration / 1e6 / result.bestSeconds
+            , result.allocationsPerIteration
+            , result.allocatedBytesPerIteration);
+    }
+}
+
+void printJson(std::vector<StageResult> const& results)
+{
+    printf("{\n  \"results\": [\n");
+
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        StageResult const& result = results[i];
+        double const pixels = static_cast<double>(result.size.width) * result.size.height;
+
+        printf("    { \"stage\": \"%s\", \"width\": %u, \"height\": %u, \"iterations\": %u, \"best_ns_per_pixel\": %.4f, \"mean_ns_per_pixel\": %.4f, \"best_mb_per_s\": %.1f, \"allocations_per_iteration\": %.2f, \"allocated_bytes_per_iteration\": %.0f }%s\n"
+            , result.stage.c_str()
+            , result.size.width
+            , result.size.height
+            , result.iterations
+            , result.bestSeconds * 1e9 / pixels
+            , result.totalSeconds / result.iterations * 1e9 / pixels
+            , result.bytesPerIteration / 1e6 / result.bestSeconds
+            , result.allocationsPerIteration
+            , result.allocatedBytesPerIteration
+            , i + 1 < results.size() ? "," : "");
+    }
+
+    printf("  ]\n}\n");
+}
+
+int main(int argc, char* argv[])
+{
+    std::vector<ImageSize> sizes;
+    unsigned int iterations = 10;
+    std::string tempDirectory = ".";
+    bool printAsJson = false;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--size") == 0 && i + 1 < argc)
+        {
+            ImageSize size = { 0, 0 };
+
+            if (sscanf(argv[++i], "%ux%u", &size.width, &size.height) == 2 && size.width > 0 && size.height > 0)
+            {
+                sizes.push_back(size);
+            }
+            else
+            {
+                fprintf(stderr, "Couldn't read the size \"%s\", expected widthxheight\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc)
+        {
+            int const count = atoi(argv[++i]);
+            iterations = count > 0 ? static_cast<unsigned int>(count) : 1;
+        }
+        else if (strcmp(argv[i], "--temp-dir") == 0 && i + 1 < argc)
+        {
+            tempDirectory = argv[++i];
+        }
+        else if (strcmp(argv[i], "--json") == 0)
+        {
+            printAsJson = true;
+        }
+    }
+
+    if (sizes.empty())
+    {
+        sizes.push_back({ 640, 480 });
+        sizes.push_back({ 1920, 1080 });
+    }
+
+    std::vector<StageResult> results;
+
+    for (ImageSize const& size : sizes)
+    {
+        if (!benchmarkImageSize(size, iterations, tempDirectory, results))
+        {
+            return 1;
+        }
+    }
+
+    if (printAsJson)
+    {
+        printJson(results);
+    }
+    else
+    {
+        printCsv(results);
+    }
+
+    return 0;
+}
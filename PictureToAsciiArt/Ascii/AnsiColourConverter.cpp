@@ -0,0 +1,192 @@
+#include "AnsiColourConverter.h"
+
+#include <string.h>
+
+#include "GlyphRamp.h"
+#include "OutputWriter.h"
+#include "XtermPalette.h"
+#include "../Bitmap/Colour.h"
+#include "../Bitmap/ImageView.h"
+#include "../Bitmap/PlaneView.h"
+#include "../Instrumentation/StageMetrics.h"
+
+namespace
+{
+    char const c_resetColour[] = "\x1b[0m";
+
+    // "\x1b[38;2;255;255;255m", the longest escape either mode writes
+    size_t const c_maximumEscapeLength = 19;
+
+    // 0 to 255 without going through printf
+    inline char* writeDecimal(unsigned int value, char* output)
+    {
+        if (value >= 100)
+        {
+            *output++ = static_cast<char>('0' + value / 100);
+        }
+
+        if (value >= 10)
+        {
+            *output++ = static_cast<char>('0' + (value / 10) % 10);
+        }
+
+        *output++ = static_cast<char>('0' + value % 10);
+
+        return output;
+    }
+}
+
+namespace Ascii
+{
+    // no palette index or 24-bit colour packs to this
+    unsigned int const AnsiColourConverter::c_noColour = 0xFFFFFFFFu;
+
+    AnsiColourConverter::AnsiColourConverter(GlyphRamp const& ramp, unsigned int charactersPerPixel, ColourMode colourMode)
+        : m_ramp(&ramp)
+        , m_palette(&XtermPalette::get()) // built here rather than in the middle of the first image
+        , m_charactersPerPixel(charactersPerPixel)
+        , m_colourMode(colourMode)
+    {
+    }
+
+    size_t AnsiColourConverter::getMaximumLineLength(unsigned int width) const
+    {
+        return static_cast<size_t>(width) * (c_maximumEscapeLength + m_charactersPerPixel) + sizeof(c_resetColour) - 1 + 1;
+    }
+
+    size_t AnsiColourConverter::convertRow(Bitmap::Colour const* row, unsigned int width, char* output) const
+    {
+        char* const lineStart = output;
+        unsigned int previousColourKey = c_noColour;
+
+        for (unsigned int x = 0; x < width; ++x)
+        {
+            Bitmap::Colour const& pixel = row[x];
+
+            // the same glyph the plain text gets
+            char const glyph = m_ramp->getGlyph(pixel.blue + pixel.green + pixel.red);
+
+            output = writeCell(getColourKey(pixel.red, pixel.green, pixel.blue), glyph, previousColourKey, output);
+        }
+
+        output = writeLineEnd(output);
+
+        return static_cast<size_t>(output - lineStart);
+    }
+
+    size_t AnsiColourConverter::convertLumaRow(unsigned char const* row, unsigned int width, char* output) const
+    {
+        char* const lineStart = output;
+        unsigned int previousColourKey = c_noColour;
+
+        for (unsigned int x = 0; x < width; ++x)
+        {
+            unsigned char const luma = row[x];
+
+            output = writeCell(getColourKey(luma, luma, luma), m_ramp->getGlyphForLuma(luma), previousColourKey, output);
+        }
+
+        output = writeLineEnd(output);
+
+        return static_cast<size_t>(output - lineStart);
+    }
+
+    template<typename VIEW>
+    void AnsiColourConverter::writeLinesOf(VIEW const& image, unsigned int firstRow, unsigned int rowCount, OutputWriter& writer) const
+    {
+        unsigned int const width = image.getWidth();
+        size_t const maximumLineLength = getMaximumLineLength(width);
+
+        Instrumentation::StageTimer timer(Instrumentation::Stage::GlyphMapping);
+        timer.addPixels(static_cast<unsigned long long>(width) * rowCount);
+
+        // room is reserved for the worst case, only what the line actually took is kept
+        for (unsigned int y = firstRow; y < firstRow + rowCount; ++y)
+        {
+            char* output = writer.reserve(maximumLineLength);
+
+            writer.commit(convertViewRow(image, y, output));
+        }
+    }
+
+    size_t AnsiColourConverter::convertViewRow(Bitmap::ImageView const& image, unsigned int y, char* output) const
+    {
+        return convertRow(image.getRow(y), image.getWidth(), output);
+    }
+
+    size_t AnsiColourConverter::convertViewRow(Bitmap::PlaneView const& lumaPlane, unsigned int y, char* output) const
+    {
+        return convertLumaRow(lumaPlane.getRow(y), lumaPlane.getWidth(), output);
+    }
+
+    void AnsiColourConverter::writeLines(Bitmap::ImageView const& image, unsigned int firstRow, unsigned int rowCount, OutputWriter& writer) const
+    {
+        writeLinesOf(image, firstRow, rowCount, writer);
+    }
+
+    void AnsiColourConverter::writeLines(Bitmap::PlaneView const& lumaPlane, unsigned int firstRow, unsigned int rowCount, OutputWriter& writer) const
+    {
+        writeLinesOf(lumaPlane, firstRow, rowCount, writer);
+    }
+
+    unsigned int AnsiColourConverter::getColourKey(unsigned char red, unsigned char green, unsigned char blue) const
+    {
+        if (m_colourMode == ColourMode::Palette256)
+        {
+            return m_palette->getNearestIndex(red, green, blue);
+        }
+
+        return (static_cast<unsigned int>(red) << 16) | (static_cast<unsigned int>(green) << 8) | blue;
+    }
+
+    char* AnsiColourConverter::writeCell(unsigned int colourKey, char glyph, unsigned int& previousColourKey, char* output) const
+    {
+        if (colourKey != previousColourKey)
+        {
+            *output++ = '\x1b';
+            *output++ = '[';
+            *output++ = '3';
+            *output++ = '8';
+            *output++ = ';';
+
+            if (m_colourMode == ColourMode::Palette256)
+            {
+                *output++ = '5';
+                *output++ = ';';
+                output = writeDecimal(colourKey, output);
+            }
+            else
+            {
+                *output++ = '2';
+                *output++ = ';';
+                output = writeDecimal(colourKey >> 16, output);
+                *output++ = ';';
+                output = writeDecimal((colourKey >> 8) & 0xFF, output);
+                *output++ = ';';
+                output = writeDecimal(colourKey & 0xFF, output);
+            }
+
+            *output++ = 'm';
+
+            previousColourKey = colourKey;
+        }
+
+        for (unsigned int i = 0; i < m_charactersPerPixel; ++i)
+        {
+            *output++ = glyph;
+        }
+
+        return output;
+    }
+
+    char* AnsiColourConverter::writeLineEnd(char* output) const
+    {
+        // nothing bleeds into the next line, or whatever's printed after the image
+        memcpy(output, c_resetColour, sizeof(c_resetColour) - 1);
+        output += sizeof(c_resetColour) - 1;
+
+        *output++ = '\n';
+
+        return output;
+    }
+}
@@ -0,0 +1,75 @@
+#ifndef ANSICOLOURCONVERTER_H
+#define ANSICOLOURCONVERTER_H
+
+#include <stddef.h>
+
+// forward declarations
+namespace Bitmap
+{
+    struct Colour;
+    class ImageView;
+    class PlaneView;
+}
+
+namespace Ascii
+{
+    class GlyphRamp;
+    class OutputWriter;
+    class XtermPalette;
+}
+
+namespace Ascii
+{
+    // converts rows to glyphs from the ramp, each one coloured with the pixel's own colour by an ANSI escape. The escape
+    // is only written when the colour changes from the cell before, so flat areas cost little more than plain text. Every
+    // line ends by resetting the colour. The ramp must outlive the converter
+    class AnsiColourConverter
+    {
+    public:
+        enum class ColourMode
+        {
+            Palette256      // nearest xterm 256 colour, through XtermPalette's lookup table
+            , TrueColour    // 24-bit, exactly the pixel's colour
+        };
+
+        AnsiColourConverter(GlyphRamp const& ramp, unsigned int charactersPerPixel, ColourMode colourMode);
+
+        inline ColourMode getColourMode() const { return m_colourMode; }
+
+        // the longest a line can get, when every cell needs an escape of its own
+        size_t getMaximumLineLength(unsigned int width) const;
+
+        // each writes one whole line, '\n' included, and returns how many characters that took
+        size_t convertRow(Bitmap::Colour const* row, unsigned int width, char* output) const;
+        size_t convertLumaRow(unsigned char const* row, unsigned int width, char* output) const;
+
+        // converts rows [firstRow, firstRow + rowCount) of the image straight into the writer's buffer
+        void writeLines(Bitmap::ImageView const& image, unsigned int firstRow, unsigned int rowCount, OutputWriter& writer) const;
+        void writeLines(Bitmap::PlaneView const& lumaPlane, unsigned int firstRow, unsigned int rowCount, OutputWriter& writer) const;
+
+    private:
+        template<typename VIEW>
+        void writeLinesOf(VIEW const& image, unsigned int firstRow, unsigned int rowCount, OutputWriter& writer) const;
+
+        size_t convertViewRow(Bitmap::ImageView const& image, unsigned int y, char* output) const;
+        size_t convertViewRow(Bitmap::PlaneView const& lumaPlane, unsigned int y, char* output) const;
+
+        // the palette index, or the packed colour
+        unsigned int getColourKey(unsigned char red, unsigned char green, unsigned char blue) const;
+
+        char* writeCell(unsigned int colourKey, char glyph, unsigned int& previousColourKey, char* output) const;
+        char* writeLineEnd(char* output) const;
+
+    private:
+        static unsigned int const c_noColour;
+
+        GlyphRamp const* m_ramp;
+        XtermPalette const* m_palette;
+
+        unsigned int m_charactersPerPixel;
+
+        ColourMode m_colourMode;
+    };
+}
+
+#endif // ANSICOLOURCONVERTER_H
@@ -0,0 +1,23 @@
+#ifndef BAYERMATRIX_H
+#define BAYERMATRIX_H
+
+namespace Ascii
+{
+    // the 8x8 Bayer dither matrix. Every 2x2, 4x4 and 8x8 block of it holds an even spread of ranks, so thresholding a
+    // flat area against it turns on an evenly scattered fraction of the cells
+    class BayerMatrix
+    {
+    public:
+        static unsigned int const c_size = 8;
+        static unsigned int const c_rankCount = c_size * c_size;
+
+        // 0..63, the order cell (x, y) turns on in. Only the bottom three bits of each coordinate are used
+        static constexpr unsigned int getRank(unsigned int x, unsigned int y)
+        {
+            // the recursive construction, interleaving the bits of x ^ y and y
+            return (((x ^ y) & 1) << 5) | ((y & 1) << 4) | (((x ^ y) & 2) << 2) | ((y & 2) << 1) | (((x ^ y) & 4) >> 1) | ((y & 4) >> 2);
+        }
+    };
+}
+
+#endif // BAYERMATRIX_H
@@ -0,0 +1,70 @@
+#include "CpuFeatures.h"
+
+#if ASCII_X86_KERNELS && defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+namespace Ascii
+{
+    bool CpuFeatures::hasSse2()
+    {
+        return getFeatures().sse2;
+    }
+
+    bool CpuFeatures::hasSsse3()
+    {
+        return getFeatures().ssse3;
+    }
+
+    bool CpuFeatures::hasAvx2()
+    {
+        return getFeatures().avx2;
+    }
+
+    bool CpuFeatures::hasPopcnt()
+    {
+        return getFeatures().popcnt;
+    }
+
+    CpuFeatures::Features const& CpuFeatures::getFeatures()
+    {
+        static Features const features;
+        return features;
+    }
+
+    CpuFeatures::Features::Features()
+        : sse2(false)
+        , ssse3(false)
+        , avx2(false)
+        , popcnt(false)
+    {
+#if ASCII_X86_KERNELS && defined(_MSC_VER)
+        int info[4] = { 0, 0, 0, 0 };
+
+        __cpuid(info, 0);
+        int const highestLeaf = info[0];
+
+        __cpuid(info, 1);
+        sse2 = (info[3] & (1 << 26)) != 0;
+        ssse3 = (info[2] & (1 << 9)) != 0;
+        popcnt = (info[2] & (1 << 23)) != 0;
+
+        // AVX2 also needs the OS to save the upper halves of the ymm registers on a context switch
+        bool const osSavesAvxState = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0 && (_xgetbv(0) & 0x6) == 0x6;
+
+        if (highestLeaf >= 7 && osSavesAvxState)
+        {
+            __cpuidex(info, 7, 0);
+            avx2 = (info[1] & (1 << 5)) != 0;
+        }
+#elif ASCII_X86_KERNELS
+        // also checks the OS supports the extended register state
+        __builtin_cpu_init();
+        sse2 = __builtin_cpu_supports("sse2") != 0;
+        ssse3 = __builtin_cpu_supports("ssse3") != 0;
+        avx2 = __builtin_cpu_supports("avx2") != 0;
+        popcnt = __builtin_cpu_supports("popcnt") != 0;
+#endif
+    }
+}
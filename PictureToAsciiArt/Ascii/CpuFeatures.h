@@ -0,0 +1,51 @@
+#ifndef CPUFEATURES_H
+#define CPUFEATURES_H
+
+// the vector kernels are only compiled in for x86 targets, everything else gets the scalar paths
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define ASCII_X86_KERNELS 1
+#else
+#define ASCII_X86_KERNELS 0
+#endif
+
+// gcc and clang need every function using intrinsics above the compile time baseline to be tagged with its
+// target. MSVC lets any function use any intrinsic, so the tags are empty there
+#if ASCII_X86_KERNELS && !defined(_MSC_VER)
+#define ASCII_TARGET_SSE2 __attribute__((target("sse2")))
+#define ASCII_TARGET_SSSE3 __attribute__((target("ssse3")))
+#define ASCII_TARGET_AVX2 __attribute__((target("avx2")))
+#define ASCII_TARGET_POPCNT __attribute__((target("popcnt")))
+#else
+#define ASCII_TARGET_SSE2
+#define ASCII_TARGET_SSSE3
+#define ASCII_TARGET_AVX2
+#define ASCII_TARGET_POPCNT
+#endif
+
+namespace Ascii
+{
+    // runtime detection of the instruction sets the kernels can dispatch to. Results are cached after the first call
+    class CpuFeatures
+    {
+    public:
+        static bool hasSse2();
+        static bool hasSsse3();
+        static bool hasAvx2();
+        static bool hasPopcnt();
+
+    private:
+        struct Features
+        {
+            Features();
+
+            bool sse2;
+            bool ssse3;
+            bool avx2;
+            bool popcnt;
+        };
+
+        static Features const& getFeatures();
+    };
+}
+
+#endif // CPUFEATURES_H
@@ -0,0 +1,140 @@
+#include "ErrorDiffusionConverter.h"
+
+#include <algorithm>
+
+#include "GlyphRamp.h"
+#include "OutputWriter.h"
+#include "../Bitmap/Colour.h"
+#include "../Bitmap/ImageView.h"
+#include "../Bitmap/PlaneView.h"
+#include "../Instrumentation/StageMetrics.h"
+
+namespace Ascii
+{
+    ErrorDiffusionConverter::ErrorDiffusionConverter(GlyphRamp const& ramp, unsigned int charactersPerPixel)
+        : m_ramp(&ramp)
+        , m_charactersPerPixel(charactersPerPixel)
+        , m_maximumLevel(ramp.getGlyphCount() > 0 ? static_cast<int>((ramp.getGlyphCount() - 1) * GlyphRamp::c_levelScale) : 0)
+    {
+        for (unsigned int sum = 0; sum < GlyphRamp::c_channelSumCount; ++sum)
+        {
+            m_sumToLevel[sum] = static_cast<unsigned short>(ramp.getLevel(sum));
+        }
+    }
+
+    void ErrorDiffusionConverter::begin()
+    {
+        std::fill(m_currentErrors.begin(), m_currentErrors.end(), 0);
+        std::fill(m_nextErrors.begin(), m_nextErrors.end(), 0);
+    }
+
+    template<typename VIEW>
+    void ErrorDiffusionConverter::writeLinesOf(VIEW const& image, unsigned int firstRow, unsigned int rowCount, OutputWriter& writer)
+    {
+        unsigned int const lineLength = getLineLength(image.getWidth());
+
+        Instrumentation::StageTimer timer(Instrumentation::Stage::GlyphMapping);
+        timer.addPixels(static_cast<unsigned long long>(image.getWidth()) * rowCount);
+
+        for (unsigned int y = firstRow; y < firstRow + rowCount; ++y)
+        {
+            char* output = writer.reserve(lineLength);
+
+            convertViewRow(image, y, output);
+            output[lineLength - 1] = '\n';
+
+            writer.commit(lineLength);
+        }
+    }
+
+    void ErrorDiffusionConverter::writeLines(Bitmap::ImageView const& image, unsigned int firstRow, unsigned int rowCount, OutputWriter& writer)
+    {
+        writeLinesOf(image, firstRow, rowCount, writer);
+    }
+
+    void ErrorDiffusionConverter::writeLines(Bitmap::PlaneView const& lumaPlane, unsigned int firstRow, unsigned int rowCount, OutputWriter& writer)
+    {
+        writeLinesOf(lumaPlane, firstRow, rowCount, writer);
+    }
+
+    void ErrorDiffusionConverter::convertViewRow(Bitmap::ImageView const& image, unsigned int y, char* output)
+    {
+        convertRow(image.getRow(y), image.getWidth(), output);
+    }
+
+    void ErrorDiffusionConverter::convertViewRow(Bitmap::PlaneView const& lumaPlane, unsigned int y, char* output)
+    {
+        convertLumaRow(lumaPlane.getRow(y), lumaPlane.getWidth(), output);
+    }
+
+    void ErrorDiffusionConverter::convertRow(Bitmap::Colour const* row, unsigned int width, char* output)
+    {
+        prepareRows(width);
+
+        for (unsigned int x = 0; x < width; ++x)
+        {
+            Bitmap::Colour const& pixel = row[x];
+
+            output = diffusePixel(m_sumToLevel[pixel.blue + pixel.green + pixel.red], x, output);
+        }
+
+        finishRow();
+    }
+
+    void ErrorDiffusionConverter::convertLumaRow(unsigned char const* row, unsigned int width, char* output)
+    {
+        prepareRows(width);
+
+        for (unsigned int x = 0; x < width; ++x)
+        {
+            output = diffusePixel(m_sumToLevel[row[x] * 3u], x, output);
+        }
+
+        finishRow();
+    }
+
+    void ErrorDiffusionConverter::prepareRows(unsigned int width)
+    {
+        size_t const entries = static_cast<size_t>(width) + 2;
+
+        if (m_currentErrors.size() != entries)
+        {
+            m_currentErrors.assign(entries, 0);
+            m_nextErrors.assign(entries, 0);
+        }
+    }
+
+    char* ErrorDiffusionConverter::diffusePixel(unsigned int level, unsigned int x, char* output)
+    {
+        int const scale = static_cast<int>(GlyphRamp::c_levelScale);
+
+        // entry x + 1 is pixel x. Rounded to the nearest 256th, the shift floors negative errors too
+        int const value = static_cast<int>(level) + ((m_currentErrors[x + 1] + 8) >> 4);
+
+        // round to the nearest glyph the ramp has
+        int quantised = value > 0 ? (value + scale / 2) / scale * scale : 0;
+        quantised = quantised < m_maximumLevel ? quantised : m_maximumLevel;
+
+        int const error = value - quantised;
+
+        m_currentErrors[x + 2] += error * 7;
+        m_nextErrors[x] += error * 3;
+        m_nextErrors[x + 1] += error * 5;
+        m_nextErrors[x + 2] += error;
+
+        char const glyph = m_ramp->getGlyphs()[quantised / scale];
+
+        for (unsigned int i = 0; i < m_charactersPerPixel; ++i)
+        {
+            *output++ = glyph;
+        }
+
+        return output;
+    }
+
+    void ErrorDiffusionConverter::finishRow()
+    {
+        m_currentErrors.swap(m_nextErrors);
+        std::fill(m_nextErrors.begin(), m_nextErrors.end(), 0);
+    }
+}
@@ -0,0 +1,78 @@
+#ifndef ERRORDIFFUSIONCONVERTER_H
+#define ERRORDIFFUSIONCONVERTER_H
+
+#include <vector>
+
+#include "GlyphRamp.h"
+
+// forward declarations
+namespace Bitmap
+{
+    struct Colour;
+    class ImageView;
+    class PlaneView;
+}
+
+namespace Ascii
+{
+    class OutputWriter;
+}
+
+namespace Ascii
+{
+    // Floyd-Steinberg dithering onto the glyph ramp. Each pixel is rounded to the nearest glyph and what that got wrong, in
+    // 256ths of a glyph, is pushed onto its unconverted neighbours - 7/16 to the right, 3/16, 5/16 and 1/16 onto the row
+    // below. Only two rows of error are ever held, so an image can arrive in blocks as it's streamed in, but the rows do
+    // have to arrive in order, which keeps it to the calling thread. The ramp must outlive the converter
+    class ErrorDiffusionConverter
+    {
+    public:
+        ErrorDiffusionConverter(GlyphRamp const& ramp, unsigned int charactersPerPixel);
+
+        // forgets the error carried from the last image. Call before the first row of each image
+        void begin();
+
+        // a converted row followed by its '\n', the same length as GlyphRowKernel's
+        inline unsigned int getLineLength(unsigned int width) const { return width * m_charactersPerPixel + 1; }
+
+        // rows [firstRow, firstRow + rowCount) of the view, which carry on from the last rows converted since begin
+        void writeLines(Bitmap::ImageView const& image, unsigned int firstRow, unsigned int rowCount, OutputWriter& writer);
+        void writeLines(Bitmap::PlaneView const& lumaPlane, unsigned int firstRow, unsigned int rowCount, OutputWriter& writer);
+
+        void convertRow(Bitmap::Colour const* row, unsigned int width, char* output);
+        void convertLumaRow(unsigned char const* row, unsigned int width, char* output);
+
+    private:
+        template<typename VIEW>
+        void writeLinesOf(VIEW const& image, unsigned int firstRow, unsigned int rowCount, OutputWriter& writer);
+
+        void convertViewRow(Bitmap::ImageView const& image, unsigned int y, char* output);
+        void convertViewRow(Bitmap::PlaneView const& lumaPlane, unsigned int y, char* output);
+
+        // sizes the error rows for the width, clearing them if it changed
+        void prepareRows(unsigned int width);
+
+        // quantises pixel x of the current row, spreads its error and writes its glyph
+        char* diffusePixel(unsigned int level, unsigned int x, char* output);
+
+        // the row below becomes the current one
+        void finishRow();
+
+    private:
+        GlyphRamp const* m_ramp;
+
+        unsigned int m_charactersPerPixel;
+        int m_maximumLevel;
+
+        // the ramp's levels, looked up rather than worked out for every pixel
+        unsigned short m_sumToLevel[GlyphRamp::c_channelSumCount];
+
+        // error waiting for this row and the next. Kept in sixteenths of a 256th of a glyph so spreading it out is just
+        // multiplies, the divide by 16 happens once when a pixel picks it up. One spare entry either side so the edge
+        // pixels don't need special cases
+        std::vector<int> m_currentErrors;
+        std::vector<int> m_nextErrors;
+    };
+}
+
+#endif // ERRORDIFFUSIONCONVERTER_H
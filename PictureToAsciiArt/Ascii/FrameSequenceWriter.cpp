@@ -0,0 +1,160 @@
+#include "FrameSequenceWriter.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "GlyphRowKernel.h"
+#include "OutputWriter.h"
+#include "../Bitmap/ImageView.h"
+
+namespace
+{
+    char const c_hideCursor[] = "\x1b[?25l";
+    char const c_showCursor[] = "\x1b[?25h";
+    char const c_clearScreen[] = "\x1b[2J";
+}
+
+namespace Ascii
+{
+    unsigned int const FrameSequenceWriter::c_maximumRewrittenGap = 8;
+
+    FrameSequenceWriter::FrameSequenceWriter(GlyphRowKernel const& kernel)
+        : m_kernel(&kernel)
+        , m_lineLength(0)
+        , m_rowCount(0)
+        , m_hasPreviousFrame(false)
+        , m_frameCount(0)
+        , m_bytesWritten(0)
+        , m_fullRedrawBytes(0)
+    {
+    }
+
+    void FrameSequenceWriter::begin(OutputWriter& writer)
+    {
+        m_hasPreviousFrame = false;
+
+        m_frameCount = 0;
+        m_bytesWritten = 0;
+        m_fullRedrawBytes = 0;
+
+        writeText(c_hideCursor, sizeof(c_hideCursor) - 1, writer);
+    }
+
+    void FrameSequenceWriter::writeFrame(Bitmap::ImageView const& image, OutputWriter& writer)
+    {
+        unsigned int const lineLength = m_kernel->getLineLength(image.getWidth());
+        unsigned int const rowCount = image.getHeight();
+
+        // capacity is kept from frame to frame, so once the first frame is in this doesn't allocate
+        m_currentFrame.resize(static_cast<size_t>(lineLength) * rowCount);
+        m_kernel->convertLines(image, 0, rowCount, m_currentFrame.data());
+
+        bool const fullRedraw = !m_hasPreviousFrame || lineLength != m_lineLength || rowCount != m_rowCount;
+
+        if (fullRedraw)
+        {
+            writeText(c_clearScreen, sizeof(c_clearScreen) - 1, writer);
+        }
+
+        for (unsigned int row = 0; row < rowCount; ++row)
+        {
+            char const* current = m_currentFrame.data() + static_cast<size_t>(row) * lineLength;
+
+            if (fullRedraw)
+            {
+                writeSpan(row, 0, current, lineLength - 1, writer);
+            }
+            else
+            {
+                char const* previous = m_previousFrame.data() + static_cast<size_t>(row) * lineLength;
+
+                // most rows of a mostly static scene are untouched, don't look any closer at them
+                if (memcmp(previous, current, lineLength - 1) != 0)
+                {
+                    writeRow(row, previous, current, writer);
+                }
+            }
+        }
+
+        writer.flush();
+
+        m_currentFrame.swap(m_previousFrame);
+
+        m_lineLength = lineLength;
+        m_rowCount = rowCount;
+        m_hasPreviousFrame = true;
+
+        ++m_frameCount;
+        m_fullRedrawBytes += static_cast<unsigned long long>(lineLength) * rowCount;
+    }
+
+    void FrameSequenceWriter::end(OutputWriter& writer)
+    {
+        char move[32];
+        int const length = snprintf(move, sizeof(move), "\x1b[%u;1H", m_rowCount + 1);
+
+        writeText(move, static_cast<size_t>(length), writer);
+        writeText(c_showCursor, sizeof(c_showCursor) - 1, writer);
+
+        writer.flush();
+    }
+
+    void FrameSequenceWriter::writeRow(unsigned int row, char const* previous, char const* current, OutputWriter& writer)
+    {
+        unsigned int const columnCount = m_lineLength - 1;
+
+        unsigned int column = 0;
+
+        while (column < columnCount)
+        {
+            // skip up to the next changed cell
+            while (column < columnCount && previous[column] == current[column])
+            {
+                ++column;
+            }
+
+            if (column == columnCount)
+            {
+                break;
+            }
+
+            // the span runs on until there's a gap of unchanged cells big enough to be worth a cursor move
+            unsigned int const spanStart = column;
+            unsigned int spanEnd = column + 1;
+            unsigned int unchangedRun = 0;
+
+            for (column = spanEnd; column < columnCount && unchangedRun <= c_maximumRewrittenGap; ++column)
+            {
+                if (previous[column] == current[column])
+                {
+                    ++unchangedRun;
+                }
+                else
+                {
+                    unchangedRun = 0;
+                    spanEnd = column + 1;
+                }
+            }
+
+            writeSpan(row, spanStart, current + spanStart, spanEnd - spanStart, writer);
+
+            column = spanEnd;
+        }
+    }
+
+    void FrameSequenceWriter::writeSpan(unsigned int row, unsigned int column, char const* glyphs, unsigned int length, OutputWriter& writer)
+    {
+        // rows and columns are counted from 1
+        char move[32];
+        int const moveLength = snprintf(move, sizeof(move), "\x1b[%u;%uH", row + 1, column + 1);
+
+        writeText(move, static_cast<size_t>(moveLength), writer);
+        writeText(glyphs, length, writer);
+    }
+
+    void FrameSequenceWriter::writeText(char const* text, size_t length, OutputWriter& writer)
+    {
+        writer.write(text, length);
+        m_bytesWritten += length;
+    }
+}
@@ -0,0 +1,72 @@
+#ifndef FRAMESEQUENCEWRITER_H
+#define FRAMESEQUENCEWRITER_H
+
+#include <stddef.h>
+#include <vector>
+
+// forward declarations
+namespace Bitmap
+{
+    class ImageView;
+}
+
+namespace Ascii
+{
+    class GlyphRowKernel;
+    class OutputWriter;
+}
+
+namespace Ascii
+{
+    // plays a sequence of frames on an ANSI terminal. The glyphs of the last frame are kept, and each new frame is
+    // compared against them row by row so only the runs of cells that changed are written, each one after a cursor move.
+    // A scene that barely moves costs a few bytes a frame rather than a full redraw
+    class FrameSequenceWriter
+    {
+    public:
+        explicit FrameSequenceWriter(GlyphRowKernel const& kernel);
+
+        FrameSequenceWriter(FrameSequenceWriter const&) = delete;
+        FrameSequenceWriter& operator=(FrameSequenceWriter const&) = delete;
+
+        // hides the cursor. The first frame after this is drawn in full
+        void begin(OutputWriter& writer);
+
+        // frames that change size are drawn in full on a cleared screen. The writer is flushed at the end of every frame
+        void writeFrame(Bitmap::ImageView const& image, OutputWriter& writer);
+
+        // puts the cursor back, on the line below the last frame
+        void end(OutputWriter& writer);
+
+        inline unsigned int getFrameCount() const { return m_frameCount; }
+
+        // what was actually written, against what redrawing every frame in full would have cost
+        inline unsigned long long getBytesWritten() const { return m_bytesWritten; }
+        inline unsigned long long getFullRedrawBytes() const { return m_fullRedrawBytes; }
+
+    private:
+        void writeRow(unsigned int row, char const* previous, char const* current, OutputWriter& writer);
+        void writeSpan(unsigned int row, unsigned int column, char const* glyphs, unsigned int length, OutputWriter& writer);
+        void writeText(char const* text, size_t length, OutputWriter& writer);
+
+    private:
+        // a cursor move is up to this many bytes, so a gap of unchanged cells shorter than this is cheaper to rewrite
+        static unsigned int const c_maximumRewrittenGap;
+
+        GlyphRowKernel const* m_kernel;
+
+        // both frames are the kernel's lines, '\n' included
+        std::vector<char> m_previousFrame;
+        std::vector<char> m_currentFrame;
+
+        unsigned int m_lineLength;
+        unsigned int m_rowCount;
+        bool m_hasPreviousFrame;
+
+        unsigned int m_frameCount;
+        unsigned long long m_bytesWritten;
+        unsigned long long m_fullRedrawBytes;
+    };
+}
+
+#endif // FRAMESEQUENCEWRITER_H
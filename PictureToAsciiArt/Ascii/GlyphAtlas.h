@@ -0,0 +1,69 @@
+#ifndef GLYPHATLAS_H
+#define GLYPHATLAS_H
+
+namespace Ascii
+{
+    // the shapes of the printable ASCII glyphs as 8x16 bitmaps, the size of a classic terminal cell. Each glyph is packed
+    // into 128 bits so comparing it against a cell is two xors and two popcounts. Construction is constexpr like
+    // GlyphRamp's, the built in atlas is packed at compile time
+    class GlyphAtlas
+    {
+    public:
+        static unsigned int const c_cellWidth = 8;
+        static unsigned int const c_cellHeight = 16;
+        static unsigned int const c_cellPixelCount = c_cellWidth * c_cellHeight;
+
+        // ' ' to '~'
+        static unsigned int const c_firstCharacter = 32;
+        static unsigned int const c_characterCount = 95;
+
+        // a cell, one bit per pixel with a set bit for ink. Rows 0-7 are in top and 8-15 in bottom, each row a byte with
+        // the first row in the top byte and the leftmost pixel in the top bit of its byte
+        struct Shape
+        {
+            unsigned long long top;
+            unsigned long long bottom;
+        };
+
+        // a row per byte, leftmost pixel in the top bit, for every character from c_firstCharacter on
+        constexpr explicit GlyphAtlas(unsigned char const (&fontRows)[c_characterCount][c_cellHeight])
+            : m_shapes{}
+            , m_inkCounts{}
+            , m_maximumInkCount(0)
+        {
+            for (unsigned int i = 0; i < c_characterCount; ++i)
+            {
+                for (unsigned int y = 0; y < c_cellHeight; ++y)
+                {
+                    unsigned long long& half = y < 8 ? m_shapes[i].top : m_shapes[i].bottom;
+                    half |= static_cast<unsigned long long>(fontRows[i][y]) << (56 - 8 * (y & 7));
+
+                    for (unsigned char row = fontRows[i][y]; row != 0; row &= row - 1)
+                    {
+                        ++m_inkCounts[i];
+                    }
+                }
+
+                m_maximumInkCount = m_inkCounts[i] > m_maximumInkCount ? m_inkCounts[i] : m_maximumInkCount;
+            }
+        }
+
+        constexpr unsigned int getGlyphCount() const { return c_characterCount; }
+        constexpr char getGlyph(unsigned int index) const { return static_cast<char>(c_firstCharacter + index); }
+        constexpr Shape const& getShape(unsigned int index) const { return m_shapes[index]; }
+
+        // how many pixels of the glyph are set, and the most any glyph has
+        constexpr unsigned int getInkCount(unsigned int index) const { return m_inkCounts[index]; }
+        constexpr unsigned int getMaximumInkCount() const { return m_maximumInkCount; }
+
+        // DejaVu Sans Mono, rasterised to the cell
+        static GlyphAtlas const& getDefault();
+
+    private:
+        Shape m_shapes[c_characterCount];
+        unsigned int m_inkCounts[c_characterCount];
+        unsigned int m_maximumInkCount;
+    };
+}
+
+#endif // GLYPHATLAS_H
@@ -0,0 +1,16 @@
+#include "GlyphRamp.h"
+
+namespace
+{
+    constexpr Ascii::GlyphRamp c_defaultRamp("`^\",:;Il!i~+_-?][}{1)(|\\/tfjrxnuvczXYUJCLQ0OZmwqpdbkhao*#MW&8%B@$");
+
+    static_assert(c_defaultRamp.getGlyphCount() == 65, "the default ramp is built at compile time");
+}
+
+namespace Ascii
+{
+    GlyphRamp const& GlyphRamp::getDefault()
+    {
+        return c_defaultRamp;
+    }
+}
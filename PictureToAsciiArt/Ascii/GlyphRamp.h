@@ -0,0 +1,88 @@
+#ifndef GLYPHRAMP_H
+#define GLYPHRAMP_H
+
+namespace Ascii
+{
+    // a brightness ramp of glyphs, darkest first. The glyph for a pixel only depends on the sum of its three channels,
+    // so the whole mapping is precomputed into a table with one entry per possible sum (0..765). Construction is
+    // constexpr - the built in ramp is baked in at compile time, custom ramps are built once when they're created
+    class GlyphRamp
+    {
+    public:
+        static unsigned int const c_maximumGlyphs = 256;
+        static unsigned int const c_channelSumCount = 255 * 3 + 1;
+
+        constexpr explicit GlyphRamp(char const* const glyphs)
+            : m_glyphs{}
+            , m_glyphCount(measureGlyphs(glyphs))
+            , m_sumToIndex{}
+            , m_sumToGlyph{}
+        {
+            for (unsigned int i = 0; i < m_glyphCount; ++i)
+            {
+                m_glyphs[i] = glyphs[i];
+            }
+
+            for (unsigned int sum = 0; sum < c_channelSumCount; ++sum)
+            {
+                m_sumToIndex[sum] = calculateGlyphIndex(sum, m_glyphCount);
+                m_sumToGlyph[sum] = m_glyphs[m_sumToIndex[sum]];
+            }
+        }
+
+        constexpr char const* getGlyphs() const { return m_glyphs; }
+        constexpr unsigned int getGlyphCount() const { return m_glyphCount; }
+
+        constexpr unsigned char getGlyphIndex(unsigned int channelSum) const { return m_sumToIndex[channelSum]; }
+        constexpr char getGlyph(unsigned int channelSum) const { return m_sumToGlyph[channelSum]; }
+
+        // luma is the average of the channels, so this is the glyph a grey pixel of that value gets
+        constexpr char getGlyphForLuma(unsigned char luma) const { return m_sumToGlyph[luma * 3u]; }
+
+        // how far up the ramp a channel sum sits, in 256ths of a glyph (0 to (glyph count - 1) * 256). The plain mapping
+        // drops the fraction, dithering spreads it around instead
+        constexpr unsigned int getLevel(unsigned int channelSum) const
+        {
+            return m_glyphCount > 0 ? (channelSum * (m_glyphCount - 1) * c_levelScale + (c_channelSumCount - 1) / 2) / (c_channelSumCount - 1) : 0;
+        }
+
+        static unsigned int const c_levelScale = 256;
+
+        // "`^\",:;Il!i~+_-?][}{1)(|\\/tfjrxnuvczXYUJCLQ0OZmwqpdbkhao*#MW&8%B@$"
+        static GlyphRamp const& getDefault();
+
+    private:
+        static constexpr unsigned int measureGlyphs(char const* const glyphs)
+        {
+            // the mapping indexes with an unsigned char, so there's no point holding more glyphs than that can reach
+            unsigned int length = 0;
+
+            while (glyphs[length] != '\0' && length < c_maximumGlyphs)
+            {
+                ++length;
+            }
+
+            return length;
+        }
+
+        // the original per pixel float maths, kept exactly as it was so the table rounds the same way
+        static constexpr unsigned char calculateGlyphIndex(unsigned int channelSum, unsigned int glyphCount)
+        {
+            float const greyscaleAverage = static_cast<float>(channelSum) / 3.0f;
+
+            float const mappedIndex = (greyscaleAverage / 255.0f) * static_cast<float>(glyphCount > 0 ? glyphCount - 1 : 0); // -1 off the length of the string as the mapping is inclusive of the limit
+
+            return static_cast<unsigned char>(mappedIndex);
+        }
+
+    private:
+        // zero padded past the last glyph so the vector kernels can always load whole 16 glyph chunks
+        char m_glyphs[c_maximumGlyphs + 1];
+        unsigned int m_glyphCount;
+
+        unsigned char m_sumToIndex[c_channelSumCount];
+        char m_sumToGlyph[c_channelSumCount];
+    };
+}
+
+#endif // GLYPHRAMP_H
@@ -0,0 +1,459 @@
+#include "GlyphRowKernel.h"
+
+#include "BayerMatrix.h"
+#include "CpuFeatures.h"
+#include "GlyphRamp.h"
+#include "../Bitmap/Colour.h"
+#include "../Bitmap/ImageView.h"
+#include "../Bitmap/PlaneView.h"
+#include "../Instrumentation/StageMetrics.h"
+
+#if ASCII_X86_KERNELS
+#include <emmintrin.h>
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    // the Bayer ranks scaled from 0..63 to a threshold of 0..255 256ths of a glyph with the middle of its step, so a
+    // level's fraction f picks the next glyph up in f of the 64 cells
+    struct BayerThresholds
+    {
+        constexpr BayerThresholds()
+            : thresholds{}
+        {
+            for (unsigned int y = 0; y < Ascii::BayerMatrix::c_size; ++y)
+            {
+                for (unsigned int x = 0; x < Ascii::BayerMatrix::c_size; ++x)
+                {
+                    thresholds[y][x] = static_cast<unsigned char>(Ascii::BayerMatrix::getRank(x, y) * 4 + 2);
+                }
+            }
+        }
+
+        unsigned char thresholds[Ascii::BayerMatrix::c_size][Ascii::BayerMatrix::c_size];
+    };
+
+    constexpr BayerThresholds c_bayerThresholds;
+
+#if ASCII_X86_KERNELS
+
+    // splits 16 packed BGR pixels (48 bytes) into one vector per channel. Only uses SSE2 unpacks, see the 3 channel
+    // v_load_deinterleave in OpenCV's SSE2 intrinsics
+    ASCII_TARGET_SSE2 inline void loadDeinterleaved(unsigned char const* pixels, __m128i& blue, __m128i& green, __m128i& red)
+    {
+        __m128i const t00 = _mm_loadu_si128(reinterpret_cast<__m128i const*>(pixels));
+        __m128i const t01 = _mm_loadu_si128(reinterpret_cast<__m128i const*>(pixels + 16));
+        __m128i const t02 = _mm_loadu_si128(reinterpret_cast<__m128i const*>(pixels + 32));
+
+        __m128i const t10 = _mm_unpacklo_epi8(t00, _mm_unpackhi_epi64(t01, t01));
+        __m128i const t11 = _mm_unpacklo_epi8(_mm_unpackhi_epi64(t00, t00), t02);
+        __m128i const t12 = _mm_unpacklo_epi8(t01, _mm_unpackhi_epi64(t02, t02));
+
+        __m128i const t20 = _mm_unpacklo_epi8(t10, _mm_unpackhi_epi64(t11, t11));
+        __m128i const t21 = _mm_unpacklo_epi8(_mm_unpackhi_epi64(t10, t10), t12);
+        __m128i const t22 = _mm_unpacklo_epi8(t11, _mm_unpackhi_epi64(t12, t12));
+
+        __m128i const t30 = _mm_unpacklo_epi8(t20, _mm_unpackhi_epi64(t21, t21));
+        __m128i const t31 = _mm_unpacklo_epi8(_mm_unpackhi_epi64(t20, t20), t22);
+        __m128i const t32 = _mm_unpacklo_epi8(t21, _mm_unpackhi_epi64(t22, t22));
+
+        blue = _mm_unpacklo_epi8(t30, _mm_unpackhi_epi64(t31, t31));
+        green = _mm_unpacklo_epi8(_mm_unpackhi_epi64(t30, t30), t32);
+        red = _mm_unpacklo_epi8(t31, _mm_unpackhi_epi64(t32, t32));
+    }
+
+#endif
+}
+
+namespace Ascii
+{
+    GlyphRowKernel::GlyphRowKernel(GlyphRamp const& ramp, unsigned int charactersPerPixel)
+        : m_ramp(&ramp)
+        , m_charactersPerPixel(charactersPerPixel)
+        , m_instructionSet(InstructionSet::Scalar)
+        , m_dithering(Dithering::None)
+        , m_indexMultiplier(0)
+        , m_indexShift(0)
+    {
+        initialise(getBestAvailableInstructionSet());
+    }
+
+    GlyphRowKernel::GlyphRowKernel(GlyphRamp const& ramp, unsigned int charactersPerPixel, InstructionSet requestedInstructionSet)
+        : m_ramp(&ramp)
+        , m_charactersPerPixel(charactersPerPixel)
+        , m_instructionSet(InstructionSet::Scalar)
+        , m_dithering(Dithering::None)
+        , m_indexMultiplier(0)
+        , m_indexShift(0)
+    {
+        initialise(requestedInstructionSet);
+    }
+
+    GlyphRowKernel::GlyphRowKernel(GlyphRamp const& ramp, unsigned int charactersPerPixel, InstructionSet requestedInstructionSet, Dithering dithering)
+        : m_ramp(&ramp)
+        , m_charactersPerPixel(charactersPerPixel)
+        , m_instructionSet(InstructionSet::Scalar)
+        , m_dithering(dithering)
+        , m_indexMultiplier(0)
+        , m_indexShift(0)
+    {
+        initialise(dithering == Dithering::None ? requestedInstructionSet : InstructionSet::Scalar);
+    }
+
+    void GlyphRowKernel::initialise(InstructionSet requestedInstructionSet)
+    {
+        InstructionSet const bestAvailable = getBestAvailableInstructionSet();
+
+        if (requestedInstructionSet > bestAvailable)
+        {
+            requestedInstructionSet = bestAvailable;
+        }
+
+        // the vector kernels only handle one or two characters per pixel
+        bool const vectorisable = m_ramp->getGlyphCount() > 0 && (m_charactersPerPixel == 1 || m_charactersPerPixel == 2) && findIntegerIndexMapping();
+
+        m_instructionSet = vectorisable ? requestedInstructionSet : InstructionSet::Scalar;
+    }
+
+    bool GlyphRowKernel::findIntegerIndexMapping()
+    {
+        // look for a 16-bit fixed point multiplier so (sum * multiplier) >> (16 + shift) matches the ramp's table for every
+        // channel sum. Works for most ramp lengths, the ones it doesn't just stay on the scalar path
+        unsigned int const maximumChannelSum = GlyphRamp::c_channelSumCount - 1;
+        unsigned int const glyphCount = m_ramp->getGlyphCount();
+
+        for (int shift = 0; shift < 8; ++shift)
+        {
+            unsigned long long const scale = 1ull << (16 + shift);
+            unsigned long long const multiplier = ((glyphCount - 1) * scale + maximumChannelSum - 1) / maximumChannelSum;
+
+            if (multiplier > 0xFFFF)
+            {
+                break;
+            }
+
+            bool matches = true;
+
+            for (unsigned int sum = 0; sum <= maximumChannelSum && matches; ++sum)
+            {
+                matches = ((sum * multiplier) >> (16 + shift)) == m_ramp->getGlyphIndex(sum);
+            }
+
+            if (matches)
+            {
+                m_indexMultiplier = static_cast<unsigned short>(multiplier);
+                m_indexShift = shift;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    void GlyphRowKernel::convertRow(Bitmap::Colour const* row, unsigned int width, char* output) const
+    {
+        unsigned int converted = 0;
+
+        switch (m_instructionSet)
+        {
+        case InstructionSet::Avx2:
+            converted = convertRowAvx2(row, width, output);
+            break;
+        case InstructionSet::Sse2:
+            converted = convertRowSse2(row, width, output);
+            break;
+        case InstructionSet::Scalar:
+            break;
+        }
+
+        // whatever didn't fill a whole vector
+        convertRowScalar(row + converted, width - converted, output + converted * m_charactersPerPixel);
+    }
+
+    void GlyphRowKernel::convertLumaRow(unsigned char const* row, unsigned int width, char* output) const
+    {
+        for (unsigned int x = 0; x < width; ++x)
+        {
+            char const glyph = m_ramp->getGlyphForLuma(row[x]);
+
+            for (unsigned int i = 0; i < m_charactersPerPixel; ++i)
+            {
+                *output++ = glyph;
+            }
+        }
+    }
+
+    void GlyphRowKernel::convertLines(Bitmap::ImageView const& image, unsigned int firstRow, unsigned int rowCount, char* output) const
+    {
+        unsigned int const width = image.getWidth();
+        unsigned int const lineLength = getLineLength(width);
+
+        Instrumentation::StageTimer timer(Instrumentation::Stage::GlyphMapping);
+        timer.addPixels(static_cast<unsigned long long>(width) * rowCount);
+
+        for (unsigned int y = firstRow; y < firstRow + rowCount; ++y)
+        {
+            if (m_dithering == Dithering::Ordered)
+            {
+                convertRowOrdered(image.getRow(y), width, y, output);
+            }
+            else
+            {
+                convertRow(image.getRow(y), width, output);
+            }
+
+            output[lineLength - 1] = '\n';
+
+            output += lineLength;
+        }
+    }
+
+    void GlyphRowKernel::convertLines(Bitmap::PlaneView const& lumaPlane, unsigned int firstRow, unsigned int rowCount, char* output) const
+    {
+        unsigned int const width = lumaPlane.getWidth();
+        unsigned int const lineLength = getLineLength(width);
+
+        Instrumentation::StageTimer timer(Instrumentation::Stage::GlyphMapping);
+        timer.addPixels(static_cast<unsigned long long>(width) * rowCount);
+
+        for (unsigned int y = firstRow; y < firstRow + rowCount; ++y)
+        {
+            if (m_dithering == Dithering::Ordered)
+            {
+                convertLumaRowOrdered(lumaPlane.getRow(y), width, y, output);
+            }
+            else
+            {
+                convertLumaRow(lumaPlane.getRow(y), width, output);
+            }
+
+            output[lineLength - 1] = '\n';
+
+            output += lineLength;
+        }
+    }
+
+    void GlyphRowKernel::convertRowScalar(Bitmap::Colour const* row, unsigned int width, char* output) const
+    {
+        for (unsigned int x = 0; x < width; ++x)
+        {
+            Bitmap::Colour const& pixel = row[x];
+
+            char const glyph = m_ramp->getGlyph(pixel.blue + pixel.green + pixel.red);
+
+            for (unsigned int i = 0; i < m_charactersPerPixel; ++i)
+            {
+                *output++ = glyph;
+            }
+        }
+    }
+
+    void GlyphRowKernel::convertRowOrdered(Bitmap::Colour const* row, unsigned int width, unsigned int y, char* output) const
+    {
+        char const* const glyphs = m_ramp->getGlyphs();
+        unsigned char const* const thresholds = c_bayerThresholds.thresholds[y & 7];
+
+        // the threshold is under one glyph, so even the top level can't step past the last glyph
+        for (unsigned int x = 0; x < width; ++x)
+        {
+            Bitmap::Colour const& pixel = row[x];
+
+            char const glyph = glyphs[(m_ramp->getLevel(pixel.blue + pixel.green + pixel.red) + thresholds[x & 7]) / GlyphRamp::c_levelScale];
+
+            for (unsigned int i = 0; i < m_charactersPerPixel; ++i)
+            {
+                *output++ = glyph;
+            }
+        }
+    }
+
+    void GlyphRowKernel::convertLumaRowOrdered(unsigned char const* row, unsigned int width, unsigned int y, char* output) const
+    {
+        char const* const glyphs = m_ramp->getGlyphs();
+        unsigned char const* const thresholds = c_bayerThresholds.thresholds[y & 7];
+
+        for (unsigned int x = 0; x < width; ++x)
+        {
+            char const glyph = glyphs[(m_ramp->getLevel(row[x] * 3u) + thresholds[x & 7]) / GlyphRamp::c_levelScale];
+
+            for (unsigned int i = 0; i < m_charactersPerPixel; ++i)
+            {
+                *output++ = glyph;
+            }
+        }
+    }
+
+#if ASCII_X86_KERNELS
+
+    ASCII_TARGET_SSE2 unsigned int GlyphRowKernel::convertRowSse2(Bitmap::Colour const* row, unsigned int width, char* output) const
+    {
+        unsigned char const* pixels = reinterpret_cast<unsigned char const*>(row);
+        char const* const glyphs = m_ramp->getGlyphs();
+
+        __m128i const multiplier = _mm_set1_epi16(static_cast<short>(m_indexMultiplier));
+        __m128i const shift = _mm_cvtsi32_si128(m_indexShift);
+        __m128i const zero = _mm_setzero_si128();
+
+        unsigned int x = 0;
+
+        for (; x + 16 <= width; x += 16)
+        {
+            __m128i blue, green, red;
+            loadDeinterleaved(pixels + x * 3, blue, green, red);
+
+            __m128i const sumsLow = _mm_add_epi16(_mm_add_epi16(_mm_unpacklo_epi8(blue, zero), _mm_unpacklo_epi8(green, zero)), _mm_unpacklo_epi8(red, zero));
+            __m128i const sumsHigh = _mm_add_epi16(_mm_add_epi16(_mm_unpackhi_epi8(blue, zero), _mm_unpackhi_epi8(green, zero)), _mm_unpackhi_epi8(red, zero));
+
+            __m128i const indicesLow = _mm_srl_epi16(_mm_mulhi_epu16(sumsLow, multiplier), shift);
+            __m128i const indicesHigh = _mm_srl_epi16(_mm_mulhi_epu16(sumsHigh, multiplier), shift);
+
+            // SSE2 has no byte shuffle, so the glyph lookup itself is done a lane at a time
+            unsigned char indices[16];
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(indices), _mm_packus_epi16(indicesLow, indicesHigh));
+
+            if (m_charactersPerPixel == 2)
+            {
+                for (int i = 0; i < 16; ++i)
+                {
+                    output[2 * i] = output[2 * i + 1] = glyphs[indices[i]];
+                }
+
+                output += 32;
+            }
+            else
+            {
+                for (int i = 0; i < 16; ++i)
+                {
+                    output[i] = glyphs[indices[i]];
+                }
+
+                output += 16;
+            }
+        }
+
+        return x;
+    }
+
+    ASCII_TARGET_AVX2 unsigned int GlyphRowKernel::convertRowAvx2(Bitmap::Colour const* row, unsigned int width, char* output) const
+    {
+        unsigned char const* pixels = reinterpret_cast<unsigned char const*>(row);
+        char const* const glyphs = m_ramp->getGlyphs();
+
+        __m256i const multiplier = _mm256_set1_epi16(static_cast<short>(m_indexMultiplier));
+        __m128i const shift = _mm_cvtsi32_si128(m_indexShift);
+
+        // the ramp split into 16 glyph chunks, each duplicated into both lanes for vpshufb
+        unsigned int const chunkCount = (m_ramp->getGlyphCount() + 15) / 16;
+        __m256i glyphChunks[GlyphRamp::c_maximumGlyphs / 16];
+
+        for (unsigned int chunk = 0; chunk < chunkCount; ++chunk)
+        {
+            glyphChunks[chunk] = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<__m128i const*>(glyphs + chunk * 16)));
+        }
+
+        __m256i const fifteen = _mm256_set1_epi8(15);
+        __m256i const sixteen = _mm256_set1_epi8(16);
+
+        unsigned int x = 0;
+
+        for (; x + 32 <= width; x += 32)
+        {
+            __m128i blue0, green0, red0, blue1, green1, red1;
+            loadDeinterleaved(pixels + x * 3, blue0, green0, red0);
+            loadDeinterleaved(pixels + x * 3 + 48, blue1, green1, red1);
+
+            __m256i const sums0 = _mm256_add_epi16(_mm256_add_epi16(_mm256_cvtepu8_epi16(blue0), _mm256_cvtepu8_epi16(green0)), _mm256_cvtepu8_epi16(red0));
+            __m256i const sums1 = _mm256_add_epi16(_mm256_add_epi16(_mm256_cvtepu8_epi16(blue1), _mm256_cvtepu8_epi16(green1)), _mm256_cvtepu8_epi16(red1));
+
+            __m256i const indices0 = _mm256_srl_epi16(_mm256_mulhi_epu16(sums0, multiplier), shift);
+            __m256i const indices1 = _mm256_srl_epi16(_mm256_mulhi_epu16(sums1, multiplier), shift);
+
+            // packus works within each 128-bit lane, put the 64-bit quarters back in pixel order
+            __m256i const indices = _mm256_permute4x64_epi64(_mm256_packus_epi16(indices0, indices1), 0xD8);
+
+            // for each chunk, lanes whose index falls outside it get their top bit set so vpshufb writes a zero for them
+            __m256i rowGlyphs = _mm256_setzero_si256();
+            __m256i chunkIndices = indices;
+
+            for (unsigned int chunk = 0; chunk < chunkCount; ++chunk)
+            {
+                __m256i const outOfChunk = _mm256_cmpgt_epi8(chunkIndices, fifteen);
+                rowGlyphs = _mm256_or_si256(rowGlyphs, _mm256_shuffle_epi8(glyphChunks[chunk], _mm256_or_si256(chunkIndices, outOfChunk)));
+
+                chunkIndices = _mm256_sub_epi8(chunkIndices, sixteen);
+            }
+
+            if (m_charactersPerPixel == 2)
+            {
+                __m256i const doubledLow = _mm256_unpacklo_epi8(rowGlyphs, rowGlyphs);
+                __m256i const doubledHigh = _mm256_unpackhi_epi8(rowGlyphs, rowGlyphs);
+
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(output), _mm256_permute2x128_si256(doubledLow, doubledHigh, 0x20));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(output + 32), _mm256_permute2x128_si256(doubledLow, doubledHigh, 0x31));
+
+                output += 64;
+            }
+            else
+            {
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(output), rowGlyphs);
+
+                output += 32;
+            }
+        }
+
+        // finish off with 16 at a time before dropping to scalar
+        return x + convertRowSse2(row + x, width - x, output);
+    }
+
+#else
+
+    unsigned int GlyphRowKernel::convertRowSse2(Bitmap::Colour const*, unsigned int, char*) const
+    {
+        return 0;
+    }
+
+    unsigned int GlyphRowKernel::convertRowAvx2(Bitmap::Colour const*, unsigned int, char*) const
+    {
+        return 0;
+    }
+
+#endif
+
+    GlyphRowKernel::InstructionSet GlyphRowKernel::getBestAvailableInstructionSet()
+    {
+        InstructionSet best = InstructionSet::Scalar;
+
+#if ASCII_X86_KERNELS
+        if (CpuFeatures::hasAvx2())
+        {
+            best = InstructionSet::Avx2;
+        }
+        else if (CpuFeatures::hasSse2())
+        {
+            best = InstructionSet::Sse2;
+        }
+#endif
+
+        return best;
+    }
+
+    char const* GlyphRowKernel::getInstructionSetName(InstructionSet instructionSet)
+    {
+        char const* name = "scalar";
+
+        switch (instructionSet)
+        {
+        case InstructionSet::Avx2:
+            name = "avx2";
+            break;
+        case InstructionSet::Sse2:
+            name = "sse2";
+            break;
+        case InstructionSet::Scalar:
+            break;
+        }
+
+        return name;
+    }
+}
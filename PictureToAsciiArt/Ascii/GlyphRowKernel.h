@@ -0,0 +1,94 @@
+#ifndef GLYPHROWKERNEL_H
+#define GLYPHROWKERNEL_H
+
+// forward declarations
+namespace Bitmap
+{
+    struct Colour;
+    class ImageView;
+    class PlaneView;
+}
+
+namespace Ascii
+{
+    class GlyphRamp;
+}
+
+namespace Ascii
+{
+    // maps a whole row of pixels onto glyphs from a GlyphRamp. The scalar path is a table lookup on the channel sum, the
+    // vector kernels compute the glyph index in integer arithmetic and are only used when that is proven to pick exactly
+    // the same glyph as the ramp's table for every possible pixel. The ramp must outlive the kernel
+    class GlyphRowKernel
+    {
+    public:
+        enum class InstructionSet
+        {
+            Scalar
+            , Sse2
+            , Avx2
+        };
+
+        enum class Dithering
+        {
+            None
+            , Ordered   // an 8x8 Bayer threshold on the fraction of a glyph the plain mapping drops
+        };
+
+        // uses the best instruction set the CPU supports
+        GlyphRowKernel(GlyphRamp const& ramp, unsigned int charactersPerPixel);
+
+        // falls back towards Scalar if the requested instruction set isn't available or can't reproduce the ramp exactly
+        GlyphRowKernel(GlyphRamp const& ramp, unsigned int charactersPerPixel, InstructionSet requestedInstructionSet);
+
+        // ordered dithering always takes the scalar path. The pattern follows the row number within the view, so rows
+        // still convert independently and bands come out the same as converting the whole image in one go
+        GlyphRowKernel(GlyphRamp const& ramp, unsigned int charactersPerPixel, InstructionSet requestedInstructionSet, Dithering dithering);
+
+        inline GlyphRamp const& getRamp() const { return *m_ramp; }
+        inline InstructionSet getInstructionSet() const { return m_instructionSet; }
+        inline unsigned int getCharactersPerPixel() const { return m_charactersPerPixel; }
+        inline Dithering getDithering() const { return m_dithering; }
+
+        // writes width * getCharactersPerPixel() characters to output, each glyph repeated for every character of the pixel
+        void convertRow(Bitmap::Colour const* row, unsigned int width, char* output) const;
+
+        // a converted row followed by its '\n'
+        inline unsigned int getLineLength(unsigned int width) const { return width * m_charactersPerPixel + 1; }
+
+        // the same for a row of a luma plane. Always a table lookup, there's nothing to deinterleave or sum
+        void convertLumaRow(unsigned char const* row, unsigned int width, char* output) const;
+
+        // converts rows [firstRow, firstRow + rowCount) of the image as consecutive lines of text
+        void convertLines(Bitmap::ImageView const& image, unsigned int firstRow, unsigned int rowCount, char* output) const;
+        void convertLines(Bitmap::PlaneView const& lumaPlane, unsigned int firstRow, unsigned int rowCount, char* output) const;
+
+        static InstructionSet getBestAvailableInstructionSet();
+        static char const* getInstructionSetName(InstructionSet instructionSet);
+
+    private:
+        void initialise(InstructionSet requestedInstructionSet);
+
+        bool findIntegerIndexMapping();
+
+        void convertRowScalar(Bitmap::Colour const* row, unsigned int width, char* output) const;
+        void convertRowOrdered(Bitmap::Colour const* row, unsigned int width, unsigned int y, char* output) const;
+        void convertLumaRowOrdered(unsigned char const* row, unsigned int width, unsigned int y, char* output) const;
+        unsigned int convertRowSse2(Bitmap::Colour const* row, unsigned int width, char* output) const;
+        unsigned int convertRowAvx2(Bitmap::Colour const* row, unsigned int width, char* output) const;
+
+    private:
+        GlyphRamp const* m_ramp;
+
+        unsigned int m_charactersPerPixel;
+
+        InstructionSet m_instructionSet;
+        Dithering m_dithering;
+
+        // glyph index == (channelSum * m_indexMultiplier) >> (16 + m_indexShift)
+        unsigned short m_indexMultiplier;
+        int m_indexShift;
+    };
+}
+
+#endif // GLYPHROWKERNEL_H
@@ -0,0 +1,214 @@
+#include "OutputWriter.h"
+
+#include <string.h>
+
+#include "GlyphRowKernel.h"
+#include "../Bitmap/ImageView.h"
+#include "../Bitmap/PlaneView.h"
+#include "../Bitmap/PortableStdio.h"
+#include "../Instrumentation/StageMetrics.h"
+
+namespace Ascii
+{
+    OutputWriter::OutputWriter(size_t bufferSize)
+        : m_file(nullptr)
+        , m_ownsFile(false)
+        , m_memory(nullptr)
+        , m_buffer(bufferSize > 0 ? bufferSize : 1)
+        , m_bufferUsed(0)
+        , m_error(Bitmap::FileHandlingErrors::OK)
+    {
+    }
+
+    OutputWriter::~OutputWriter()
+    {
+        close();
+    }
+
+    Bitmap::FileHandlingErrors OutputWriter::open(char const* const filename)
+    {
+        close();
+
+        errno_t fileError = fopen_s(&m_file, filename, "w");
+
+        if (m_file == nullptr || fileError != 0)
+        {
+            m_file = nullptr;
+            return Bitmap::FileHandlingErrors::UnableToOpenFile;
+        }
+
+        // we only ever hand stdio big blocks, its own buffer would just be an extra copy
+        setvbuf(m_file, nullptr, _IONBF, 0);
+
+        m_ownsFile = true;
+        m_bufferUsed = 0;
+        m_error = Bitmap::FileHandlingErrors::OK;
+
+        return m_error;
+    }
+
+    Bitmap::FileHandlingErrors OutputWriter::openStandardOutput()
+    {
+        close();
+
+        m_file = stdout;
+        m_ownsFile = false;
+        m_bufferUsed = 0;
+        m_error = Bitmap::FileHandlingErrors::OK;
+
+        return m_error;
+    }
+
+    Bitmap::FileHandlingErrors OutputWriter::openMemory(std::vector<char>& destination)
+    {
+        close();
+
+        m_memory = &destination;
+        m_bufferUsed = 0;
+        m_error = Bitmap::FileHandlingErrors::OK;
+
+        return m_error;
+    }
+
+    Bitmap::FileHandlingErrors OutputWriter::close()
+    {
+        Bitmap::FileHandlingErrors toReturn = Bitmap::FileHandlingErrors::OK;
+
+        if (m_memory)
+        {
+            flush();
+
+            m_memory = nullptr;
+            toReturn = m_error;
+        }
+
+        if (m_file)
+        {
+            flush();
+
+            // closing can still have to wait on the disk
+            Instrumentation::StageTimer timer(Instrumentation::Stage::OutputWrite);
+
+            int const closeResult = m_ownsFile ? fclose(m_file) : fflush(m_file);
+
+            if (closeResult != 0 && m_error == Bitmap::FileHandlingErrors::OK)
+            {
+                m_error = Bitmap::FileHandlingErrors::UnknownWriteError;
+            }
+
+            m_file = nullptr;
+            toReturn = m_error;
+        }
+
+        return toReturn;
+    }
+
+    void OutputWriter::discard()
+    {
+        m_bufferUsed = 0;
+        m_memory = nullptr;
+
+        close();
+    }
+
+    char* OutputWriter::reserve(size_t length)
+    {
+        if (m_buffer.size() - m_bufferUsed < length)
+        {
+            flush();
+
+            // a single request bigger than the whole buffer - grow once and keep it
+            if (m_buffer.size() < length)
+            {
+                m_buffer.resize(length);
+            }
+        }
+
+        return m_buffer.data() + m_bufferUsed;
+    }
+
+    void OutputWriter::commit(size_t length)
+    {
+        m_bufferUsed += length;
+    }
+
+    void OutputWriter::write(char const* data, size_t length)
+    {
+        if (length >= m_buffer.size())
+        {
+            flush();
+            writeToFile(data, length);
+        }
+        else
+        {
+            memcpy(reserve(length), data, length);
+            commit(length);
+        }
+    }
+
+    template<typename VIEW>
+    void OutputWriter::writeLinesOf(GlyphRowKernel const& kernel, VIEW const& image, unsigned int firstRow, unsigned int rowCount)
+    {
+        size_t const lineLength = kernel.getLineLength(image.getWidth());
+
+        while (rowCount > 0)
+        {
+            char* output = reserve(lineLength);
+
+            // as many whole lines as fit in what's left of the buffer
+            size_t const linesThatFit = (m_buffer.size() - m_bufferUsed) / lineLength;
+            unsigned int const linesToWrite = linesThatFit < rowCount ? static_cast<unsigned int>(linesThatFit) : rowCount;
+
+            kernel.convertLines(image, firstRow, linesToWrite, output);
+            commit(linesToWrite * lineLength);
+
+            firstRow += linesToWrite;
+            rowCount -= linesToWrite;
+        }
+    }
+
+    void OutputWriter::writeLines(GlyphRowKernel const& kernel, Bitmap::ImageView const& image, unsigned int firstRow, unsigned int rowCount)
+    {
+        writeLinesOf(kernel, image, firstRow, rowCount);
+    }
+
+    void OutputWriter::writeLines(GlyphRowKernel const& kernel, Bitmap::PlaneView const& lumaPlane, unsigned int firstRow, unsigned int rowCount)
+    {
+        writeLinesOf(kernel, lumaPlane, firstRow, rowCount);
+    }
+
+    void OutputWriter::flush()
+    {
+        if (m_bufferUsed > 0)
+        {
+            writeToFile(m_buffer.data(), m_bufferUsed);
+            m_bufferUsed = 0;
+        }
+
+        // stdout keeps its own buffer
+        if (m_file && !m_ownsFile)
+        {
+            fflush(m_file);
+        }
+    }
+
+    void OutputWriter::writeToFile(char const* data, size_t length)
+    {
+        if (m_memory)
+        {
+            m_memory->insert(m_memory->end(), data, data + length);
+        }
+
+        // once a write has failed there's no point carrying on, the first error is the one that gets reported
+        if (m_file && m_error == Bitmap::FileHandlingErrors::OK)
+        {
+            Instrumentation::StageTimer timer(Instrumentation::Stage::OutputWrite);
+            timer.addIo(length);
+
+            if (fwrite(data, sizeof(char), length, m_file) != length)
+            {
+                m_error = Bitmap::FileHandlingErrors::UnknownWriteError;
+            }
+        }
+    }
+}
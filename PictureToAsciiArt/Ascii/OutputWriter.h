@@ -0,0 +1,89 @@
+#ifndef OUTPUTWRITER_H
+#define OUTPUTWRITER_H
+
+#include <stddef.h>
+#include <stdio.h>
+#include <vector>
+
+#include "../Bitmap/FileHandlingErrors.h"
+
+// forward declarations
+namespace Bitmap
+{
+    class ImageView;
+    class PlaneView;
+}
+
+namespace Ascii
+{
+    class GlyphRowKernel;
+}
+
+namespace Ascii
+{
+    // writes ASCII art out in large blocks. Rows are converted straight into a reusable buffer which is only flushed once
+    // it's full, so a whole image costs a handful of writes rather than a few per pixel. The buffer is kept between files
+    class OutputWriter
+    {
+    public:
+        explicit OutputWriter(size_t bufferSize = c_defaultBufferSize);
+        ~OutputWriter();
+
+        OutputWriter(OutputWriter const&) = delete;
+        OutputWriter& operator=(OutputWriter const&) = delete;
+
+        Bitmap::FileHandlingErrors open(char const* const filename);
+
+        // writes to stdout instead of a file. Closing flushes it but leaves it open
+        Bitmap::FileHandlingErrors openStandardOutput();
+
+        // appends to the vector instead of writing anywhere, which has to outlive the writer or the next open
+        Bitmap::FileHandlingErrors openMemory(std::vector<char>& destination);
+
+        // flushes and closes the file, reporting the first error hit since it was opened
+        Bitmap::FileHandlingErrors close();
+
+        // lets go of the file or memory without writing what's still buffered, for output that was cut short. The vector
+        // from openMemory isn't touched, it may well be gone by then
+        void discard();
+
+        // hands everything buffered so far to the file, for output that's being watched as it's written
+        void flush();
+
+        inline bool isOpen() const { return m_file != nullptr || m_memory != nullptr; }
+
+        // returns room for at least length characters at the end of the buffer, flushing first if needed. Follow with commit
+        char* reserve(size_t length);
+        void commit(size_t length);
+
+        // characters already assembled somewhere else. Big blocks skip the buffer and go straight to the file
+        void write(char const* data, size_t length);
+
+        // converts rows [firstRow, firstRow + rowCount) of the image directly into the buffer
+        void writeLines(GlyphRowKernel const& kernel, Bitmap::ImageView const& image, unsigned int firstRow, unsigned int rowCount);
+        void writeLines(GlyphRowKernel const& kernel, Bitmap::PlaneView const& lumaPlane, unsigned int firstRow, unsigned int rowCount);
+
+    private:
+        template<typename VIEW>
+        void writeLinesOf(GlyphRowKernel const& kernel, VIEW const& image, unsigned int firstRow, unsigned int rowCount);
+
+        // the file or the memory, whichever is open
+        void writeToFile(char const* data, size_t length);
+
+    private:
+        static size_t const c_defaultBufferSize = 1024 * 1024;
+
+        FILE* m_file;
+        bool m_ownsFile;
+
+        // set instead of m_file when writing to memory
+        std::vector<char>* m_memory;
+
+        std::vector<char> m_buffer;
+        size_t m_bufferUsed;
+
+        Bitmap::FileHandlingErrors m_error;
+    };
+}
+
+#endif // OUTPUTWRITER_H
@@ -0,0 +1,75 @@
+#include "PaletteGlyphTable.h"
+
+#include <string.h>
+
+#include "GlyphRamp.h"
+#include "OutputWriter.h"
+#include "../Bitmap/Colour.h"
+#include "../Bitmap/PlaneView.h"
+#include "../Instrumentation/StageMetrics.h"
+
+namespace Ascii
+{
+    PaletteGlyphTable::PaletteGlyphTable(GlyphRamp const& ramp, unsigned int charactersPerPixel)
+        : m_ramp(&ramp)
+        , m_charactersPerPixel(charactersPerPixel)
+        , m_glyphs{}
+        , m_glyphPairs{}
+    {
+    }
+
+    void PaletteGlyphTable::build(Bitmap::Colour const* palette, unsigned int colourCount)
+    {
+        for (unsigned int i = 0; i < c_indexCount; ++i)
+        {
+            Bitmap::Colour const colour = i < colourCount ? palette[i] : Bitmap::Colour();
+
+            char const glyph = m_ramp->getGlyph(colour.blue + colour.green + colour.red);
+
+            m_glyphs[i] = glyph;
+            m_glyphPairs[i][0] = glyph;
+            m_glyphPairs[i][1] = glyph;
+        }
+    }
+
+    void PaletteGlyphTable::convertRow(unsigned char const* indices, unsigned int width, char* output) const
+    {
+        if (m_charactersPerPixel == 2)
+        {
+            for (unsigned int x = 0; x < width; ++x)
+            {
+                memcpy(output, m_glyphPairs[indices[x]], 2);
+                output += 2;
+            }
+        }
+        else
+        {
+            for (unsigned int x = 0; x < width; ++x)
+            {
+                char const glyph = m_glyphs[indices[x]];
+
+                for (unsigned int i = 0; i < m_charactersPerPixel; ++i)
+                {
+                    *output++ = glyph;
+                }
+            }
+        }
+
+        *output = '\n';
+    }
+
+    void PaletteGlyphTable::writeLines(Bitmap::PlaneView const& indexPlane, unsigned int firstRow, unsigned int rowCount, OutputWriter& writer) const
+    {
+        unsigned int const width = indexPlane.getWidth();
+        size_t const lineLength = getLineLength(width);
+
+        Instrumentation::StageTimer timer(Instrumentation::Stage::GlyphMapping);
+        timer.addPixels(static_cast<unsigned long long>(width) * rowCount);
+
+        for (unsigned int y = firstRow; y < firstRow + rowCount; ++y)
+        {
+            convertRow(indexPlane.getRow(y), width, writer.reserve(lineLength));
+            writer.commit(lineLength);
+        }
+    }
+}
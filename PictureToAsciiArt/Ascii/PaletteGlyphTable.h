@@ -0,0 +1,52 @@
+#ifndef PALETTEGLYPHTABLE_H
+#define PALETTEGLYPHTABLE_H
+
+// forward declarations
+namespace Bitmap
+{
+    struct Colour;
+    class PlaneView;
+}
+
+namespace Ascii
+{
+    class GlyphRamp;
+    class OutputWriter;
+}
+
+namespace Ascii
+{
+    // the glyphs for every index of a palettised bitmap, worked out once from its palette. A row of an Indexed canvas is
+    // then converted with one lookup per pixel, the indices are never expanded back out into colours. Gives the same
+    // glyphs as the plain kernel without dithering. The ramp must outlive the table
+    class PaletteGlyphTable
+    {
+    public:
+        PaletteGlyphTable(GlyphRamp const& ramp, unsigned int charactersPerPixel);
+
+        // indices past the end of the palette get the glyph for black, the same as the canvas reads them back as
+        void build(Bitmap::Colour const* palette, unsigned int colourCount);
+
+        // '\n' included
+        inline unsigned int getLineLength(unsigned int width) const { return width * m_charactersPerPixel + 1; }
+
+        // writes one whole line, '\n' included
+        void convertRow(unsigned char const* indices, unsigned int width, char* output) const;
+
+        // converts rows [firstRow, firstRow + rowCount) of an index plane straight into the writer's buffer
+        void writeLines(Bitmap::PlaneView const& indexPlane, unsigned int firstRow, unsigned int rowCount, OutputWriter& writer) const;
+
+    private:
+        static unsigned int const c_indexCount = 256;
+
+        GlyphRamp const* m_ramp;
+        unsigned int m_charactersPerPixel;
+
+        char m_glyphs[c_indexCount];
+
+        // the glyph twice over, so the usual two characters per pixel go out as one 16 bit store
+        char m_glyphPairs[c_indexCount][2];
+    };
+}
+
+#endif // PALETTEGLYPHTABLE_H
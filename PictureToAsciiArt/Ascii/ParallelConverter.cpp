@@ -0,0 +1,111 @@
+#include "ParallelConverter.h"
+
+#include <future>
+
+#include "GlyphRowKernel.h"
+#include "OutputWriter.h"
+#include "../Bitmap/ImageView.h"
+#include "../Bitmap/PlaneView.h"
+#include "../Instrumentation/StageMetrics.h"
+#include "../Threading/ThreadPool.h"
+
+namespace Ascii
+{
+    unsigned int const ParallelConverter::c_targetBandSize = 64 * 1024;
+    unsigned int const ParallelConverter::c_bandsInFlightPerThread = 2;
+
+    ParallelConverter::ParallelConverter(GlyphRowKernel const& kernel, Threading::ThreadPool& threadPool)
+        : m_kernel(&kernel)
+        , m_threadPool(&threadPool)
+    {
+    }
+
+    template<typename VIEW>
+    void ParallelConverter::convertBand(VIEW const& image, unsigned int firstRow, unsigned int rowCount, std::vector<char>& output) const
+    {
+        // the capacity sticks around between bands, so once warmed up this doesn't allocate
+        output.resize(static_cast<size_t>(m_kernel->getLineLength(image.getWidth())) * rowCount);
+
+        m_kernel->convertLines(image, firstRow, rowCount, output.data());
+    }
+
+    template<typename VIEW>
+    void ParallelConverter::convertImage(VIEW const& image, OutputWriter& writer)
+    {
+        unsigned int const height = image.getHeight();
+
+        unsigned int const rowLength = m_kernel->getLineLength(image.getWidth());
+
+        unsigned int const rowsPerBand = calculateRowsPerBand(rowLength, height);
+        unsigned int const bandCount = height > 0 ? (height + rowsPerBand - 1) / rowsPerBand : 0;
+        unsigned int const bandsInFlight = m_threadPool->getThreadCount() * c_bandsInFlightPerThread;
+
+        if (m_bandBuffers.size() < bandsInFlight)
+        {
+            m_bandBuffers.resize(bandsInFlight);
+        }
+
+        std::vector<std::future<void>> pendingBands(bandsInFlight);
+
+        // the bands are timed as part of whatever image the calling thread is collecting metrics for
+        Instrumentation::StageMetrics* const metrics = Instrumentation::ScopedCollection::getCurrent();
+
+        // band i always goes through buffer i % bandsInFlight, which is free again once band i - bandsInFlight is written
+        auto submitBand = [&](unsigned int band)
+        {
+            unsigned int const firstRow = band * rowsPerBand;
+            unsigned int const rowCount = (height - firstRow) < rowsPerBand ? (height - firstRow) : rowsPerBand;
+
+            std::vector<char>& buffer = m_bandBuffers[band % bandsInFlight];
+
+            pendingBands[band % bandsInFlight] = m_threadPool->submit([this, &image, firstRow, rowCount, &buffer, metrics]()
+            {
+                Instrumentation::ScopedCollection collection(metrics);
+                convertBand(image, firstRow, rowCount, buffer);
+            });
+        };
+
+        unsigned int nextBandToSubmit = 0;
+
+        for (; nextBandToSubmit < bandCount && nextBandToSubmit < bandsInFlight; ++nextBandToSubmit)
+        {
+            submitBand(nextBandToSubmit);
+        }
+
+        for (unsigned int band = 0; band < bandCount; ++band)
+        {
+            pendingBands[band % bandsInFlight].wait();
+
+            std::vector<char> const& buffer = m_bandBuffers[band % bandsInFlight];
+            writer.write(buffer.data(), buffer.size());
+
+            if (nextBandToSubmit < bandCount)
+            {
+                submitBand(nextBandToSubmit++);
+            }
+        }
+    }
+
+    void ParallelConverter::convert(Bitmap::ImageView const& image, OutputWriter& writer)
+    {
+        convertImage(image, writer);
+    }
+
+    void ParallelConverter::convert(Bitmap::PlaneView const& lumaPlane, OutputWriter& writer)
+    {
+        convertImage(lumaPlane, writer);
+    }
+
+    unsigned int ParallelConverter::calculateRowsPerBand(unsigned int rowLength, unsigned int height) const
+    {
+        unsigned int rowsPerBand = rowLength > 0 ? c_targetBandSize / rowLength : 1;
+
+        // small images still get split up enough to give every worker something to do
+        unsigned int const bandsWanted = m_threadPool->getThreadCount() * c_bandsInFlightPerThread;
+        unsigned int const rowsForAllWorkers = (height + bandsWanted - 1) / bandsWanted;
+
+        rowsPerBand = rowsPerBand < rowsForAllWorkers ? rowsPerBand : rowsForAllWorkers;
+
+        return rowsPerBand > 0 ? rowsPerBand : 1;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,62 @@
+#ifndef PARALLELCONVERTER_H
+#define PARALLELCONVERTER_H
+
+#include <vector>
+
+// forward declarations
+namespace Bitmap
+{
+    class ImageView;
+    class PlaneView;
+}
+
+namespace Threading
+{
+    class ThreadPool;
+}
+
+namespace Ascii
+{
+    class GlyphRowKernel;
+    class OutputWriter;
+}
+
+namespace Ascii
+{
+    // converts an image on a thread pool. Every row converts independently, so the image is cut into bands of rows which
+    // are converted into their own buffers on the workers, and written out in order by the calling thread as soon as
+    // each one is ready. The output is byte for byte the same as converting the rows one after another
+    class ParallelConverter
+    {
+    public:
+        ParallelConverter(GlyphRowKernel const& kernel, Threading::ThreadPool& threadPool);
+
+        // write errors are picked up by the writer and reported when it's closed
+        void convert(Bitmap::ImageView const& image, OutputWriter& writer);
+        void convert(Bitmap::PlaneView const& lumaPlane, OutputWriter& writer);
+
+    private:
+        template<typename VIEW>
+        void convertImage(VIEW const& image, OutputWriter& writer);
+
+        unsigned int calculateRowsPerBand(unsigned int rowLength, unsigned int height) const;
+
+        template<typename VIEW>
+        void convertBand(VIEW const& image, unsigned int firstRow, unsigned int rowCount, std::vector<char>& output) const;
+
+    private:
+        // bands aim for roughly this much output, big enough to make the task overhead noise
+        static unsigned int const c_targetBandSize;
+
+        // bands in flight per worker, bounds memory while keeping the workers busy as the writer catches up
+        static unsigned int const c_bandsInFlightPerThread;
+
+        GlyphRowKernel const* m_kernel;
+        Threading::ThreadPool* m_threadPool;
+
+        // one buffer per band in flight, reused from image to image
+        std::vector<std::vector<char>> m_bandBuffers;
+    };
+}
+
+#endif // PARALLELCONVERTER_H
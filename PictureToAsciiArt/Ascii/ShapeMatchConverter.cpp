@@ -0,0 +1,266 @@
+#include "ShapeMatchConverter.h"
+
+#include <vector>
+
+#include "CpuFeatures.h"
+#include "OutputWriter.h"
+#include "../Bitmap/AreaDownscaler.h"
+#include "../Bitmap/Colour.h"
+#include "../Bitmap/ImageView.h"
+#include "../Bitmap/PlaneView.h"
+#include "../Instrumentation/StageMetrics.h"
+
+#if ASCII_X86_KERNELS
+#include <nmmintrin.h>
+#endif
+
+namespace
+{
+    inline unsigned int getChannelSum(Bitmap::Colour const* row, unsigned int x)
+    {
+        return row[x].blue + row[x].green + row[x].red;
+    }
+
+    // luma is the average of the channels, the same as GlyphRamp treats it
+    inline unsigned int getChannelSum(unsigned char const* row, unsigned int x)
+    {
+        return row[x] * 3u;
+    }
+
+    // the usual SWAR count, for CPUs without POPCNT
+    inline unsigned int countBits(unsigned long long bits)
+    {
+        bits = bits - ((bits >> 1) & 0x5555555555555555ull);
+        bits = (bits & 0x3333333333333333ull) + ((bits >> 2) & 0x3333333333333333ull);
+        bits = (bits + (bits >> 4)) & 0x0F0F0F0F0F0F0F0Full;
+
+        return static_cast<unsigned int>((bits * 0x0101010101010101ull) >> 56);
+    }
+
+#if ASCII_X86_KERNELS
+
+    ASCII_TARGET_POPCNT inline unsigned int countBitsPopcnt(unsigned long long bits)
+    {
+#if defined(_M_X64) || defined(__x86_64__)
+        return static_cast<unsigned int>(_mm_popcnt_u64(bits));
+#else
+        return static_cast<unsigned int>(_mm_popcnt_u32(static_cast<unsigned int>(bits)) + _mm_popcnt_u32(static_cast<unsigned int>(bits >> 32)));
+#endif
+    }
+
+#endif
+
+    inline unsigned int getDifference(unsigned int a, unsigned int b)
+    {
+        return a > b ? a - b : b - a;
+    }
+}
+
+namespace Ascii
+{
+    ShapeMatchConverter::ShapeMatchConverter(GlyphAtlas const& atlas)
+        : m_atlas(&atlas)
+        , m_usePopcnt(CpuFeatures::hasPopcnt())
+        , m_thresholds{}
+    {
+        unsigned int const maximumChannelSum = 255 * 3;
+        unsigned int const maximumInkCount = atlas.getMaximumInkCount();
+
+        // rank r of 64 is set once the pixel is past (r + 0.5) / 64 of white, stretched so white sets maximumInkCount of
+        // the cell's bits. The top ranks end up past white and are never set
+        for (unsigned int y = 0; y < BayerMatrix::c_size; ++y)
+        {
+            for (unsigned int x = 0; x < BayerMatrix::c_size; ++x)
+            {
+                unsigned long long threshold = 0xFFFF;
+
+                if (maximumInkCount > 0)
+                {
+                    threshold = (2ull * BayerMatrix::getRank(x, y) + 1) * maximumChannelSum * GlyphAtlas::c_cellPixelCount / (2ull * BayerMatrix::c_rankCount * maximumInkCount);
+                    threshold = threshold < 0xFFFF ? threshold : 0xFFFF;
+                }
+
+                m_thresholds[y][x] = static_cast<unsigned short>(threshold);
+            }
+        }
+    }
+
+    void ShapeMatchConverter::calculateTargetSize(unsigned int sourceWidth, unsigned int sourceHeight, unsigned int targetColumns, float cellAspect, unsigned int& targetWidth, unsigned int& targetHeight)
+    {
+        // each column is a cell's width of pixels, and a pixel is a cell's aspect over its height and width tall
+        float const pixelAspect = (cellAspect > 0.0f ? cellAspect : 1.0f) * GlyphAtlas::c_cellWidth / GlyphAtlas::c_cellHeight;
+
+        Bitmap::AreaDownscaler::calculateTargetSize(sourceWidth, sourceHeight, targetColumns * GlyphAtlas::c_cellWidth, 1, pixelAspect, targetWidth, targetHeight);
+    }
+
+    template<typename VIEW>
+    void ShapeMatchConverter::writeLinesOf(VIEW const& image, unsigned int firstRow, unsigned int rowCount, OutputWriter& writer) const
+    {
+        unsigned int const columnCount = getColumnCount(image.getWidth());
+        unsigned int const lineLength = getLineLength(image.getWidth());
+        unsigned int const endRow = firstRow + rowCount;
+
+        Instrumentation::StageTimer timer(Instrumentation::Stage::GlyphMapping);
+        timer.addPixels(static_cast<unsigned long long>(image.getWidth()) * rowCount);
+
+        std::vector<GlyphAtlas::Shape> cells(columnCount);
+
+        for (unsigned int y = firstRow; y < endRow; y += GlyphAtlas::c_cellHeight)
+        {
+            buildCellMasks(image, y, cells.data());
+
+            char* const output = writer.reserve(lineLength);
+
+            // flat areas give the same mask cell after cell, so the last search is reused
+            GlyphAtlas::Shape previousCell = { ~0ull, ~0ull };
+            char previousGlyph = ' ';
+
+            for (unsigned int column = 0; column < columnCount; ++column)
+            {
+                GlyphAtlas::Shape const& cell = cells[column];
+
+                if (cell.top != previousCell.top || cell.bottom != previousCell.bottom)
+                {
+                    previousCell = cell;
+                    previousGlyph = m_atlas->getGlyph(findClosestGlyph(cell));
+                }
+
+                output[column] = previousGlyph;
+            }
+
+            output[columnCount] = '\n';
+
+            writer.commit(lineLength);
+        }
+    }
+
+    template<typename VIEW>
+    void ShapeMatchConverter::buildCellMasks(VIEW const& image, unsigned int firstRow, GlyphAtlas::Shape* cells) const
+    {
+        unsigned int const width = image.getWidth();
+        unsigned int const lastRow = image.getHeight() - 1;
+        unsigned int const columnCount = getColumnCount(width);
+
+        for (unsigned int column = 0; column < columnCount; ++column)
+        {
+            cells[column].top = 0;
+            cells[column].bottom = 0;
+        }
+
+        for (unsigned int cellRow = 0; cellRow < GlyphAtlas::c_cellHeight; ++cellRow)
+        {
+            unsigned int const y = firstRow + cellRow <= lastRow ? firstRow + cellRow : lastRow;
+            auto const row = image.getRow(y);
+
+            unsigned short const* const thresholds = m_thresholds[cellRow % BayerMatrix::c_size];
+            unsigned int const shift = 56 - 8 * (cellRow % 8);
+
+            for (unsigned int column = 0; column < columnCount; ++column)
+            {
+                unsigned int const firstX = column * GlyphAtlas::c_cellWidth;
+                unsigned long long rowBits = 0;
+
+                if (firstX + GlyphAtlas::c_cellWidth <= width)
+                {
+                    for (unsigned int i = 0; i < GlyphAtlas::c_cellWidth; ++i)
+                    {
+                        rowBits = (rowBits << 1) | (getChannelSum(row, firstX + i) > thresholds[i] ? 1u : 0u);
+                    }
+                }
+                else
+                {
+                    for (unsigned int i = 0; i < GlyphAtlas::c_cellWidth; ++i)
+                    {
+                        unsigned int const x = firstX + i < width ? firstX + i : width - 1;
+                        rowBits = (rowBits << 1) | (getChannelSum(row, x) > thresholds[i] ? 1u : 0u);
+                    }
+                }
+
+                unsigned long long& half = cellRow < 8 ? cells[column].top : cells[column].bottom;
+                half |= rowBits << shift;
+            }
+        }
+    }
+
+    void ShapeMatchConverter::writeLines(Bitmap::ImageView const& image, unsigned int firstRow, unsigned int rowCount, OutputWriter& writer) const
+    {
+        writeLinesOf(image, firstRow, rowCount, writer);
+    }
+
+    void ShapeMatchConverter::writeLines(Bitmap::PlaneView const& lumaPlane, unsigned int firstRow, unsigned int rowCount, OutputWriter& writer) const
+    {
+        writeLinesOf(lumaPlane, firstRow, rowCount, writer);
+    }
+
+    unsigned int ShapeMatchConverter::findClosestGlyph(GlyphAtlas::Shape const& cell) const
+    {
+#if ASCII_X86_KERNELS
+        if (m_usePopcnt)
+        {
+            return findClosestGlyphPopcnt(cell);
+        }
+#endif
+
+        return findClosestGlyphScalar(cell);
+    }
+
+    // both score a glyph as the bits it differs from the cell by, plus the difference in how many bits are set. Ties go
+    // to the earlier glyph so both pick the same one
+
+    unsigned int ShapeMatchConverter::findClosestGlyphScalar(GlyphAtlas::Shape const& cell) const
+    {
+        unsigned int const cellInk = countBits(cell.top) + countBits(cell.bottom);
+
+        unsigned int bestIndex = 0;
+        unsigned int bestScore = ~0u;
+
+        for (unsigned int i = 0; i < m_atlas->getGlyphCount(); ++i)
+        {
+            GlyphAtlas::Shape const& glyph = m_atlas->getShape(i);
+
+            unsigned int const score = countBits(cell.top ^ glyph.top) + countBits(cell.bottom ^ glyph.bottom) + getDifference(cellInk, m_atlas->getInkCount(i));
+
+            if (score < bestScore)
+            {
+                bestIndex = i;
+                bestScore = score;
+            }
+        }
+
+        return bestIndex;
+    }
+
+#if ASCII_X86_KERNELS
+
+    ASCII_TARGET_POPCNT unsigned int ShapeMatchConverter::findClosestGlyphPopcnt(GlyphAtlas::Shape const& cell) const
+    {
+        unsigned int const cellInk = countBitsPopcnt(cell.top) + countBitsPopcnt(cell.bottom);
+
+        unsigned int bestIndex = 0;
+        unsigned int bestScore = ~0u;
+
+        for (unsigned int i = 0; i < m_atlas->getGlyphCount(); ++i)
+        {
+            GlyphAtlas::Shape const& glyph = m_atlas->getShape(i);
+
+            unsigned int const score = countBitsPopcnt(cell.top ^ glyph.top) + countBitsPopcnt(cell.bottom ^ glyph.bottom) + getDifference(cellInk, m_atlas->getInkCount(i));
+
+            if (score < bestScore)
+            {
+                bestIndex = i;
+                bestScore = score;
+            }
+        }
+
+        return bestIndex;
+    }
+
+#else
+
+    unsigned int ShapeMatchConverter::findClosestGlyphPopcnt(GlyphAtlas::Shape const& cell) const
+    {
+        return findClosestGlyphScalar(cell);
+    }
+
+#endif
+}
@@ -0,0 +1,73 @@
+#ifndef SHAPEMATCHCONVERTER_H
+#define SHAPEMATCHCONVERTER_H
+
+#include "BayerMatrix.h"
+#include "GlyphAtlas.h"
+
+// forward declarations
+namespace Bitmap
+{
+    class ImageView;
+    class PlaneView;
+}
+
+namespace Ascii
+{
+    class OutputWriter;
+}
+
+namespace Ascii
+{
+    // picks each glyph by its shape rather than just its brightness. The image is split into cells of the atlas's size,
+    // each cell is thresholded into a 128 bit mask and the glyph whose shape is the fewest bits away wins, with the
+    // difference in ink counted on top so flat areas still come out the right brightness.
+    // the thresholds are an ordered dither scaled so white sets as many bits as the atlas's inkiest glyph has, so mid
+    // tones become a scatter of bits rather than all or nothing. Every pixel of the view is a pixel of a cell, so it's
+    // downscaled to calculateTargetSize first. The atlas must outlive the converter
+    class ShapeMatchConverter
+    {
+    public:
+        explicit ShapeMatchConverter(GlyphAtlas const& atlas);
+
+        // the size to downscale a source to for targetColumns glyphs, cells being cellAspect times taller than wide.
+        // Never bigger than the source, like AreaDownscaler::calculateTargetSize
+        static void calculateTargetSize(unsigned int sourceWidth, unsigned int sourceHeight, unsigned int targetColumns, float cellAspect, unsigned int& targetWidth, unsigned int& targetHeight);
+
+        inline bool isUsingPopcnt() const { return m_usePopcnt; }
+
+        // one glyph per cell, a part cell at the right or bottom edge is padded out by repeating the last pixel
+        inline unsigned int getColumnCount(unsigned int width) const { return (width + GlyphAtlas::c_cellWidth - 1) / GlyphAtlas::c_cellWidth; }
+        inline unsigned int getLineLength(unsigned int width) const { return getColumnCount(width) + 1; }
+
+        // converts rows [firstRow, firstRow + rowCount) of the view, a line per row of cells. firstRow has to be on a cell
+        // boundary and rowCount whole cells, unless the rows run to the bottom of the view
+        void writeLines(Bitmap::ImageView const& image, unsigned int firstRow, unsigned int rowCount, OutputWriter& writer) const;
+        void writeLines(Bitmap::PlaneView const& lumaPlane, unsigned int firstRow, unsigned int rowCount, OutputWriter& writer) const;
+
+        // the index in the atlas of the glyph closest to the cell
+        unsigned int findClosestGlyph(GlyphAtlas::Shape const& cell) const;
+
+    private:
+        template<typename VIEW>
+        void writeLinesOf(VIEW const& image, unsigned int firstRow, unsigned int rowCount, OutputWriter& writer) const;
+
+        // thresholds the cell row starting at firstRow into one mask per cell
+        template<typename VIEW>
+        void buildCellMasks(VIEW const& image, unsigned int firstRow, GlyphAtlas::Shape* cells) const;
+
+        unsigned int findClosestGlyphScalar(GlyphAtlas::Shape const& cell) const;
+        unsigned int findClosestGlyphPopcnt(GlyphAtlas::Shape const& cell) const;
+
+    private:
+        static_assert(GlyphAtlas::c_cellWidth == BayerMatrix::c_size, "a row of a cell is one row of the dither pattern");
+
+        GlyphAtlas const* m_atlas;
+
+        bool m_usePopcnt;
+
+        // the channel sum a pixel has to beat to set its bit, by its row and column within the pattern
+        unsigned short m_thresholds[BayerMatrix::c_size][BayerMatrix::c_size];
+    };
+}
+
+#endif // SHAPEMATCHCONVERTER_H
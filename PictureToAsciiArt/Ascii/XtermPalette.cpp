@@ -0,0 +1,121 @@
+#include "XtermPalette.h"
+
+#include "../Bitmap/Colour.h"
+
+namespace
+{
+    // the levels of each axis of the 6x6x6 colour cube, indices 16 to 231
+    int const c_cubeLevels[] = { 0, 95, 135, 175, 215, 255 };
+    unsigned int const c_cubeLevelCount = 6;
+    unsigned int const c_firstCubeIndex = 16;
+
+    // 24 greys from 8 to 238 in steps of 10, indices 232 to 255
+    unsigned int const c_greyCount = 24;
+    unsigned int const c_firstGreyIndex = 232;
+
+    unsigned int findNearestCubeLevel(int value)
+    {
+        unsigned int nearest = 0;
+
+        for (unsigned int i = 1; i < c_cubeLevelCount; ++i)
+        {
+            int const distance = value - c_cubeLevels[i];
+            int const nearestDistance = value - c_cubeLevels[nearest];
+
+            if (distance * distance < nearestDistance * nearestDistance)
+            {
+                nearest = i;
+            }
+        }
+
+        return nearest;
+    }
+
+    int calculateDistanceSquared(int red, int green, int blue, int paletteRed, int paletteGreen, int paletteBlue)
+    {
+        return (red - paletteRed) * (red - paletteRed) + (green - paletteGreen) * (green - paletteGreen) + (blue - paletteBlue) * (blue - paletteBlue);
+    }
+}
+
+namespace Ascii
+{
+    XtermPalette const& XtermPalette::get()
+    {
+        static XtermPalette const palette;
+        return palette;
+    }
+
+    XtermPalette::XtermPalette()
+    {
+        unsigned int const shift = 8 - c_bitsPerChannel;
+
+        for (unsigned int red = 0; red < c_levelsPerChannel; ++red)
+        {
+            for (unsigned int green = 0; green < c_levelsPerChannel; ++green)
+            {
+                for (unsigned int blue = 0; blue < c_levelsPerChannel; ++blue)
+                {
+                    // the middle of the range of colours that land in this cell
+                    int const centreOffset = 1 << (shift - 1);
+
+                    m_lookup[(red << (2 * c_bitsPerChannel)) | (green << c_bitsPerChannel) | blue] = findNearestIndex(
+                        static_cast<int>(red << shift) + centreOffset
+                        , static_cast<int>(green << shift) + centreOffset
+                        , static_cast<int>(blue << shift) + centreOffset);
+                }
+            }
+        }
+    }
+
+    unsigned char XtermPalette::getNearestIndex(Bitmap::Colour const& colour) const
+    {
+        return getNearestIndex(colour.red, colour.green, colour.blue);
+    }
+
+    void XtermPalette::getPaletteColour(unsigned char index, unsigned char& red, unsigned char& green, unsigned char& blue)
+    {
+        if (index >= c_firstGreyIndex)
+        {
+            unsigned char const grey = static_cast<unsigned char>(8 + (index - c_firstGreyIndex) * 10);
+
+            red = grey;
+            green = grey;
+            blue = grey;
+        }
+        else
+        {
+            // the system colours below the cube are left to the terminal, treat them as black
+            unsigned int const cubeIndex = index >= c_firstCubeIndex ? index - c_firstCubeIndex : 0;
+
+            red = static_cast<unsigned char>(c_cubeLevels[cubeIndex / 36]);
+            green = static_cast<unsigned char>(c_cubeLevels[(cubeIndex / 6) % 6]);
+            blue = static_cast<unsigned char>(c_cubeLevels[cubeIndex % 6]);
+        }
+    }
+
+    unsigned char XtermPalette::findNearestIndex(int red, int green, int blue)
+    {
+        // the cube is a regular grid, so its nearest colour is just the nearest level on each axis
+        unsigned int const cubeRed = findNearestCubeLevel(red);
+        unsigned int const cubeGreen = findNearestCubeLevel(green);
+        unsigned int const cubeBlue = findNearestCubeLevel(blue);
+
+        unsigned int nearestIndex = c_firstCubeIndex + cubeRed * 36 + cubeGreen * 6 + cubeBlue;
+        int nearestDistance = calculateDistanceSquared(red, green, blue, c_cubeLevels[cubeRed], c_cubeLevels[cubeGreen], c_cubeLevels[cubeBlue]);
+
+        // the greys sit in between the cube's own greys, and often win for desaturated colours
+        for (unsigned int i = 0; i < c_greyCount; ++i)
+        {
+            int const grey = static_cast<int>(8 + i * 10);
+            int const distance = calculateDistanceSquared(red, green, blue, grey, grey, grey);
+
+            if (distance < nearestDistance)
+            {
+                nearestIndex = c_firstGreyIndex + i;
+                nearestDistance = distance;
+            }
+        }
+
+        return static_cast<unsigned char>(nearestIndex);
+    }
+}
@@ -0,0 +1,47 @@
+#ifndef XTERMPALETTE_H
+#define XTERMPALETTE_H
+
+// forward declarations
+namespace Bitmap
+{
+    struct Colour;
+}
+
+namespace Ascii
+{
+    // the xterm 256 colour palette and a lookup table from any RGB colour to its nearest entry. The table is quantised to
+    // c_bitsPerChannel bits per channel, each cell holding the nearest palette colour to the centre of the cell, so
+    // mapping a pixel is three shifts and a load rather than a search. Only the 6x6x6 cube and the grey ramp are
+    // mapped to, the first 16 colours are whatever the terminal's theme makes them
+    class XtermPalette
+    {
+    public:
+        static unsigned int const c_bitsPerChannel = 5;
+        static unsigned int const c_levelsPerChannel = 1 << c_bitsPerChannel;
+
+        // built the first time it's asked for
+        static XtermPalette const& get();
+
+        inline unsigned char getNearestIndex(unsigned char red, unsigned char green, unsigned char blue) const
+        {
+            unsigned int const shift = 8 - c_bitsPerChannel;
+
+            return m_lookup[((red >> shift) << (2 * c_bitsPerChannel)) | ((green >> shift) << c_bitsPerChannel) | (blue >> shift)];
+        }
+
+        unsigned char getNearestIndex(Bitmap::Colour const& colour) const;
+
+        // what the terminal shows for a palette index, 16 and up
+        static void getPaletteColour(unsigned char index, unsigned char& red, unsigned char& green, unsigned char& blue);
+
+    private:
+        XtermPalette();
+
+        static unsigned char findNearestIndex(int red, int green, int blue);
+
+    private:
+        unsigned char m_lookup[c_levelsPerChannel * c_levelsPerChannel * c_levelsPerChannel];
+    };
+}
+
+#endif // XTERMPALETTE_H
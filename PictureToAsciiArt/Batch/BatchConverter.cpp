@@ -0,0 +1,558 @@
+#include "BatchConverter.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <ctype.h>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <thread>
+
+#include "../Ascii/GlyphRowKernel.h"
+#include "../Ascii/OutputWriter.h"
+#include "../Bitmap/AreaDownscaler.h"
+#include "../Bitmap/ImageCanvas.h"
+#include "../Bitmap/ImageView.h"
+#include "../Cache/ResultCache.h"
+#include "../Instrumentation/StageMetrics.h"
+#include "../Threading/SpscQueue.h"
+#include "../Threading/WorkStealingPool.h"
+
+namespace Batch
+{
+    unsigned long long const BatchConverter::c_splitThresholdPixels = 1024 * 1024;
+    unsigned int const BatchConverter::c_targetBandSize = 256 * 1024;
+    unsigned int const BatchConverter::c_pipelineSlotCount = 4;
+
+    BatchConverter::BatchConverter(Ascii::GlyphRowKernel const& kernel, Bitmap::LoadedImage::Method loadMethod, unsigned int targetColumns, float cellAspect, Threading::WorkStealingPool& workerPool)
+        : m_kernel(&kernel)
+        , m_loadMethod(loadMethod)
+        , m_targetColumns(targetColumns)
+        , m_cellAspect(cellAspect)
+        , m_workerPool(&workerPool)
+        , m_resultCache(nullptr)
+        , m_collectMetrics(false)
+    {
+    }
+
+    bool BatchConverter::collectItems(char const* const directoryOrFileList, char const* const outputDirectory, std::vector<BatchItem>& items)
+    {
+        namespace fs = std::filesystem;
+
+        std::error_code errorCode;
+        std::vector<fs::path> sources;
+
+        if (fs::is_directory(directoryOrFileList, errorCode))
+        {
+            for (fs::directory_entry const& entry : fs::directory_iterator(directoryOrFileList, errorCode))
+            {
+                std::string extension = entry.path().extension().string();
+                std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return static_cast<char>(tolower(static_cast<unsigned char>(c))); });
+
+                if (entry.is_regular_file(errorCode) && extension == ".bmp")
+                {
+                    sources.push_back(entry.path());
+                }
+            }
+
+            // directory order is up to the file system, keep runs repeatable
+            std::sort(sources.begin(), sources.end());
+        }
+        else
+        {
+            std::ifstream fileList(directoryOrFileList);
+
+            if (!fileList)
+            {
+                return false;
+            }
+
+            std::string line;
+
+            while (std::getline(fileList, line))
+            {
+                // tolerate lists written on Windows
+                if (!line.empty() && line.back() == '\r')
+                {
+                    line.pop_back();
+                }
+
+                if (!line.empty())
+                {
+                    sources.push_back(line);
+                }
+            }
+        }
+
+        for (fs::path const& source : sources)
+        {
+            fs::path output = source;
+            output.replace_extension(".txt");
+
+            if (outputDirectory)
+            {
+                output = fs::path(outputDirectory) / output.filename();
+            }
+
+            items.push_back({ source.string(), output.string() });
+        }
+
+        return !errorCode;
+    }
+
+    unsigned int BatchConverter::run(std::vector<BatchItem> const& items, Instrumentation::MetricsReport* metricsReport)
+    {
+        std::vector<ItemResult> results(items.size());
+
+        m_collectMetrics = metricsReport != nullptr;
+
+        auto const startTime = std::chrono::steady_clock::now();
+
+        for (size_t i = 0; i < items.size(); ++i)
+        {
+            ItemResult& result = results[i];
+            result.item = &items[i];
+
+            // only two pointers captured, small enough for the task to be stored without an allocation
+            m_workerPool->submit([this, &result]()
+            {
+                try
+                {
+                    convertItem(result);
+                }
+                catch (...)
+                {
+                    result.error = getCurrentExceptionError();
+                }
+            });
+        }
+
+        m_workerPool->waitForAll();
+
+        m_collectMetrics = false;
+
+        double const elapsedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+        return reportResults(results, elapsedSeconds, metricsReport);
+    }
+
+    unsigned int BatchConverter::runPipelined(std::vector<BatchItem> const& items, Instrumentation::MetricsReport* metricsReport)
+    {
+        std::vector<ItemResult> results(items.size());
+
+        for (size_t i = 0; i < items.size(); ++i)
+        {
+            results[i].item = &items[i];
+        }
+
+        m_collectMetrics = metricsReport != nullptr;
+
+        auto const startTime = std::chrono::steady_clock::now();
+
+        // free slots go back to the reader, loaded ones on to be converted and converted ones on to the writer. A null
+        // slot is the end of the batch. One spare place each for it, the real slots can never fill more than their count
+        Threading::SpscQueue<PipelineSlot*> freeSlots(c_pipelineSlotCount);
+        Threading::SpscQueue<PipelineSlot*> loadedSlots(c_pipelineSlotCount + 1);
+        Threading::SpscQueue<PipelineSlot*> convertedSlots(c_pipelineSlotCount + 1);
+
+        std::vector<std::unique_ptr<PipelineSlot>> slots;
+
+        for (unsigned int i = 0; i < c_pipelineSlotCount; ++i)
+        {
+            slots.emplace_back(new PipelineSlot(m_canvasPool));
+            freeSlots.push(slots.back().get());
+        }
+
+        std::thread reader([this, &results, &freeSlots, &loadedSlots]()
+        {
+            for (ItemResult& result : results)
+            {
+                PipelineSlot* const slot = freeSlots.pop();
+
+                try
+                {
+                    readStage(*slot, result);
+                }
+                catch (...)
+                {
+                    result.error = getCurrentExceptionError();
+                }
+
+                loadedSlots.push(slot);
+            }
+
+            loadedSlots.push(nullptr);
+        });
+
+        std::thread writer([this, &freeSlots, &convertedSlots]()
+        {
+            while (PipelineSlot* const slot = convertedSlots.pop())
+            {
+                try
+                {
+                    writeStage(*slot);
+                }
+                catch (...)
+                {
+                    slot->result->error = getCurrentExceptionError();
+                }
+
+                freeSlots.push(slot);
+            }
+        });
+
+        while (PipelineSlot* const slot = loadedSlots.pop())
+        {
+            try
+            {
+                convertStage(*slot);
+            }
+            catch (...)
+            {
+                slot->result->error = getCurrentExceptionError();
+            }
+
+            convertedSlots.push(slot);
+        }
+
+        convertedSlots.push(nullptr);
+
+        reader.join();
+        writer.join();
+
+        m_collectMetrics = false;
+
+        double const elapsedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+        return reportResults(results, elapsedSeconds, metricsReport);
+    }
+
+    unsigned int BatchConverter::reportResults(std::vector<ItemResult> const& results, double elapsedSeconds, Instrumentation::MetricsReport* metricsReport) const
+    {
+        unsigned int failedCount = 0;
+        unsigned long long totalPixels = 0;
+
+        for (ItemResult const& result : results)
+        {
+            if (result.error == Bitmap::FileHandlingErrors::OK)
+            {
+                totalPixels += result.pixelCount;
+            }
+            else
+            {
+                printf("Failed to convert \"%s\": %s\n", result.item->sourceFileName.c_str(), Bitmap::getFileHandlingErrorName(result.error));
+                ++failedCount;
+            }
+
+            if (metricsReport)
+            {
+                metricsReport->addImage(result.item->sourceFileName.c_str(), result.metrics);
+            }
+        }
+
+        unsigned int const convertedCount = static_cast<unsigned int>(results.size()) - failedCount;
+        double const safeSeconds = elapsedSeconds > 0.0 ? elapsedSeconds : 1e-9;
+
+        printf("Converted %u of %u images in %.3f s on %u threads: %.1f images/s, %.2f megapixels/s\n"
+            , convertedCount
+            , static_cast<unsigned int>(results.size())
+            , elapsedSeconds
+            , m_workerPool->getThreadCount()
+            , convertedCount / safeSeconds
+            , totalPixels / 1e6 / safeSeconds);
+
+        return failedCount;
+    }
+
+    Bitmap::FileHandlingErrors BatchConverter::getCurrentExceptionError()
+    {
+        Bitmap::FileHandlingErrors error = Bitmap::FileHandlingErrors::UnknownReadError;
+
+        try
+        {
+            throw;
+        }
+        catch (std::bad_alloc const&)
+        {
+            error = Bitmap::FileHandlingErrors::OutOfMemory;
+        }
+        catch (std::length_error const&)
+        {
+            // what a container throws for a size it can't even try to allocate
+            error = Bitmap::FileHandlingErrors::OutOfMemory;
+        }
+        catch (...)
+        {
+        }
+
+        return error;
+    }
+
+    void BatchConverter::convertItem(ItemResult& result)
+    {
+        BatchItem const& item = *result.item;
+
+        // tasks from other images can run on this worker while it waits for its bands, they set up their own collection
+        Instrumentation::ImageScope imageScope(m_collectMetrics ? &result.metrics : nullptr);
+
+        std::string cacheKey;
+
+        // a hit is the whole job, the image is never loaded
+        if (m_resultCache && m_resultCache->fetch(item.sourceFileName.c_str(), item.outputFileName.c_str(), cacheKey))
+        {
+            return;
+        }
+
+        Bitmap::LoadedImage image(m_canvasPool);
+        result.error = image.open(item.sourceFileName.c_str(), m_loadMethod);
+
+        if (result.error != Bitmap::FileHandlingErrors::OK)
+        {
+            return;
+        }
+
+        Bitmap::ImageView view = image.getView();
+        result.pixelCount = static_cast<unsigned long long>(view.getWidth()) * view.getHeight();
+
+        // the downscaled copy is what gets converted, and what decides whether it's worth splitting up
+        Bitmap::PooledCanvas downscaled(m_canvasPool);
+
+        if (m_targetColumns > 0)
+        {
+            unsigned int targetWidth = 0;
+            unsigned int targetHeight = 0;
+
+            Bitmap::AreaDownscaler::calculateTargetSize(view.getWidth(), view.getHeight(), m_targetColumns, m_kernel->getCharactersPerPixel(), m_cellAspect, targetWidth, targetHeight);
+
+            // the table rows are kept for the next image this worker downscales
+            thread_local Bitmap::AreaDownscaler downscaler;
+            downscaler.downscale(view, targetWidth, targetHeight, downscaled.get());
+
+            view = downscaled.get().getTopDownView();
+        }
+
+        unsigned long long const outputPixelCount = static_cast<unsigned long long>(view.getWidth()) * view.getHeight();
+
+        bool const splitIntoBands = outputPixelCount >= c_splitThresholdPixels && m_workerPool->getThreadCount() > 1;
+
+        if (splitIntoBands)
+        {
+            // other images can run on this thread while it waits for its bands, so it can't share the worker's writer
+            Ascii::OutputWriter writer;
+            result.error = writeItem(item, view, true, writer);
+        }
+        else
+        {
+            // one writer per worker, its buffer is reused by every small image that worker converts
+            thread_local Ascii::OutputWriter writer;
+            result.error = writeItem(item, view, false, writer);
+        }
+
+        if (m_resultCache && result.error == Bitmap::FileHandlingErrors::OK)
+        {
+            m_resultCache->store(cacheKey, item.outputFileName.c_str());
+        }
+    }
+
+    Bitmap::FileHandlingErrors BatchConverter::writeItem(BatchItem const& item, Bitmap::ImageView const& image, bool splitIntoBands, Ascii::OutputWriter& writer) const
+    {
+        Bitmap::FileHandlingErrors toReturn = writer.open(item.outputFileName.c_str());
+
+        if (toReturn == Bitmap::FileHandlingErrors::OK)
+        {
+            if (splitIntoBands)
+            {
+                writeInBands(image, writer);
+            }
+            else
+            {
+                writer.writeLines(*m_kernel, image, 0, image.getHeight());
+            }
+
+            toReturn = writer.close();
+        }
+
+        return toReturn;
+    }
+
+    void BatchConverter::writeInBands(Bitmap::ImageView const& image, Ascii::OutputWriter& writer) const
+    {
+        unsigned int const height = image.getHeight();
+        unsigned int const lineLength = m_kernel->getLineLength(image.getWidth());
+
+        unsigned int rowsPerBand = c_targetBandSize / lineLength;
+        rowsPerBand = rowsPerBand > 0 ? rowsPerBand : 1;
+
+        // only a window of bands is converted at a time, so a huge image doesn't need its whole output in memory
+        unsigned int const bandsPerWindow = m_workerPool->getThreadCount() * 2;
+
+        // bands can be stolen by workers collecting for other images, or for none
+        Instrumentation::StageMetrics* const metrics = Instrumentation::ScopedCollection::getCurrent();
+        std::vector<std::vector<char>> bands(bandsPerWindow);
+
+        for (unsigned int windowFirstRow = 0; windowFirstRow < height; windowFirstRow += rowsPerBand * bandsPerWindow)
+        {
+            std::atomic<unsigned int> remainingBands(0);
+            unsigned int bandCount = 0;
+
+            for (unsigned int firstRow = windowFirstRow; firstRow < height && bandCount < bandsPerWindow; firstRow += rowsPerBand)
+            {
+                unsigned int const rowCount = (height - firstRow) < rowsPerBand ? (height - firstRow) : rowsPerBand;
+                std::vector<char>& band = bands[bandCount++];
+
+                band.resize(static_cast<size_t>(lineLength) * rowCount);
+
+                remainingBands++;
+
+                m_workerPool->submit([this, &image, firstRow, rowCount, &band, &remainingBands, metrics]()
+                {
+                    Instrumentation::ScopedCollection collection(metrics);
+                    m_kernel->convertLines(image, firstRow, rowCount, band.data());
+                    remainingBands--;
+                });
+            }
+
+            // help out with this (or any other) work rather than sitting idle
+            m_workerPool->runUntilComplete(remainingBands);
+
+            for (unsigned int i = 0; i < bandCount; ++i)
+            {
+                writer.write(bands[i].data(), bands[i].size());
+            }
+        }
+    }
+
+    void BatchConverter::readStage(PipelineSlot& slot, ItemResult& result)
+    {
+        BatchItem const& item = *result.item;
+
+        slot.result = &result;
+        slot.fetchedFromCache = false;
+        slot.cacheKey.clear();
+
+        result.startTime = std::chrono::steady_clock::now();
+
+        Instrumentation::ScopedCollection collection(m_collectMetrics ? &result.metrics : nullptr);
+
+        // a hit is copied here and then just passed along, the image is never loaded
+        if (m_resultCache && m_resultCache->fetch(item.sourceFileName.c_str(), item.outputFileName.c_str(), slot.cacheKey))
+        {
+            slot.fetchedFromCache = true;
+            return;
+        }
+
+        result.error = slot.image.open(item.sourceFileName.c_str(), m_loadMethod);
+
+        if (result.error == Bitmap::FileHandlingErrors::OK)
+        {
+            Bitmap::ImageView const& view = slot.image.getView();
+            result.pixelCount = static_cast<unsigned long long>(view.getWidth()) * view.getHeight();
+        }
+    }
+
+    void BatchConverter::convertStage(PipelineSlot& slot)
+    {
+        ItemResult& result = *slot.result;
+
+        if (slot.fetchedFromCache || result.error != Bitmap::FileHandlingErrors::OK)
+        {
+            return;
+        }
+
+        Instrumentation::ScopedCollection collection(m_collectMetrics ? &result.metrics : nullptr);
+
+        Bitmap::ImageView view = slot.image.getView();
+
+        if (m_targetColumns > 0)
+        {
+            unsigned int targetWidth = 0;
+            unsigned int targetHeight = 0;
+
+            Bitmap::AreaDownscaler::calculateTargetSize(view.getWidth(), view.getHeight(), m_targetColumns, m_kernel->getCharactersPerPixel(), m_cellAspect, targetWidth, targetHeight);
+
+            thread_local Bitmap::AreaDownscaler downscaler;
+            downscaler.downscale(view, targetWidth, targetHeight, slot.downscaled.get());
+
+            view = slot.downscaled.get().getTopDownView();
+        }
+
+        slot.text.resize(static_cast<size_t>(m_kernel->getLineLength(view.getWidth())) * view.getHeight());
+        convertInBands(view, slot.text.data());
+
+        // a mapped file is done with, a loaded canvas stays with the slot for the next image
+        slot.image.close();
+    }
+
+    void BatchConverter::writeStage(PipelineSlot& slot)
+    {
+        ItemResult& result = *slot.result;
+        BatchItem const& item = *result.item;
+
+        if (!slot.fetchedFromCache && result.error == Bitmap::FileHandlingErrors::OK)
+        {
+            Instrumentation::ScopedCollection collection(m_collectMetrics ? &result.metrics : nullptr);
+
+            // the text is one block, big ones go straight to the file without touching the writer's buffer
+            thread_local Ascii::OutputWriter writer;
+            result.error = writer.open(item.outputFileName.c_str());
+
+            if (result.error == Bitmap::FileHandlingErrors::OK)
+            {
+                writer.write(slot.text.data(), slot.text.size());
+                result.error = writer.close();
+            }
+
+            if (m_resultCache && result.error == Bitmap::FileHandlingErrors::OK)
+            {
+                m_resultCache->store(slot.cacheKey, item.outputFileName.c_str());
+            }
+        }
+
+        if (m_collectMetrics)
+        {
+            result.metrics.addImage(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - result.startTime).count());
+        }
+    }
+
+    void BatchConverter::convertInBands(Bitmap::ImageView const& image, char* output) const
+    {
+        unsigned int const height = image.getHeight();
+        unsigned int const lineLength = m_kernel->getLineLength(image.getWidth());
+
+        unsigned long long const pixelCount = static_cast<unsigned long long>(image.getWidth()) * height;
+
+        if (pixelCount < c_splitThresholdPixels || m_workerPool->getThreadCount() < 2)
+        {
+            m_kernel->convertLines(image, 0, height, output);
+            return;
+        }
+
+        unsigned int rowsPerBand = c_targetBandSize / lineLength;
+        rowsPerBand = rowsPerBand > 0 ? rowsPerBand : 1;
+
+        Instrumentation::StageMetrics* const metrics = Instrumentation::ScopedCollection::getCurrent();
+        std::atomic<unsigned int> remainingBands(0);
+
+        // every band has its place in the output already, so they can all be in flight at once
+        for (unsigned int firstRow = 0; firstRow < height; firstRow += rowsPerBand)
+        {
+            unsigned int const rowCount = (height - firstRow) < rowsPerBand ? (height - firstRow) : rowsPerBand;
+            char* const bandOutput = output + static_cast<size_t>(firstRow) * lineLength;
+
+            remainingBands++;
+
+            m_workerPool->submit([this, &image, firstRow, rowCount, bandOutput, &remainingBands, metrics]()
+            {
+                Instrumentation::ScopedCollection collection(metrics);
+                m_kernel->convertLines(image, firstRow, rowCount, bandOutput);
+                remainingBands--;
+            });
+        }
+
+        // the converting thread isn't one of the pool's, it still helps rather than waiting
+        m_workerPool->runUntilComplete(remainingBands);
+    }
+}
@@ -0,0 +1,151 @@
+#ifndef BATCHCONVERTER_H
+#define BATCHCONVERTER_H
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "../Bitmap/CanvasPool.h"
+#include "../Bitmap/FileHandlingErrors.h"
+#include "../Bitmap/LoadedImage.h"
+#include "../Instrumentation/StageMetrics.h"
+
+// forward declarations
+namespace Ascii
+{
+    class GlyphRowKernel;
+    class OutputWriter;
+}
+
+namespace Cache
+{
+    class ResultCache;
+}
+
+namespace Threading
+{
+    class WorkStealingPool;
+}
+
+namespace Batch
+{
+    struct BatchItem
+    {
+        std::string sourceFileName;
+        std::string outputFileName;
+    };
+
+    // converts a whole list of images on a work stealing pool. Every image is a task of its own, and images big enough
+    // to be worth it split themselves into bands of rows that idle workers steal. A failing image is reported and
+    // skipped, it never stops the rest of the batch
+    class BatchConverter
+    {
+    public:
+        // a targetColumns of 0 converts images at full size, otherwise they're downscaled to that many columns first
+        BatchConverter(Ascii::GlyphRowKernel const& kernel, Bitmap::LoadedImage::Method loadMethod, unsigned int targetColumns, float cellAspect, Threading::WorkStealingPool& workerPool);
+
+        // a directory is searched for .bmp files, anything else is read as a list of file names, one per line. Output goes
+        // next to each source unless an output directory is given
+        // images already in the cache are copied out of it rather than converted, new ones are added. Null turns it off.
+        // The cache's settings have to match the kernel's
+        inline void setResultCache(Cache::ResultCache* resultCache) { m_resultCache = resultCache; }
+
+        static bool collectItems(char const* const directoryOrFileList, char const* const outputDirectory, std::vector<BatchItem>& items);
+
+        // prints every failure and the overall throughput once the batch is done. Returns the number of failed images.
+        // With a report, every image is timed stage by stage and added to it in the order of the items
+        unsigned int run(std::vector<BatchItem> const& items, Instrumentation::MetricsReport* metricsReport = nullptr);
+
+        // the same job as run, as three stages on three threads: one loads images, the calling thread converts them and
+        // one writes the text out. Slots holding the canvases and the text go round between the stages through lock free
+        // queues, so image N + 1 is read and image N - 1 written while image N converts, and once every slot has been
+        // round once nothing allocates. Big images are split into bands on the pool like they are in run
+        unsigned int runPipelined(std::vector<BatchItem> const& items, Instrumentation::MetricsReport* metricsReport = nullptr);
+
+    private:
+        struct ItemResult
+        {
+            ItemResult()
+                : item(nullptr)
+                , error(Bitmap::FileHandlingErrors::OK)
+                , pixelCount(0)
+            {
+            }
+
+            BatchItem const* item;
+            Bitmap::FileHandlingErrors error;
+            unsigned long long pixelCount;
+
+            Instrumentation::StageMetrics metrics;
+
+            // when a pipelined image was picked up, its stages run on different threads so there's no one scope to time it
+            std::chrono::steady_clock::time_point startTime;
+        };
+
+        // everything one image needs on its way through the pipeline, reused by the images after it
+        struct PipelineSlot
+        {
+            explicit PipelineSlot(Bitmap::CanvasPool& canvasPool)
+                : result(nullptr)
+                , image(canvasPool)
+                , downscaled(canvasPool)
+                , fetchedFromCache(false)
+            {
+            }
+
+            ItemResult* result;
+
+            Bitmap::LoadedImage image;
+            Bitmap::PooledCanvas downscaled;
+            std::vector<char> text;
+
+            std::string cacheKey;
+            bool fetchedFromCache;
+        };
+
+        void convertItem(ItemResult& result);
+
+        // for a catch (...) around one image's work. Whatever it threw is one failed image, it mustn't take the rest of
+        // the batch down with it
+        static Bitmap::FileHandlingErrors getCurrentExceptionError();
+
+        // prints every failure and the throughput, and adds the images to the report
+        unsigned int reportResults(std::vector<ItemResult> const& results, double elapsedSeconds, Instrumentation::MetricsReport* metricsReport) const;
+
+        void readStage(PipelineSlot& slot, ItemResult& result);
+        void convertStage(PipelineSlot& slot);
+        void writeStage(PipelineSlot& slot);
+
+        // the whole image straight into output, getLineLength * height characters, in bands on the pool if it's big
+        void convertInBands(Bitmap::ImageView const& image, char* output) const;
+
+        Bitmap::FileHandlingErrors writeItem(BatchItem const& item, Bitmap::ImageView const& image, bool splitIntoBands, Ascii::OutputWriter& writer) const;
+        void writeInBands(Bitmap::ImageView const& image, Ascii::OutputWriter& writer) const;
+
+    private:
+        // images smaller than this are converted by a single task
+        static unsigned long long const c_splitThresholdPixels;
+
+        // bands aim for roughly this much output
+        static unsigned int const c_targetBandSize;
+
+        // enough for every stage to have an image on the go and one waiting
+        static unsigned int const c_pipelineSlotCount;
+
+        Ascii::GlyphRowKernel const* m_kernel;
+        Bitmap::LoadedImage::Method m_loadMethod;
+        unsigned int m_targetColumns;
+        float m_cellAspect;
+        Threading::WorkStealingPool* m_workerPool;
+
+        Cache::ResultCache* m_resultCache;
+
+        // only set for the length of a run
+        bool m_collectMetrics;
+
+        // loaded and downscaled images borrow their canvases from here, so once it's warmed up images don't allocate
+        Bitmap::CanvasPool m_canvasPool;
+    };
+}
+
+#endif // BATCHCONVERTER_H
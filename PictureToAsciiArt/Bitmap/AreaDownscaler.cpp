@@ -0,0 +1,167 @@
+#include "AreaDownscaler.h"
+
+#include "Colour.h"
+#include "ImageCanvas.h"
+#include "ImageView.h"
+#include "../Instrumentation/StageMetrics.h"
+
+namespace Bitmap
+{
+    AreaDownscaler::AreaDownscaler()
+        : m_target(nullptr)
+        , m_sourceWidth(0)
+        , m_sourceHeight(0)
+        , m_targetWidth(0)
+        , m_targetHeight(0)
+        , m_sourceRowsAdded(0)
+        , m_nextTargetRow(0)
+    {
+    }
+
+    void AreaDownscaler::calculateTargetSize(unsigned int sourceWidth, unsigned int sourceHeight, unsigned int targetColumns, unsigned int charactersPerPixel, float cellAspect, unsigned int& targetWidth, unsigned int& targetHeight)
+    {
+        targetWidth = 0;
+        targetHeight = 0;
+
+        if (sourceWidth == 0 || sourceHeight == 0)
+        {
+            return;
+        }
+
+        charactersPerPixel = charactersPerPixel > 0 ? charactersPerPixel : 1;
+        cellAspect = cellAspect > 0.0f ? cellAspect : 1.0f;
+
+        targetWidth = targetColumns / charactersPerPixel;
+        targetWidth = targetWidth > 0 ? targetWidth : 1;
+        targetWidth = targetWidth < sourceWidth ? targetWidth : sourceWidth;
+
+        // a target pixel ends up charactersPerPixel glyph widths wide and cellAspect glyph widths tall on screen
+        double const height = static_cast<double>(sourceHeight) * targetWidth * charactersPerPixel / (static_cast<double>(sourceWidth) * cellAspect);
+
+        targetHeight = static_cast<unsigned int>(height + 0.5);
+        targetHeight = targetHeight > 0 ? targetHeight : 1;
+        targetHeight = targetHeight < sourceHeight ? targetHeight : sourceHeight;
+    }
+
+    void AreaDownscaler::begin(unsigned int sourceWidth, unsigned int sourceHeight, unsigned int targetWidth, unsigned int targetHeight, ImageCanvas& target)
+    {
+        m_target = &target;
+
+        m_sourceWidth = sourceWidth;
+        m_sourceHeight = sourceHeight;
+
+        // every target pixel has to cover at least one source pixel
+        m_targetWidth = targetWidth < sourceWidth ? targetWidth : sourceWidth;
+        m_targetHeight = targetHeight < sourceHeight ? targetHeight : sourceHeight;
+
+        if (m_targetWidth == 0 || m_targetHeight == 0)
+        {
+            m_targetWidth = 0;
+            m_targetHeight = 0;
+        }
+
+        m_sourceRowsAdded = 0;
+        m_nextTargetRow = 0;
+
+        m_columnBoundaries.resize(m_targetWidth + 1);
+
+        for (unsigned int i = 0; i <= m_targetWidth; ++i)
+        {
+            m_columnBoundaries[i] = m_targetWidth > 0 ? static_cast<unsigned int>(static_cast<unsigned long long>(i) * m_sourceWidth / m_targetWidth) : 0;
+        }
+
+        m_runningSums.assign((static_cast<size_t>(m_sourceWidth) + 1) * 3, 0);
+        m_boundarySums.assign(m_runningSums.size(), 0);
+
+        target.resize(m_targetWidth, m_targetHeight);
+    }
+
+    void AreaDownscaler::addRows(ImageView const& rows)
+    {
+        if (m_target == nullptr || rows.getWidth() != m_sourceWidth)
+        {
+            return;
+        }
+
+        Instrumentation::StageTimer timer(Instrumentation::Stage::Downscale);
+        timer.addPixels(static_cast<unsigned long long>(rows.getWidth()) * rows.getHeight());
+
+        for (unsigned int y = 0; y < rows.getHeight() && m_sourceRowsAdded < m_sourceHeight; ++y)
+        {
+            accumulateRow(rows.getRow(y));
+            ++m_sourceRowsAdded;
+
+            // the target is never taller than the source, so a source row finishes at most one target row
+            if (m_nextTargetRow < m_targetHeight && getSourceRowBoundary(m_nextTargetRow + 1) == m_sourceRowsAdded)
+            {
+                writeTargetRow();
+            }
+        }
+    }
+
+    void AreaDownscaler::downscale(ImageView const& source, unsigned int targetWidth, unsigned int targetHeight, ImageCanvas& target)
+    {
+        begin(source.getWidth(), source.getHeight(), targetWidth, targetHeight, target);
+        addRows(source);
+    }
+
+    void AreaDownscaler::accumulateRow(Colour const* row)
+    {
+        // entry x + 1 of the table is the sum of everything above and to the left of pixel x, so adding a row is a running
+        // sum along it added onto what's already there
+        unsigned long long blue = 0;
+        unsigned long long green = 0;
+        unsigned long long red = 0;
+
+        unsigned long long* sums = m_runningSums.data() + 3;
+
+        for (unsigned int x = 0; x < m_sourceWidth; ++x)
+        {
+            blue += row[x].blue;
+            green += row[x].green;
+            red += row[x].red;
+
+            sums[0] += blue;
+            sums[1] += green;
+            sums[2] += red;
+
+            sums += 3;
+        }
+    }
+
+    void AreaDownscaler::writeTargetRow()
+    {
+        unsigned long long const rowsCovered = getSourceRowBoundary(m_nextTargetRow + 1) - getSourceRowBoundary(m_nextTargetRow);
+
+        // the canvas is stored bottom to top
+        Colour* targetRow = m_target->getRawColourData() + static_cast<size_t>(m_targetHeight - 1 - m_nextTargetRow) * m_targetWidth;
+
+        unsigned long long const* running = m_runningSums.data();
+        unsigned long long const* boundary = m_boundarySums.data();
+
+        for (unsigned int i = 0; i < m_targetWidth; ++i)
+        {
+            size_t const left = static_cast<size_t>(m_columnBoundaries[i]) * 3;
+            size_t const right = static_cast<size_t>(m_columnBoundaries[i + 1]) * 3;
+
+            unsigned long long const area = (m_columnBoundaries[i + 1] - m_columnBoundaries[i]) * rowsCovered;
+
+            unsigned char averages[3];
+
+            for (size_t channel = 0; channel < 3; ++channel)
+            {
+                unsigned long long const sum = running[right + channel] - running[left + channel] - boundary[right + channel] + boundary[left + channel];
+                averages[channel] = static_cast<unsigned char>((sum + area / 2) / area);
+            }
+
+            targetRow[i].blue = averages[0];
+            targetRow[i].green = averages[1];
+            targetRow[i].red = averages[2];
+        }
+
+        // the next target row starts where this one ended
+        m_boundarySums = m_runningSums;
+
+        ++m_nextTargetRow;
+    }
+}
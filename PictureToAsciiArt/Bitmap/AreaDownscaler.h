@@ -0,0 +1,72 @@
+#ifndef AREADOWNSCALER_H
+#define AREADOWNSCALER_H
+
+#include <vector>
+
+// forward declarations
+namespace Bitmap
+{
+    struct Colour;
+    class ImageCanvas;
+    class ImageView;
+}
+
+namespace Bitmap
+{
+    // box filters an image down to a smaller canvas. Every target pixel is the average of the block of source pixels it
+    // covers, read out of a summed area table in constant time whatever the scale factor.
+    // rows are fed in top to bottom, all at once or a block at a time, and only two rows of the table are ever kept so
+    // the source never has to be in memory as a whole
+    class AreaDownscaler
+    {
+    public:
+        AreaDownscaler();
+
+        // size of the canvas needed for output targetColumns characters wide. Each target pixel is charactersPerPixel
+        // glyphs wide and a glyph is cellAspect times taller than it is wide, the height is picked to keep the picture's
+        // proportions. Never bigger than the source, this only scales down
+        static void calculateTargetSize(unsigned int sourceWidth, unsigned int sourceHeight, unsigned int targetColumns, unsigned int charactersPerPixel, float cellAspect, unsigned int& targetWidth, unsigned int& targetHeight);
+
+        // target is resized to the target size (clamped to the source size) and filled in as rows are added
+        void begin(unsigned int sourceWidth, unsigned int sourceHeight, unsigned int targetWidth, unsigned int targetHeight, ImageCanvas& target);
+
+        // rows carry on from wherever the previous call left off
+        void addRows(ImageView const& rows);
+
+        inline bool isComplete() const { return m_target != nullptr && m_nextTargetRow == m_targetHeight; }
+
+        // the whole image in one go
+        void downscale(ImageView const& source, unsigned int targetWidth, unsigned int targetHeight, ImageCanvas& target);
+
+    private:
+        void accumulateRow(Colour const* row);
+        void writeTargetRow();
+
+        // first source row/column that belongs to the given target row/column
+        inline unsigned int getSourceRowBoundary(unsigned int targetRow) const
+        {
+            return static_cast<unsigned int>(static_cast<unsigned long long>(targetRow) * m_sourceHeight / m_targetHeight);
+        }
+
+    private:
+        ImageCanvas* m_target;
+
+        unsigned int m_sourceWidth;
+        unsigned int m_sourceHeight;
+        unsigned int m_targetWidth;
+        unsigned int m_targetHeight;
+
+        unsigned int m_sourceRowsAdded;
+        unsigned int m_nextTargetRow;
+
+        // source column at which each target column starts, plus one past the end
+        std::vector<unsigned int> m_columnBoundaries;
+
+        // summed area table rows, 3 channels per entry and one more entry than the source is wide. The running row holds
+        // the sums of every source row added so far, the boundary row is a copy of it from where the current target row began
+        std::vector<unsigned long long> m_runningSums;
+        std::vector<unsigned long long> m_boundarySums;
+    };
+}
+
+#endif // AREADOWNSCALER_H
@@ -0,0 +1,43 @@
+#include "CanvasPool.h"
+
+#include <utility>
+
+namespace Bitmap
+{
+    CanvasPool::CanvasPool()
+    {
+    }
+
+    ImageCanvas CanvasPool::acquire()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        if (m_freeCanvases.empty())
+        {
+            return ImageCanvas(0, 0);
+        }
+
+        // last in first out - the one most likely to still be in the cache
+        ImageCanvas canvas(std::move(m_freeCanvases.back()));
+        m_freeCanvases.pop_back();
+
+        return canvas;
+    }
+
+    void CanvasPool::release(ImageCanvas&& canvas)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        m_freeCanvases.push_back(std::move(canvas));
+    }
+
+    void CanvasPool::trim()
+    {
+        std::vector<ImageCanvas> toFree;
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            toFree.swap(m_freeCanvases);
+        }
+    }
+}
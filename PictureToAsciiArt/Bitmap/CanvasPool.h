@@ -0,0 +1,64 @@
+#ifndef CANVASPOOL_H
+#define CANVASPOOL_H
+
+#include <mutex>
+#include <vector>
+
+#include "ImageCanvas.h"
+
+namespace Bitmap
+{
+    // keeps canvases that are done with so their buffers can be handed out again. Canvases only ever grow, so once every
+    // canvas in the pool has seen the biggest image going, loading another image doesn't allocate at all.
+    // safe to share between threads
+    class CanvasPool
+    {
+    public:
+        CanvasPool();
+
+        CanvasPool(CanvasPool const&) = delete;
+        CanvasPool& operator=(CanvasPool const&) = delete;
+
+        // the most recently released canvas, or an empty one if there's none left. Its size and contents are whatever
+        // they were, resize it before use
+        ImageCanvas acquire();
+
+        void release(ImageCanvas&& canvas);
+
+        // frees every canvas currently sitting in the pool
+        void trim();
+
+    private:
+        std::mutex m_mutex;
+
+        std::vector<ImageCanvas> m_freeCanvases;
+    };
+
+    // borrows a canvas from a pool for as long as it's in scope
+    class PooledCanvas
+    {
+    public:
+        explicit PooledCanvas(CanvasPool& pool)
+            : m_pool(&pool)
+            , m_canvas(pool.acquire())
+        {
+        }
+
+        ~PooledCanvas()
+        {
+            m_pool->release(std::move(m_canvas));
+        }
+
+        PooledCanvas(PooledCanvas const&) = delete;
+        PooledCanvas& operator=(PooledCanvas const&) = delete;
+
+        inline ImageCanvas& get() { return m_canvas; }
+
+    private:
+        CanvasPool* m_pool;
+
+        ImageCanvas m_canvas;
+    };
+}
+
+#endif // CANVASPOOL_H
@@ -25,6 +25,15 @@ namespace Bitmap
         ColourChannel green;
         ColourChannel red;
     };
+
+    // the rounded average of the three channels. Luma canvases store this in place of the colour
+    inline ColourChannel calculateLuma(ColourChannel blue, ColourChannel green, ColourChannel red)
+    {
+        return static_cast<ColourChannel>((blue + green + red + 1) / 3);
+    }
+
+    // views walk the pixel array of a 24-bit bitmap in place, so a colour must be laid out exactly as a BGR triple
+    static_assert(sizeof(Colour) == 3, "Colour must match the 3 byte BGR pixel layout of a 24-bit bitmap");
 }
 
 #endif
\ No newline at end of file
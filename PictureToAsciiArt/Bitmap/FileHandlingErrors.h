@@ -14,7 +14,31 @@ namespace Bitmap
         , PalettisedBitmapNotSupported
         , UnknownReadError
         , UnknownWriteError
+        , UnableToOpenFile
+        , FileMappingFailed
+        , OutOfMemory
     };
+
+    inline char const* getFileHandlingErrorName(FileHandlingErrors error)
+    {
+        switch (error)
+        {
+        case FileHandlingErrors::OK: return "OK";
+        case FileHandlingErrors::FileCorrupt: return "FileCorrupt";
+        case FileHandlingErrors::UnexpectedEndOfFile: return "UnexpectedEndOfFile";
+        case FileHandlingErrors::FileTypeUnknown: return "FileTypeUnknown";
+        case FileHandlingErrors::Not24BitColourBitmap: return "Not24BitColourBitmap";
+        case FileHandlingErrors::CompressionNotSupported: return "CompressionNotSupported";
+        case FileHandlingErrors::PalettisedBitmapNotSupported: return "PalettisedBitmapNotSupported";
+        case FileHandlingErrors::UnknownReadError: return "UnknownReadError";
+        case FileHandlingErrors::UnknownWriteError: return "UnknownWriteError";
+        case FileHandlingErrors::UnableToOpenFile: return "UnableToOpenFile";
+        case FileHandlingErrors::FileMappingFailed: return "FileMappingFailed";
+        case FileHandlingErrors::OutOfMemory: return "OutOfMemory";
+        }
+
+        return "Unknown";
+    }
 }
 
 #endif
\ No newline at end of file
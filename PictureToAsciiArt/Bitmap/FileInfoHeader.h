@@ -8,11 +8,44 @@ namespace Bitmap
         FileInfoHeader()
             : imageWidth(0)
             , imageHeight(0)
+            , topDown(false)
+            , bitsPerPixel(0)
+            , compression(0)
+            , imageDataSize(0)
+            , paletteColourCount(0)
+            , redMask(0)
+            , greenMask(0)
+            , blueMask(0)
         {
         }
 
         unsigned int imageWidth;
         unsigned int imageHeight;
+
+        // a negative height in the file means the first row is the top one rather than the bottom. The height above is
+        // always the positive one
+        bool topDown;
+
+        // 24, 32 or 16, or 8 and 4 for palettised bitmaps
+        unsigned short bitsPerPixel;
+        unsigned int compression;
+
+        // only needed for run length encoded bitmaps, uncompressed ones are allowed to leave it 0
+        unsigned int imageDataSize;
+
+        // entries in the colour table, 0 when there isn't one
+        unsigned int paletteColourCount;
+
+        // where each channel sits in a 16 or 32 bit pixel, whether the file gives them or they're the defaults
+        unsigned int redMask;
+        unsigned int greenMask;
+        unsigned int blueMask;
+
+        inline bool isPalettised() const { return paletteColourCount > 0; }
+        inline bool isMasked() const { return bitsPerPixel == 32 || bitsPerPixel == 16; }
+
+        // BI_RLE8 or BI_RLE4
+        inline bool isRunLengthEncoded() const { return compression == 1 || compression == 2; }
     };
 }
 
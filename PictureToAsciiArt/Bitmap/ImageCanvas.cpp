@@ -1,13 +1,43 @@
 #include "ImageCanvas.h"
 
 #include "Colour.h"
+#include "ImageView.h"
+#include "PlaneView.h"
+
+#include <new>
+#include <string.h>
+#include <utility>
 
 namespace Bitmap
 {
     ImageCanvas::ImageCanvas(unsigned int width, unsigned int height)
         :m_canvasWidth(width)
         , m_canvasHeight(height)
+        , m_storageMode(StorageMode::Interleaved)
         , m_colourData(nullptr)
+        , m_colourCapacity(0)
+        , m_planeData(nullptr)
+        , m_planeCapacity(0)
+        , m_planeRowStride(0)
+        , m_planeSize(0)
+        , m_palette(nullptr)
+        , m_paletteSize(0)
+    {
+        resize(width, height);
+    }
+
+    ImageCanvas::ImageCanvas(unsigned int width, unsigned int height, StorageMode storageMode)
+        :m_canvasWidth(width)
+        , m_canvasHeight(height)
+        , m_storageMode(storageMode)
+        , m_colourData(nullptr)
+        , m_colourCapacity(0)
+        , m_planeData(nullptr)
+        , m_planeCapacity(0)
+        , m_planeRowStride(0)
+        , m_planeSize(0)
+        , m_palette(nullptr)
+        , m_paletteSize(0)
     {
         resize(width, height);
     }
@@ -15,46 +45,269 @@ namespace Bitmap
     ImageCanvas::~ImageCanvas()
     {
         deleteColourData();
+        deletePlaneData();
+
+        delete[] m_palette;
+    }
+
+    ImageCanvas::ImageCanvas(ImageCanvas&& other) noexcept
+        :m_canvasWidth(0)
+        , m_canvasHeight(0)
+        , m_storageMode(StorageMode::Interleaved)
+        , m_colourData(nullptr)
+        , m_colourCapacity(0)
+        , m_planeData(nullptr)
+        , m_planeCapacity(0)
+        , m_planeRowStride(0)
+        , m_planeSize(0)
+        , m_palette(nullptr)
+        , m_paletteSize(0)
+    {
+        swap(other);
+    }
+
+    ImageCanvas& ImageCanvas::operator=(ImageCanvas&& other) noexcept
+    {
+        if (this != &other)
+        {
+            // whatever this held is freed along with the other canvas
+            swap(other);
+        }
+
+        return *this;
     }
 
     void ImageCanvas::resize(unsigned int width, unsigned int height)
+    {
+        resize(width, height, m_storageMode);
+    }
+
+    void ImageCanvas::resize(unsigned int width, unsigned int height, StorageMode storageMode)
     {
         m_canvasWidth = width;
         m_canvasHeight = height;
+        m_storageMode = storageMode;
 
-        deleteColourData();
+        if (m_storageMode == StorageMode::Interleaved)
+        {
+            size_t const pixelCount = static_cast<size_t>(m_canvasWidth) * m_canvasHeight;
+
+            if (pixelCount > m_colourCapacity)
+            {
+                deleteColourData();
+
+                m_colourData = new Colour[pixelCount];
+                m_colourCapacity = pixelCount;
+            }
+        }
+        else
+        {
+            // rows rounded up to the alignment so each one can be loaded with aligned vector loads
+            m_planeRowStride = (m_canvasWidth + c_planeAlignment - 1) & ~(c_planeAlignment - 1);
+            m_planeSize = m_planeRowStride * m_canvasHeight;
 
-        m_colourData = new Colour[m_canvasWidth * m_canvasHeight];
+            size_t const totalSize = m_planeSize;
+
+            if (totalSize > m_planeCapacity)
+            {
+                deletePlaneData();
+
+                m_planeData = static_cast<unsigned char*>(::operator new(totalSize, std::align_val_t(c_planeAlignment)));
+                m_planeCapacity = totalSize;
+            }
+        }
     }
 
-    Bitmap::Colour const& ImageCanvas::getPixel(unsigned int x, unsigned int y) const
+    void ImageCanvas::releaseUnusedMemory()
     {
-        // origin of the image is the top left corner
-        // right == m_canvasWidth
-        // left == 0
-        // top == m_canvasHeight == y=0
-        // bottom == 0
+        if (m_storageMode == StorageMode::Interleaved)
+        {
+            deletePlaneData();
 
-        unsigned int pixelIndex = 0;
+            size_t const pixelCount = static_cast<size_t>(m_canvasWidth) * m_canvasHeight;
 
-        if (x < m_canvasWidth && y < m_canvasHeight)
+            if (pixelCount < m_colourCapacity)
+            {
+                Colour* colourData = pixelCount > 0 ? new Colour[pixelCount] : nullptr;
+
+                for (size_t i = 0; i < pixelCount; ++i)
+                {
+                    colourData[i] = m_colourData[i];
+                }
+
+                deleteColourData();
+
+                m_colourData = colourData;
+                m_colourCapacity = pixelCount;
+            }
+        }
+        else
+        {
+            deleteColourData();
+
+            size_t const totalSize = m_planeSize;
+
+            if (totalSize < m_planeCapacity)
+            {
+                unsigned char* planeData = totalSize > 0 ? static_cast<unsigned char*>(::operator new(totalSize, std::align_val_t(c_planeAlignment))) : nullptr;
+
+                if (planeData)
+                {
+                    memcpy(planeData, m_planeData, totalSize);
+                }
+
+                deletePlaneData();
+
+                m_planeData = planeData;
+                m_planeCapacity = totalSize;
+            }
+        }
+    }
+
+    size_t ImageCanvas::getCapacityInBytes() const
+    {
+        return m_colourCapacity * sizeof(Colour) + m_planeCapacity;
+    }
+
+    unsigned char const* ImageCanvas::getPlaneRow(Plane plane, unsigned int storageRow) const
+    {
+        switch (m_storageMode)
         {
-            pixelIndex = (m_canvasHeight - y) * m_canvasWidth + x;
+        case StorageMode::Luma:
+            if (plane != Plane::Luma) { return nullptr; }
+            break;
+        case StorageMode::Indexed:
+            if (plane != Plane::Index) { return nullptr; }
+            break;
+        case StorageMode::Interleaved:
+            return nullptr;
         }
 
-        return m_colourData[pixelIndex];
+        return m_planeData + storageRow * m_planeRowStride;
+    }
+
+    unsigned char* ImageCanvas::getPlaneRow(Plane plane, unsigned int storageRow)
+    {
+        return const_cast<unsigned char*>(static_cast<ImageCanvas const*>(this)->getPlaneRow(plane, storageRow));
+    }
+
+    void ImageCanvas::setPalette(Colour const* colours, unsigned int colourCount)
+    {
+        if (m_palette == nullptr)
+        {
+            m_palette = new Colour[c_maximumPaletteSize];
+        }
+
+        m_paletteSize = colourCount < c_maximumPaletteSize ? colourCount : c_maximumPaletteSize;
+
+        for (unsigned int i = 0; i < c_maximumPaletteSize; ++i)
+        {
+            m_palette[i] = i < m_paletteSize ? colours[i] : Colour();
+        }
+    }
+
+    Bitmap::Colour ImageCanvas::getPixel(unsigned int x, unsigned int y) const
+    {
+        return readStoragePixel(calculatePixelIndex(x, y));
     }
 
     void ImageCanvas::setPixel(unsigned int x, unsigned int y, Colour const& colour) const
     {
-        unsigned int pixelIndex = 0;
+        writeStoragePixel(calculatePixelIndex(x, y), colour);
+    }
 
+    unsigned int ImageCanvas::calculatePixelIndex(unsigned int x, unsigned int y) const
+    {
+        // origin of the image is the top left corner, y == 0 is the top row. Rows are stored bottom up like the file,
+        // so the top row is the last one in storage. Anything outside the canvas goes to the first pixel
         if (x < m_canvasWidth && y < m_canvasHeight)
         {
-            pixelIndex = y * m_canvasWidth + x;
+            return (m_canvasHeight - 1 - y) * m_canvasWidth + x;
+        }
+
+        return 0;
+    }
+
+    void ImageCanvas::getStorageRow(unsigned int storageRow, Colour* colours) const
+    {
+        for (unsigned int i = 0; i < m_canvasWidth; ++i)
+        {
+            colours[i] = readStoragePixel(storageRow * m_canvasWidth + i);
+        }
+    }
+
+    ImageView ImageCanvas::getTopDownView() const
+    {
+        if (m_storageMode != StorageMode::Interleaved)
+        {
+            return ImageView();
         }
 
-        m_colourData[pixelIndex] = colour;
+        ptrdiff_t const rowLength = static_cast<ptrdiff_t>(m_canvasWidth) * sizeof(Colour);
+
+        unsigned char const* origin = reinterpret_cast<unsigned char const*>(m_colourData);
+
+        if (m_canvasHeight > 0)
+        {
+            origin += (m_canvasHeight - 1) * rowLength;
+        }
+
+        return ImageView(origin, m_canvasWidth, m_canvasHeight, -rowLength);
+    }
+
+    PlaneView ImageCanvas::getTopDownPlaneView(Plane plane) const
+    {
+        unsigned char const* origin = getPlaneRow(plane, m_canvasHeight > 0 ? m_canvasHeight - 1 : 0);
+
+        if (origin == nullptr)
+        {
+            return PlaneView();
+        }
+
+        return PlaneView(origin, m_canvasWidth, m_canvasHeight, -static_cast<ptrdiff_t>(m_planeRowStride));
+    }
+
+    Colour ImageCanvas::readStoragePixel(unsigned int pixelIndex) const
+    {
+        if (m_storageMode == StorageMode::Interleaved)
+        {
+            return m_colourData[pixelIndex];
+        }
+
+        unsigned int const storageRow = m_canvasWidth > 0 ? pixelIndex / m_canvasWidth : 0;
+        unsigned int const x = pixelIndex - storageRow * m_canvasWidth;
+
+        if (m_storageMode == StorageMode::Luma)
+        {
+            ColourChannel const luma = getPlaneRow(Plane::Luma, storageRow)[x];
+            return Colour(luma, luma, luma);
+        }
+
+        unsigned char const index = getPlaneRow(Plane::Index, storageRow)[x];
+        return index < m_paletteSize ? m_palette[index] : Colour();
+    }
+
+    void ImageCanvas::writeStoragePixel(unsigned int pixelIndex, Colour const& colour) const
+    {
+        if (m_storageMode == StorageMode::Interleaved)
+        {
+            m_colourData[pixelIndex] = colour;
+            return;
+        }
+
+        unsigned int const storageRow = m_canvasWidth > 0 ? pixelIndex / m_canvasWidth : 0;
+        unsigned int const x = pixelIndex - storageRow * m_canvasWidth;
+
+        // the plane data belongs to the canvas the same way the colour data does, this is only const because setPixel always was
+        ImageCanvas* const canvas = const_cast<ImageCanvas*>(this);
+
+        if (m_storageMode == StorageMode::Luma)
+        {
+            canvas->getPlaneRow(Plane::Luma, storageRow)[x] = calculateLuma(colour.blue, colour.green, colour.red);
+            return;
+        }
+
+        canvas->getPlaneRow(Plane::Index, storageRow)[x] = findNearestPaletteIndex(colour);
     }
 
     void ImageCanvas::setCanvasToTestImage()
@@ -106,43 +359,43 @@ namespace Bitmap
                 {
                     if (j < borderWidth)
                     {
-                        m_colourData[nextPixelIndex] = bottomLeft;
+                        writeStoragePixel(nextPixelIndex, bottomLeft);
                     }
                     else if (j > (m_canvasHeight - borderWidth))
                     {
-                        m_colourData[nextPixelIndex] = topLeft;
+                        writeStoragePixel(nextPixelIndex, topLeft);
                     }
                     else
                     {
-                        m_colourData[nextPixelIndex] = left;
+                        writeStoragePixel(nextPixelIndex, left);
                     }
                 }
                 else if (i > (m_canvasWidth - borderWidth))
                 {
                     if (j < 5)
                     {
-                        m_colourData[nextPixelIndex] = bottomRight;
+                        writeStoragePixel(nextPixelIndex, bottomRight);
                     }
                     else if (j > (m_canvasHeight - borderWidth))
                     {
-                        m_colourData[nextPixelIndex] = topRight;
+                        writeStoragePixel(nextPixelIndex, topRight);
                     }
                     else
                     {
-                        m_colourData[nextPixelIndex] = right;
+                        writeStoragePixel(nextPixelIndex, right);
                     }
                 }
                 else if (j < borderWidth)
                 {
-                    m_colourData[nextPixelIndex] = bottom;
+                    writeStoragePixel(nextPixelIndex, bottom);
                 }
                 else if (j > (m_canvasHeight - borderWidth))
                 {
-                    m_colourData[nextPixelIndex] = top;
+                    writeStoragePixel(nextPixelIndex, top);
                 }
                 else
                 {
-                    m_colourData[nextPixelIndex] = combinedColour;
+                    writeStoragePixel(nextPixelIndex, combinedColour);
                 }
 
                 ++nextPixelIndex;
@@ -157,6 +410,57 @@ namespace Bitmap
             delete[] m_colourData;
             m_colourData = nullptr;
         }
+
+        m_colourCapacity = 0;
     }
 
-}
\ No newline at end of file
+    void ImageCanvas::deletePlaneData()
+    {
+        if (m_planeData)
+        {
+            ::operator delete(m_planeData, std::align_val_t(c_planeAlignment));
+            m_planeData = nullptr;
+        }
+
+        m_planeCapacity = 0;
+    }
+
+    void ImageCanvas::swap(ImageCanvas& other)
+    {
+        std::swap(m_canvasWidth, other.m_canvasWidth);
+        std::swap(m_canvasHeight, other.m_canvasHeight);
+        std::swap(m_storageMode, other.m_storageMode);
+        std::swap(m_colourData, other.m_colourData);
+        std::swap(m_colourCapacity, other.m_colourCapacity);
+        std::swap(m_planeData, other.m_planeData);
+        std::swap(m_planeCapacity, other.m_planeCapacity);
+        std::swap(m_planeRowStride, other.m_planeRowStride);
+        std::swap(m_planeSize, other.m_planeSize);
+        std::swap(m_palette, other.m_palette);
+        std::swap(m_paletteSize, other.m_paletteSize);
+    }
+
+    unsigned char ImageCanvas::findNearestPaletteIndex(Colour const& colour) const
+    {
+        // only setPixel comes through here, so a straight search is fine
+        unsigned char nearestIndex = 0;
+        int nearestDistance = -1;
+
+        for (unsigned int i = 0; i < m_paletteSize; ++i)
+        {
+            int const blue = m_palette[i].blue - colour.blue;
+            int const green = m_palette[i].green - colour.green;
+            int const red = m_palette[i].red - colour.red;
+
+            int const distance = blue * blue + green * green + red * red;
+
+            if (nearestDistance < 0 || distance < nearestDistance)
+            {
+                nearestIndex = static_cast<unsigned char>(i);
+                nearestDistance = distance;
+            }
+        }
+
+        return nearestIndex;
+    }
+}
@@ -1,10 +1,14 @@
 #ifndef IMAGECANVAS_H
 #define IMAGECANVAS_H
 
+#include <stddef.h>
+
 // forward declarations
 namespace Bitmap
 {
     struct Colour;
+    class ImageView;
+    class PlaneView;
 }
 
 namespace Bitmap
@@ -12,29 +16,112 @@ namespace Bitmap
     class ImageCanvas
     {
     public:
+        enum class StorageMode
+        {
+            Interleaved     // BGR triples, laid out the same as the file
+            , Luma          // one plane holding the average of the three channels, a third of the memory
+            , Indexed       // one plane of palette indices, for palettised bitmaps. Loading any other kind into it
+                            // falls back to Interleaved
+        };
+
+        enum class Plane
+        {
+            Luma
+            , Index
+        };
+
+        static unsigned int const c_maximumPaletteSize = 256;
+
         ImageCanvas(unsigned int width, unsigned int height);
+        ImageCanvas(unsigned int width, unsigned int height, StorageMode storageMode);
         ~ImageCanvas();
 
+        ImageCanvas(ImageCanvas const&) = delete;
+        ImageCanvas& operator=(ImageCanvas const&) = delete;
+
+        // the buffers go with the canvas. Constructing leaves the one moved from empty, assigning swaps the two, so the
+        // one moved from is left holding the previous contents
+        ImageCanvas(ImageCanvas&& other) noexcept;
+        ImageCanvas& operator=(ImageCanvas&& other) noexcept;
+
+        // keeps the current storage mode. Buffers only ever grow - resizing within the capacity already held doesn't
+        // allocate, and the contents are left as they were rather than cleared
         void resize(unsigned int width, unsigned int height);
+        void resize(unsigned int width, unsigned int height, StorageMode storageMode);
+
+        // gives back whatever the current size doesn't need, including the buffer of the storage mode not in use
+        void releaseUnusedMemory();
+
+        // bytes held across both buffers
+        size_t getCapacityInBytes() const;
 
         inline unsigned int getWidth() const { return m_canvasWidth; }
         inline unsigned int getHeight() const { return m_canvasHeight; }
+        inline StorageMode getStorageMode() const { return m_storageMode; }
+
+        // null unless the canvas is Interleaved
+        inline Colour const* getRawColourData() const { return m_storageMode == StorageMode::Interleaved ? m_colourData : nullptr; }
+        inline Colour* getRawColourData() { return m_storageMode == StorageMode::Interleaved ? m_colourData : nullptr; }
+
+        // planes are stored bottom to top like the colour data, with every row padded out to start on a
+        // c_planeAlignment boundary. Null for planes the storage mode doesn't hold
+        unsigned char const* getPlaneRow(Plane plane, unsigned int storageRow) const;
+        unsigned char* getPlaneRow(Plane plane, unsigned int storageRow);
+        inline size_t getPlaneRowStride() const { return m_planeRowStride; }
 
-        inline Colour const* getRawColourData() const { return m_colourData; }
+        // what the indices of an Indexed canvas refer to. Anything past the end of the palette reads as black
+        void setPalette(Colour const* colours, unsigned int colourCount);
+        inline Colour const* getPalette() const { return m_palette; }
+        inline unsigned int getPaletteSize() const { return m_paletteSize; }
 
-        Colour const& getPixel(unsigned int x, unsigned int y) const;
+        // works whatever the storage mode. A Luma canvas stores the average of the channels and hands back that grey.
+        // y == 0 is the top row, the same as a view
+        Colour getPixel(unsigned int x, unsigned int y) const;
         void setPixel(unsigned int x, unsigned int y, Colour const& colour) const;
 
+        // expands one stored row back out into colours, whatever the storage mode
+        void getStorageRow(unsigned int storageRow, Colour* colours) const;
+
+        // rows are stored bottom to top, as they are in the file. The view presents them top to bottom. Interleaved only
+        ImageView getTopDownView() const;
+
+        // the same for a single plane. Luma for a Luma canvas, Index for an Indexed one
+        PlaneView getTopDownPlaneView(Plane plane) const;
+
         void setCanvasToTestImage();
 
+        static size_t const c_planeAlignment = 32;
+
     private:
+        unsigned int calculatePixelIndex(unsigned int x, unsigned int y) const;
+
+        Colour readStoragePixel(unsigned int pixelIndex) const;
+        void writeStoragePixel(unsigned int pixelIndex, Colour const& colour) const;
+        unsigned char findNearestPaletteIndex(Colour const& colour) const;
+
         void deleteColourData();
+        void deletePlaneData();
+
+        void swap(ImageCanvas& other);
 
     private:
         unsigned int m_canvasWidth;
         unsigned int m_canvasHeight;
 
+        StorageMode m_storageMode;
+
         Colour* m_colourData;
+        size_t m_colourCapacity; // in pixels
+
+        // the one plane the storage mode holds, in an aligned block
+        unsigned char* m_planeData;
+        size_t m_planeCapacity; // in bytes
+        size_t m_planeRowStride;
+        size_t m_planeSize;
+
+        // c_maximumPaletteSize colours, allocated the first time a palette is set
+        Colour* m_palette;
+        unsigned int m_paletteSize;
     };
 }
 
@@ -1,20 +1,37 @@
 #include "ImageFile.h"
 
 #include <stdlib.h>
+#include <vector>
 
 #include "Colour.h"
 #include "ImageCanvas.h"
 #include "FileInfoHeader.h"
 #include "FileTypeHeader.h"
+#include "ImageRegion.h"
+#include "MaskedPixelDecoder.h"
+#include "PortableStdio.h"
 
 namespace Bitmap
 {
     int const ImageFile::c_fileTypeSize = 14;
     unsigned int const ImageFile::c_imageInfoSize = 40;
+    unsigned int const ImageFile::c_imageInfoV2Size = 52;
+    unsigned int const ImageFile::c_imageInfoV3Size = 56;
+    unsigned int const ImageFile::c_imageInfoV4Size = 108;
+    unsigned int const ImageFile::c_imageInfoV5Size = 124;
+    int const ImageFile::c_headersSize = c_fileTypeSize + c_imageInfoSize;
     char const ImageFile::c_bitmapFormatSpecifier[] = { 0x42/*'B'*/, 0x4D/*'M'*/ };
     unsigned short ImageFile::c_numberOfPlanes = 1;
     unsigned short const ImageFile::c_bitsPerPixel = 24;
     unsigned int const ImageFile::c_compressionLevel = 0;
+    unsigned int const ImageFile::c_compressionRle8 = 1;
+    unsigned int const ImageFile::c_compressionRle4 = 2;
+    unsigned int const ImageFile::c_compressionBitfields = 3;
+    unsigned int const ImageFile::c_compressionAlphaBitfields = 6;
+
+    // runs can skip pixels without covering them, so a run length encoded image up to this size is taken at its word
+    // however little data it has. 16 million pixels is 64MB decoded
+    unsigned long long const ImageFile::c_largestSparseRunLengthImage = 1ull << 24;
 
     ImageFile::ImageFile()
     {
@@ -38,17 +55,23 @@ namespace Bitmap
             int const canvasWidth = canvas.getWidth();
             int const canvasHeight = canvas.getHeight();
 
+            // both headers are packed into one buffer and written together
+            unsigned char headers[c_headersSize];
+            unsigned char* nextHeaderByte = headers;
+
             //////////////////////////////////////////////////////////////////////////
             // File header
             //////////////////////////////////////////////////////////////////////////
 
-            toReturn = writeFileHeader(*file, canvasWidth, canvasHeight);
+            writeFileHeader(nextHeaderByte, canvasWidth, canvasHeight);
 
             //////////////////////////////////////////////////////////////////////////
             // Info Header - typeof(BITMAPINFOHEADER)
             //////////////////////////////////////////////////////////////////////////
 
-            if (toReturn == FileHandlingErrors::OK) { toReturn = writeInfoHeader(*file, canvasWidth, canvasHeight); }
+            writeInfoHeader(nextHeaderByte, canvasWidth, canvasHeight);
+
+            toReturn = writeValues<unsigned char>(*file, headers, c_headersSize);
 
             //////////////////////////////////////////////////////////////////////////
             // Colour table
@@ -70,6 +93,11 @@ namespace Bitmap
     }
 
     FileHandlingErrors ImageFile::load(char const* const filename, ImageCanvas& canvas)
+    {
+        return load(filename, ImageRegion(), canvas);
+    }
+
+    FileHandlingErrors ImageFile::load(char const* const filename, ImageRegion const& region, ImageCanvas& canvas)
     {
         // written using:
         // https://itnext.io/bits-to-bitmaps-a-simple-walkthrough-of-bmp-image-format-765dc6857393
@@ -82,47 +110,150 @@ namespace Bitmap
 
         FILE* file = openFileStream(filename, FileMode::Read);
 
-        if (file)
+        if (file == nullptr)
         {
-            //////////////////////////////////////////////////////////////////////////
-            // File header
-            //////////////////////////////////////////////////////////////////////////
-            
-            FileTypeHeader typeHeader;
-            toReturn = loadFileHeader(*file, typeHeader);
+            toReturn = FileHandlingErrors::UnableToOpenFile;
+        }
+        else
+        {
+            toReturn = loadImage(*file, region, canvas);
 
-            //////////////////////////////////////////////////////////////////////////
-            // Info Header - typeof(BITMAPINFOHEADER)
-            //////////////////////////////////////////////////////////////////////////
+            closeFileStream(*file);
+        }
 
-            FileInfoHeader infoHeader;
-            if (toReturn == FileHandlingErrors::OK) { toReturn = loadInfoHeader(*file, infoHeader); }
+        return toReturn;
+    }
 
-            //////////////////////////////////////////////////////////////////////////
-            // Colour table
-            //////////////////////////////////////////////////////////////////////////
+    FileHandlingErrors ImageFile::load(unsigned char const* data, size_t size, ImageCanvas& canvas)
+    {
+        return load(data, size, ImageRegion(), canvas);
+    }
 
-            // skip the colour table - we only do 256-bit colours which don't need the colour table
-            // you only need the colour table for pictures with bitsPerPixel <= 8;
+    FileHandlingErrors ImageFile::load(unsigned char const* data, size_t size, ImageRegion const& region, ImageCanvas& canvas)
+    {
+        MemoryReader reader = { data, size, 0 };
 
-            //////////////////////////////////////////////////////////////////////////
-            // Pixel data
-            //////////////////////////////////////////////////////////////////////////
+        return loadImage(reader, region, canvas);
+    }
 
-            if (toReturn == FileHandlingErrors::OK)
+    RegionLayout ImageFile::calculateRegionLayout(FileTypeHeader const& typeHeader, FileInfoHeader const& infoHeader, ImageRegion const& region) const
+    {
+        RegionLayout layout;
+        layout.region = region.clippedTo(infoHeader.imageWidth, infoHeader.imageHeight);
+
+        // in bits, rows of 4 bit pixels can start half way through a byte
+        size_t const firstBit = static_cast<size_t>(layout.region.x) * infoHeader.bitsPerPixel;
+        size_t const endBit = static_cast<size_t>(layout.region.x + layout.region.width) * infoHeader.bitsPerPixel;
+
+        layout.rowStride = calculateScanlineLength(infoHeader.imageWidth, infoHeader.bitsPerPixel);
+        layout.rowLength = layout.region.width > 0 ? (endBit + 7) / 8 - firstBit / 8 : 0;
+        layout.firstNibble = static_cast<unsigned int>(firstBit % 8) / 4;
+        layout.seekEachRow = layout.region.width != infoHeader.imageWidth;
+
+        // the region's top row is the first the file holds when it's top down, otherwise its bottom row is
+        unsigned int const firstFileRow = infoHeader.topDown ? layout.region.y : infoHeader.imageHeight - layout.region.y - layout.region.height;
+
+        layout.firstRowOffset = typeHeader.offsetToBitmapData + static_cast<size_t>(firstFileRow) * layout.rowStride + firstBit / 8;
+
+        return layout;
+    }
+
+    template<typename SOURCE>
+    FileHandlingErrors ImageFile::loadImage(SOURCE& source, ImageRegion const& region, ImageCanvas& canvas)
+    {
+        //////////////////////////////////////////////////////////////////////////
+        // File header and Info Header - typeof(BITMAPINFOHEADER)
+        //////////////////////////////////////////////////////////////////////////
+
+        FileTypeHeader typeHeader;
+        FileInfoHeader infoHeader;
+        FileHandlingErrors toReturn = loadHeadersFrom(source, typeHeader, infoHeader);
+
+        //////////////////////////////////////////////////////////////////////////
+        // Colour table
+        //////////////////////////////////////////////////////////////////////////
+
+        // only palettised bitmaps have one, 24-bit colours are stored as they are
+        Colour palette[ImageCanvas::c_maximumPaletteSize];
+
+        if (toReturn == FileHandlingErrors::OK && infoHeader.isPalettised()) { toReturn = loadPaletteFrom(source, infoHeader, palette); }
+
+        //////////////////////////////////////////////////////////////////////////
+        // Pixel data
+        //////////////////////////////////////////////////////////////////////////
+
+        if (toReturn == FileHandlingErrors::OK) { toReturn = seekTo(source, typeHeader.offsetToBitmapData); } // move to the pixel data
+
+        if (toReturn == FileHandlingErrors::OK) { toReturn = checkPixelDataSize(infoHeader, getRemainingSize(source)); }
+
+        if (toReturn == FileHandlingErrors::OK)
+        {
+            // there are only indices to keep if the bitmap has a palette
+            ImageCanvas::StorageMode storageMode = canvas.getStorageMode();
+
+            if (storageMode == ImageCanvas::StorageMode::Indexed && !infoHeader.isPalettised())
             {
-                fseek(file, typeHeader.offsetToBitmapData, SEEK_SET); // move to the pixel data
-                canvas.resize(infoHeader.imageWidth, infoHeader.imageHeight); // prepare the canvas
-                toReturn = loadCanvasColourData(*file, canvas);
+                storageMode = ImageCanvas::StorageMode::Interleaved;
             }
 
-            closeFileStream(*file);
+            // only the region is kept, and unless the pixels are run length encoded only the region is read
+            RegionLayout const layout = calculateRegionLayout(typeHeader, infoHeader, region);
+
+            canvas.resize(layout.region.width, layout.region.height, storageMode); // prepare the canvas
+
+            if (infoHeader.isPalettised())
+            {
+                if (storageMode == ImageCanvas::StorageMode::Indexed)
+                {
+                    canvas.setPalette(palette, infoHeader.paletteColourCount);
+                }
+
+                toReturn = loadIndexedColourData(source, infoHeader, layout, palette, canvas);
+            }
+            else if (infoHeader.isMasked())
+            {
+                toReturn = loadMaskedColourData(source, infoHeader, layout, canvas);
+            }
+            else
+            {
+                toReturn = loadCanvasColourData(source, infoHeader, layout, canvas);
+            }
         }
 
         return toReturn;
     }
 
-    FileHandlingErrors ImageFile::loadFileHeader(FILE& file, FileTypeHeader& typeHeader)
+    FileHandlingErrors ImageFile::loadHeaders(FILE& file, FileTypeHeader& typeHeader, FileInfoHeader& infoHeader)
+    {
+        return loadHeadersFrom(file, typeHeader, infoHeader);
+    }
+
+    FileHandlingErrors ImageFile::loadHeaders(unsigned char const* data, size_t size, FileTypeHeader& typeHeader, FileInfoHeader& infoHeader)
+    {
+        MemoryReader reader = { data, size, 0 };
+
+        return loadHeadersFrom(reader, typeHeader, infoHeader);
+    }
+
+    FileHandlingErrors ImageFile::loadPalette(FILE& file, FileInfoHeader const& infoHeader, Colour* palette)
+    {
+        return loadPaletteFrom(file, infoHeader, palette);
+    }
+
+    template<typename SOURCE>
+    FileHandlingErrors ImageFile::loadHeadersFrom(SOURCE& source, FileTypeHeader& typeHeader, FileInfoHeader& infoHeader)
+    {
+        Instrumentation::StageTimer timer(Instrumentation::Stage::HeaderParse);
+
+        FileHandlingErrors toReturn = loadFileHeader(source, typeHeader);
+
+        if (toReturn == FileHandlingErrors::OK) { toReturn = loadInfoHeader(source, infoHeader); }
+
+        return toReturn;
+    }
+
+    template<typename SOURCE>
+    FileHandlingErrors ImageFile::loadFileHeader(SOURCE& file, FileTypeHeader& typeHeader)
     {
         FileHandlingErrors toReturn = FileHandlingErrors::OK;
 
@@ -150,7 +281,8 @@ namespace Bitmap
         return toReturn;
     }
 
-    FileHandlingErrors ImageFile::loadInfoHeader(FILE& file, FileInfoHeader& infoHeader)
+    template<typename SOURCE>
+    FileHandlingErrors ImageFile::loadInfoHeader(SOURCE& file, FileInfoHeader& infoHeader)
     {
         FileHandlingErrors toReturn = FileHandlingErrors::OK;
 
@@ -158,7 +290,9 @@ namespace Bitmap
         toReturn = readValue<unsigned int>(file, infoHeaderSize);
 
         if (toReturn == FileHandlingErrors::OK) { toReturn = readValue<unsigned int>(file, infoHeader.imageWidth); }
-        if (toReturn == FileHandlingErrors::OK) { toReturn = readValue<unsigned int>(file, infoHeader.imageHeight); }
+
+        int imageHeight = 0;
+        if (toReturn == FileHandlingErrors::OK) { toReturn = readValue<int>(file, imageHeight); }
 
         unsigned short numPlanes = 0;
         if (toReturn == FileHandlingErrors::OK) { toReturn = readValue<unsigned short>(file, numPlanes); }
@@ -184,61 +318,503 @@ namespace Bitmap
         unsigned int importantColours = 0;
         if (toReturn == FileHandlingErrors::OK) { toReturn = readValue<unsigned int>(file, importantColours); }
 
-        if (infoHeaderSize != c_imageInfoSize) { toReturn = FileHandlingErrors::FileCorrupt; }
+        // V2 and later headers carry the channel masks themselves. A plain one has them straight after it when the
+        // compression says so, where the colour table would otherwise be
+        unsigned int masks[4] = { 0, 0, 0, 0 }; // red, green, blue, alpha
+        size_t maskCount = 0;
+
+        if (infoHeaderSize >= c_imageInfoV3Size) { maskCount = 4; }
+        else if (infoHeaderSize >= c_imageInfoV2Size) { maskCount = 3; }
+        else if (compression == c_compressionBitfields) { maskCount = 3; }
+        else if (compression == c_compressionAlphaBitfields) { maskCount = 4; }
+
+        if (toReturn == FileHandlingErrors::OK && maskCount > 0) { toReturn = readValues<unsigned int>(file, masks, maskCount); }
+
+        bool const knownHeaderSize = infoHeaderSize == c_imageInfoSize || infoHeaderSize == c_imageInfoV2Size || infoHeaderSize == c_imageInfoV3Size
+            || infoHeaderSize == c_imageInfoV4Size || infoHeaderSize == c_imageInfoV5Size;
+
+        // the rest of a V4 or V5 header is colour space and gamma, which doesn't change which glyph a pixel gets
+        if (toReturn == FileHandlingErrors::OK && knownHeaderSize && infoHeaderSize > c_imageInfoV3Size)
+        {
+            unsigned char colourSpace[c_imageInfoV5Size - c_imageInfoV3Size];
+            toReturn = readValues<unsigned char>(file, colourSpace, infoHeaderSize - c_imageInfoV3Size);
+        }
+
+        if (!knownHeaderSize) { toReturn = FileHandlingErrors::FileCorrupt; }
         if (numPlanes != c_numberOfPlanes) { toReturn = FileHandlingErrors::FileCorrupt; }
-        if (bitsPerPixel != c_bitsPerPixel) { toReturn = FileHandlingErrors::Not24BitColourBitmap; }
-        if (compression != c_compressionLevel) { toReturn = FileHandlingErrors::CompressionNotSupported; }
-        if (coloursUsed != 0 && coloursUsed != 2 << 24 ) { toReturn = FileHandlingErrors::PalettisedBitmapNotSupported; }
-        if (importantColours != 0 ) { toReturn = FileHandlingErrors::PalettisedBitmapNotSupported; }
+
+        if (bitsPerPixel == 8 || bitsPerPixel == 4)
+        {
+            // each depth has a run length encoding of its own
+            unsigned int const maximumColours = 1u << bitsPerPixel;
+            unsigned int const runLengthCompression = bitsPerPixel == 8 ? c_compressionRle8 : c_compressionRle4;
+
+            if (compression != c_compressionLevel && compression != runLengthCompression) { toReturn = FileHandlingErrors::CompressionNotSupported; }
+
+            // the runs are read in one go, so unlike uncompressed pixel data their size has to be given
+            if (compression == runLengthCompression && compressedImageSize == 0) { toReturn = FileHandlingErrors::FileCorrupt; }
+            if (coloursUsed > maximumColours) { toReturn = FileHandlingErrors::FileCorrupt; }
+
+            // 0 colours used means the full 2^bitsPerPixel. Important colours is only a hint for displays, it's ignored
+            infoHeader.paletteColourCount = coloursUsed != 0 ? coloursUsed : maximumColours;
+        }
+        else if (bitsPerPixel == 32 || bitsPerPixel == 16)
+        {
+            bool const bitfields = compression == c_compressionBitfields || compression == c_compressionAlphaBitfields;
+
+            if (compression != c_compressionLevel && !bitfields) { toReturn = FileHandlingErrors::CompressionNotSupported; }
+
+            if (!bitfields)
+            {
+                // uncompressed they're BGRX, or 5 bits a channel with the top bit unused
+                masks[0] = bitsPerPixel == 32 ? 0x00FF0000u : 0x7C00u;
+                masks[1] = bitsPerPixel == 32 ? 0x0000FF00u : 0x03E0u;
+                masks[2] = bitsPerPixel == 32 ? 0x000000FFu : 0x001Fu;
+            }
+
+            for (int i = 0; i < 3; ++i)
+            {
+                if (!isValidChannelMask(masks[i], bitsPerPixel)) { toReturn = FileHandlingErrors::FileCorrupt; }
+            }
+
+            // alpha is left out, every pixel is taken as opaque. The colour table they're allowed is only a hint for displays
+            infoHeader.redMask = masks[0];
+            infoHeader.greenMask = masks[1];
+            infoHeader.blueMask = masks[2];
+        }
+        else
+        {
+            if (bitsPerPixel == 1) { toReturn = FileHandlingErrors::PalettisedBitmapNotSupported; }
+            else if (bitsPerPixel != c_bitsPerPixel) { toReturn = FileHandlingErrors::Not24BitColourBitmap; }
+
+            if (compression != c_compressionLevel) { toReturn = FileHandlingErrors::CompressionNotSupported; }
+            if (coloursUsed != 0 && coloursUsed != 2 << 24 ) { toReturn = FileHandlingErrors::PalettisedBitmapNotSupported; }
+            if (importantColours != 0 ) { toReturn = FileHandlingErrors::PalettisedBitmapNotSupported; }
+        }
+
+        // top down bitmaps can't be compressed
+        bool const topDown = imageHeight < 0;
+
+        if (topDown && (compression == c_compressionRle8 || compression == c_compressionRle4)) { toReturn = FileHandlingErrors::FileCorrupt; }
+
+        infoHeader.imageHeight = topDown ? 0u - static_cast<unsigned int>(imageHeight) : static_cast<unsigned int>(imageHeight);
+        infoHeader.topDown = topDown;
+        infoHeader.bitsPerPixel = bitsPerPixel;
+        infoHeader.compression = compression;
+        infoHeader.imageDataSize = compressedImageSize;
+
+        return toReturn;
+    }
+
+    bool ImageFile::isValidChannelMask(unsigned int mask, unsigned int bitsPerPixel) const
+    {
+        // a single run of set bits, all of them inside the pixel
+        unsigned int const lowestBit = mask & (~mask + 1);
+
+        return mask != 0 && ((mask + lowestBit) & mask) == 0 && (bitsPerPixel >= 32 || (mask >> bitsPerPixel) == 0);
+    }
+
+    template<typename SOURCE>
+    FileHandlingErrors ImageFile::loadPaletteFrom(SOURCE& source, FileInfoHeader const& infoHeader, Colour* palette)
+    {
+        // every entry is blue, green, red and a reserved byte
+        unsigned char table[ImageCanvas::c_maximumPaletteSize * 4];
+
+        unsigned int const colourCount = infoHeader.paletteColourCount < ImageCanvas::c_maximumPaletteSize ? infoHeader.paletteColourCount : ImageCanvas::c_maximumPaletteSize;
+
+        FileHandlingErrors toReturn = readValues<unsigned char>(source, table, colourCount * 4);
+
+        for (unsigned int i = 0; i < ImageCanvas::c_maximumPaletteSize; ++i)
+        {
+            palette[i] = (toReturn == FileHandlingErrors::OK && i < colourCount) ? Colour(table[i * 4 + 2], table[i * 4 + 1], table[i * 4]) : Colour();
+        }
+
+        return toReturn;
+    }
+
+    template<typename SOURCE>
+    FileHandlingErrors ImageFile::readRegionRow(SOURCE& source, RegionLayout const& layout, unsigned int fileRow, unsigned char* destination)
+    {
+        FileHandlingErrors toReturn = FileHandlingErrors::OK;
+
+        // the rows of a full width region follow straight on from each other, only the first one needs a seek
+        if (fileRow == 0 || layout.seekEachRow) { toReturn = seekTo(source, layout.firstRowOffset + fileRow * layout.rowStride); }
+
+        if (toReturn == FileHandlingErrors::OK) { toReturn = readValues<unsigned char>(source, destination, layout.rowLength); }
+
+        // zero byte padding up to nearest 4 byte boundary, read past ready for the next row
+        if (toReturn == FileHandlingErrors::OK && !layout.seekEachRow && layout.rowStride > layout.rowLength)
+        {
+            unsigned char padding[3];
+            toReturn = readValues<unsigned char>(source, padding, layout.rowStride - layout.rowLength);
+        }
 
         return toReturn;
     }
 
-    FileHandlingErrors ImageFile::loadCanvasColourData(FILE& file, ImageCanvas& canvas)
+    template<typename SOURCE>
+    FileHandlingErrors ImageFile::loadCanvasColourData(SOURCE& file, FileInfoHeader const& infoHeader, RegionLayout const& layout, ImageCanvas& canvas)
     {
         FileHandlingErrors toReturn = FileHandlingErrors::OK;
 
         int const width = canvas.getWidth();
         int const height = canvas.getHeight();
 
-        // zero byte padding up to nearest 4 byte boundary
-        int const paddingBytes = calculateNumberOfScanlinePaddingBytes(width);
+        Instrumentation::StageTimer timer(Instrumentation::Stage::PixelRead);
+        timer.addPixels(static_cast<unsigned long long>(width) * height);
 
-        // top to bottom
-        for (int j = 0; j < height; ++j)
+        Colour* rawBuffer = canvas.getRawColourData();
+        ImageCanvas::StorageMode const storageMode = canvas.getStorageMode();
+
+        // an interleaved canvas holds pixels exactly as the file does, so its rows are read straight into place. The other
+        // modes read a whole scanline at a time into a buffer that's kept per thread, so loading doesn't allocate once warm
+        thread_local std::vector<unsigned char> scanline;
+
+        if (storageMode != ImageCanvas::StorageMode::Interleaved && scanline.size() < layout.rowLength)
+        {
+            scanline.resize(layout.rowLength);
+        }
+
+        // in file order, which is bottom to top unless the bitmap is top down. The canvas is always stored bottom up
+        for (int fileRow = 0; fileRow < height && toReturn == FileHandlingErrors::OK; ++fileRow)
         {
-            // left to right
-            for (int i = 0; i < width; ++i)
+            int const j = infoHeader.topDown ? height - 1 - fileRow : fileRow;
+
+            if (storageMode == ImageCanvas::StorageMode::Interleaved)
+            {
+                toReturn = readRegionRow(file, layout, fileRow, reinterpret_cast<unsigned char*>(&rawBuffer[j * width]));
+            }
+            else
             {
-                Colour loadedColour(0u, 0u, 0u);
+                toReturn = readRegionRow(file, layout, fileRow, scanline.data());
+
+                // decoded straight into the luma plane, the canvas never holds the interleaved pixels
+                if (toReturn == FileHandlingErrors::OK)
+                {
+                    unpackScanlineToLuma(scanline.data(), width, canvas.getPlaneRow(ImageCanvas::Plane::Luma, j));
+                }
+            }
+        }
+
+        return toReturn;
+    }
+
+    template<typename SOURCE>
+    FileHandlingErrors ImageFile::loadMaskedColourData(SOURCE& source, FileInfoHeader const& infoHeader, RegionLayout const& layout, ImageCanvas& canvas)
+    {
+        FileHandlingErrors toReturn = FileHandlingErrors::OK;
+
+        unsigned int const width = canvas.getWidth();
+        unsigned int const height = canvas.getHeight();
+
+        Instrumentation::StageTimer timer(Instrumentation::Stage::PixelRead);
+        timer.addPixels(static_cast<unsigned long long>(width) * height);
+
+        MaskedPixelDecoder const decoder(infoHeader);
+
+        size_t const packedLength = layout.rowLength;
+
+        Colour* rawBuffer = canvas.getRawColourData();
+        ImageCanvas::StorageMode const storageMode = canvas.getStorageMode();
+
+        // every row is decoded into the 24-bit layout. An interleaved canvas is decoded into directly, the other modes go
+        // through a scanline and are then unpacked the same as a 24-bit bitmap
+        thread_local std::vector<unsigned char> packedScanline;
+        thread_local std::vector<unsigned char> scanline;
+
+        if (packedScanline.size() < packedLength)
+        {
+            packedScanline.resize(packedLength);
+        }
+
+        if (storageMode != ImageCanvas::StorageMode::Interleaved && scanline.size() < static_cast<size_t>(width) * 3)
+        {
+            scanline.resize(static_cast<size_t>(width) * 3);
+        }
+
+        // in file order, stored bottom up
+        for (unsigned int fileRow = 0; fileRow < height && toReturn == FileHandlingErrors::OK; ++fileRow)
+        {
+            unsigned int const j = infoHeader.topDown ? height - 1 - fileRow : fileRow;
 
-                loadColour(file, loadedColour);
+            toReturn = readRegionRow(source, layout, fileRow, packedScanline.data());
 
-                canvas.setPixel(i, j, loadedColour);
+            if (toReturn != FileHandlingErrors::OK)
+            {
+                break;
             }
 
-            // read past padding
-            for (int i = 0; i < paddingBytes; ++i)
+            if (storageMode == ImageCanvas::StorageMode::Interleaved)
+            {
+                decoder.decodeRow(packedScanline.data(), width, reinterpret_cast<unsigned char*>(&rawBuffer[static_cast<size_t>(j) * width]));
+            }
+            else
             {
-                unsigned char padByte = 0;
-                toReturn = readValue<unsigned char>(file, padByte);
+                decoder.decodeRow(packedScanline.data(), width, scanline.data());
+                unpackScanlineToLuma(scanline.data(), width, canvas.getPlaneRow(ImageCanvas::Plane::Luma, j));
             }
         }
 
         return toReturn;
     }
 
-    FileHandlingErrors ImageFile::loadColour(FILE& file, Colour& colour)
+    template<typename SOURCE>
+    FileHandlingErrors ImageFile::loadIndexedColourData(SOURCE& source, FileInfoHeader const& infoHeader, RegionLayout const& layout, Colour const* palette, ImageCanvas& canvas)
     {
-        // colours are written as BGR rather than RGB
+        FileHandlingErrors toReturn = FileHandlingErrors::OK;
+
+        unsigned int const width = canvas.getWidth();
+        unsigned int const height = canvas.getHeight();
+        unsigned int const bitsPerPixel = infoHeader.bitsPerPixel;
+
+        Instrumentation::StageTimer timer(Instrumentation::Stage::PixelRead);
+        timer.addPixels(static_cast<unsigned long long>(width) * height);
+
+        bool const indexedCanvas = canvas.getStorageMode() == ImageCanvas::StorageMode::Indexed;
 
-        FileHandlingErrors toReturn = readValue<ColourChannel>(file, colour.blue);
-        if (toReturn == FileHandlingErrors::OK) { toReturn = readValue<ColourChannel>(file, colour.green); }
-        if (toReturn == FileHandlingErrors::OK) { toReturn = readValue<ColourChannel>(file, colour.red); }
+        // a Luma canvas gets each pixel's luma from its palette entry rather than working it out every time
+        unsigned char paletteLumas[ImageCanvas::c_maximumPaletteSize];
+
+        for (unsigned int i = 0; i < ImageCanvas::c_maximumPaletteSize; ++i)
+        {
+            paletteLumas[i] = calculateLuma(palette[i].blue, palette[i].green, palette[i].red);
+        }
+
+        // kept per thread like the scanline for 24-bit bitmaps, so loading doesn't allocate once warm
+        thread_local std::vector<unsigned char> indices;
+
+        if (infoHeader.compression != c_compressionLevel)
+        {
+            // runs can skip pixels and jump ahead whole rows, so the image is decoded in one go with anything skipped
+            // left at index 0. An Indexed canvas holding the whole image is decoded into in place, anything else gets a
+            // buffer of indices first. There's no way to find a row without decoding every one before it, so a region
+            // is cropped out afterwards
+            thread_local std::vector<unsigned char> encoded;
+
+            unsigned int const imageWidth = infoHeader.imageWidth;
+            unsigned int const imageHeight = infoHeader.imageHeight;
+
+            // checkPixelDataSize has already made sure the file holds this many
+            size_t const encodedSize = infoHeader.imageDataSize;
+
+            encoded.resize(encodedSize);
+            toReturn = readValues<unsigned char>(source, encoded.data(), encodedSize);
+
+            if (toReturn == FileHandlingErrors::OK)
+            {
+                if (indexedCanvas && !layout.seekEachRow && height == imageHeight)
+                {
+                    for (unsigned int j = 0; j < height; ++j)
+                    {
+                        memset(canvas.getPlaneRow(ImageCanvas::Plane::Index, j), 0, width);
+                    }
+
+                    decodeRunLengths(encoded.data(), encodedSize, bitsPerPixel, width, height, canvas.getPlaneRow(ImageCanvas::Plane::Index, 0), canvas.getPlaneRowStride());
+                }
+                else
+                {
+                    indices.assign(static_cast<size_t>(imageWidth) * imageHeight, 0u);
+
+                    decodeRunLengths(encoded.data(), encodedSize, bitsPerPixel, imageWidth, imageHeight, indices.data(), imageWidth);
+
+                    // run length encoded bitmaps are never top down, rows are bottom up like the canvas
+                    unsigned int const firstFileRow = imageHeight - layout.region.y - height;
+
+                    for (unsigned int j = 0; j < height; ++j)
+                    {
+                        storeIndexedRow(indices.data() + static_cast<size_t>(firstFileRow + j) * imageWidth + layout.region.x, j, palette, paletteLumas, canvas);
+                    }
+                }
+            }
+        }
+        else
+        {
+            thread_local std::vector<unsigned char> scanline;
+
+            if (scanline.size() < layout.rowLength)
+            {
+                scanline.resize(layout.rowLength);
+            }
+
+            if (indices.size() < width)
+            {
+                indices.resize(width);
+            }
+
+            // in file order, stored bottom up. Only uncompressed bitmaps can be top down
+            for (unsigned int fileRow = 0; fileRow < height && toReturn == FileHandlingErrors::OK; ++fileRow)
+            {
+                unsigned int const j = infoHeader.topDown ? height - 1 - fileRow : fileRow;
+
+                if (indexedCanvas && bitsPerPixel == 8)
+                {
+                    // a byte per pixel, so these are read straight into place
+                    toReturn = readRegionRow(source, layout, fileRow, canvas.getPlaneRow(ImageCanvas::Plane::Index, j));
+                }
+                else
+                {
+                    toReturn = readRegionRow(source, layout, fileRow, scanline.data());
+
+                    unsigned char const* rowIndices = scanline.data();
+
+                    if (bitsPerPixel == 4)
+                    {
+                        unpackNibbles(scanline.data(), layout.firstNibble, width, indices.data());
+                        rowIndices = indices.data();
+                    }
+
+                    if (toReturn == FileHandlingErrors::OK) { storeIndexedRow(rowIndices, j, palette, paletteLumas, canvas); }
+                }
+            }
+        }
 
         return toReturn;
     }
 
+    void ImageFile::decodeRunLengths(unsigned char const* data, size_t size, unsigned int bitsPerPixel, unsigned int width, unsigned int height, unsigned char* indices, size_t rowStride) const
+    {
+        // written using:
+        // https://learn.microsoft.com/en-us/windows/win32/gdi/bitmap-compression
+        unsigned int x = 0;
+        unsigned int y = 0;
+
+        size_t position = 0;
+
+        // in RLE4 the two nibbles of a byte take turns, high one first
+        auto getIndex = [bitsPerPixel](unsigned char const* values, unsigned int i)
+        {
+            return bitsPerPixel == 8 ? values[i] : static_cast<unsigned char>((i & 1) ? values[i / 2] & 0x0F : values[i / 2] >> 4);
+        };
+
+        while (position + 2 <= size && y < height)
+        {
+            unsigned int const count = data[position];
+            unsigned char const value = data[position + 1];
+            position += 2;
+
+            unsigned char* const row = indices + y * rowStride;
+
+            if (count > 0)
+            {
+                // a run of count pixels, all the same index in RLE8 or alternating between the two nibbles in RLE4
+                unsigned int const runLength = x < width ? (count < width - x ? count : width - x) : 0;
+
+                if (bitsPerPixel == 8)
+                {
+                    memset(row + x, value, runLength);
+                }
+                else
+                {
+                    for (unsigned int i = 0; i < runLength; ++i)
+                    {
+                        row[x + i] = getIndex(&value, i & 1);
+                    }
+                }
+
+                x += count;
+            }
+            else if (value == 0)
+            {
+                // end of line
+                x = 0;
+                ++y;
+            }
+            else if (value == 1)
+            {
+                // end of bitmap
+                break;
+            }
+            else if (value == 2)
+            {
+                // delta, moves right and up by the next two bytes
+                if (position + 2 > size)
+                {
+                    break;
+                }
+
+                x += data[position];
+                y += data[position + 1];
+                position += 2;
+            }
+            else
+            {
+                // absolute mode, value pixels given one by one and padded out to a 16 bit boundary
+                size_t const byteCount = bitsPerPixel == 8 ? value : (value + 1u) / 2;
+
+                if (position + byteCount > size)
+                {
+                    break;
+                }
+
+                for (unsigned int i = 0; i < value; ++i)
+                {
+                    if (x + i < width)
+                    {
+                        row[x + i] = getIndex(data + position, i);
+                    }
+                }
+
+                x += value;
+                position += (byteCount + 1) & ~static_cast<size_t>(1);
+            }
+        }
+    }
+
+    void ImageFile::unpackNibbles(unsigned char const* scanline, unsigned int firstNibble, unsigned int width, unsigned char* indices) const
+    {
+        // high nibble is the left hand pixel
+        for (unsigned int i = 0; i < width; ++i)
+        {
+            unsigned int const nibble = firstNibble + i;
+
+            indices[i] = (nibble & 1) ? scanline[nibble / 2] & 0x0F : scanline[nibble / 2] >> 4;
+        }
+    }
+
+    void ImageFile::storeIndexedRow(unsigned char const* indices, unsigned int storageRow, Colour const* palette, unsigned char const* paletteLumas, ImageCanvas& canvas) const
+    {
+        unsigned int const width = canvas.getWidth();
+
+        switch (canvas.getStorageMode())
+        {
+        case ImageCanvas::StorageMode::Indexed:
+            memcpy(canvas.getPlaneRow(ImageCanvas::Plane::Index, storageRow), indices, width);
+            break;
+        case ImageCanvas::StorageMode::Interleaved:
+        {
+            Colour* row = canvas.getRawColourData() + static_cast<size_t>(storageRow) * width;
+
+            for (unsigned int i = 0; i < width; ++i)
+            {
+                row[i] = palette[indices[i]];
+            }
+
+            break;
+        }
+        case ImageCanvas::StorageMode::Luma:
+        {
+            unsigned char* luma = canvas.getPlaneRow(ImageCanvas::Plane::Luma, storageRow);
+
+            for (unsigned int i = 0; i < width; ++i)
+            {
+                luma[i] = paletteLumas[indices[i]];
+            }
+
+            break;
+        }
+        }
+    }
+
+    void ImageFile::unpackScanlineToLuma(unsigned char const* scanline, int width, unsigned char* luma) const
+    {
+        for (int i = 0; i < width; ++i)
+        {
+            luma[i] = calculateLuma(scanline[0], scanline[1], scanline[2]);
+
+            scanline += 3;
+        }
+    }
+
     FileHandlingErrors ImageFile::writeCanvasColourData(FILE& file, ImageCanvas const& canvas)
     {
         FileHandlingErrors toReturn = FileHandlingErrors::OK;
@@ -249,113 +825,115 @@ namespace Bitmap
         // zero byte padding up to nearest 4 byte boundary
         int const paddingBytes = calculateNumberOfScanlinePaddingBytes(width);
 
+        // each scanline, padding included, is packed up and written in one go. The padding stays zero throughout
+        int const scanlineLength = width * 3 + paddingBytes;
+        std::vector<unsigned char> scanline(scanlineLength, 0u);
+
         Colour const* rawBuffer = canvas.getRawColourData();
 
+        // luma and indexed canvases are expanded back out a row at a time
+        std::vector<Colour> expandedRow(rawBuffer ? 0 : width);
+
         // top to bottom
         for (int j = 0; j < height && toReturn == FileHandlingErrors::OK; ++j)
         {
-            // left to right
-            for (int i = 0; i < width && toReturn == FileHandlingErrors::OK; ++i)
-            {
-                // pixel layout is different for file writing compared to indexing into it using an xy coordinate. This is file handling specific indexing so we can insert the padding in the right place
-                unsigned int const pixelIndex = j * width + i;
-
-                Colour const colourToWrite = rawBuffer[pixelIndex];
+            Colour const* row = nullptr;
 
-                toReturn = writeColour(file, colourToWrite);
+            if (rawBuffer)
+            {
+                row = &rawBuffer[j * width];
             }
-
-            // write padding bytes
-            for (int i = 0; i < paddingBytes && toReturn == FileHandlingErrors::OK; ++i)
+            else
             {
-                unsigned char zeroByte = 0;
-                toReturn = writeValue(file, zeroByte);
+                canvas.getStorageRow(j, expandedRow.data());
+                row = expandedRow.data();
             }
+
+            // pixel layout is different for file writing compared to indexing into it using an xy coordinate. This is file handling specific indexing so we can insert the padding in the right place
+            packScanline(row, width, scanline.data());
+
+            toReturn = writeValues<unsigned char>(file, scanline.data(), scanlineLength);
         }
 
         return toReturn;
     }
 
-    FileHandlingErrors ImageFile::writeColour(FILE& file, Colour const& colour)
+    void ImageFile::packScanline(Colour const* pixels, int width, unsigned char* scanline) const
     {
         // colours are written as BGR rather than RGB
 
-        FileHandlingErrors toReturn = writeValue<ColourChannel>(file, colour.blue);
-        if (toReturn == FileHandlingErrors::OK) { toReturn = writeValue<ColourChannel>(file, colour.green); }
-        if (toReturn == FileHandlingErrors::OK) { toReturn = writeValue<ColourChannel>(file, colour.red); }
+        // left to right
+        for (int i = 0; i < width; ++i)
+        {
+            scanline[0] = pixels[i].blue;
+            scanline[1] = pixels[i].green;
+            scanline[2] = pixels[i].red;
 
-        return toReturn;
+            scanline += 3;
+        }
     }
 
-    FileHandlingErrors ImageFile::writeInfoHeader(FILE& file, int totalImageWidth, int totalImageHeight)
+    void ImageFile::writeInfoHeader(unsigned char*& header, int totalImageWidth, int totalImageHeight)
     {
-        FileHandlingErrors toReturn = FileHandlingErrors::OK;
-
         // 4 bytes size of info header
-        if (toReturn == FileHandlingErrors::OK) { toReturn = writeValue<unsigned int>(file, c_imageInfoSize); }
+        packValue<unsigned int>(header, c_imageInfoSize);
 
         // 4 bytes for pixel width (horizontal) of the image
         unsigned int imagePixelWidth = totalImageWidth;
-        if (toReturn == FileHandlingErrors::OK) { toReturn = writeValue<unsigned int>(file, imagePixelWidth); }
+        packValue<unsigned int>(header, imagePixelWidth);
 
         // 4 bytes for pixel height (vertical) of the image
         unsigned int imagePixelHeight = totalImageHeight;
-        if (toReturn == FileHandlingErrors::OK) { toReturn = writeValue<unsigned int>(file, imagePixelHeight); }
+        packValue<unsigned int>(header, imagePixelHeight);
 
         // 2 bytes for the number of planes?
-        if (toReturn == FileHandlingErrors::OK) { toReturn = writeValue<unsigned short>(file, c_numberOfPlanes); }
+        packValue<unsigned short>(header, c_numberOfPlanes);
 
         // 2 bytess for the byte size of each pixel
-        if (toReturn == FileHandlingErrors::OK) { toReturn = writeValue<unsigned short>(file, c_bitsPerPixel); } // 24-bit colour palette so we can skip the colour palette bit
+        packValue<unsigned short>(header, c_bitsPerPixel); // 24-bit colour palette so we can skip the colour palette bit
 
         // 4 bytes for the level of compression
-        if (toReturn == FileHandlingErrors::OK) { toReturn = writeValue<unsigned int>(file, c_compressionLevel); }// 0 - BI_RGB (no compression) (other compression modes are simple Run Length compression)
+        packValue<unsigned int>(header, c_compressionLevel);// 0 - BI_RGB (no compression) (other compression modes are simple Run Length compression)
 
         // 4 bytes to specify the size of the compressed image
         unsigned int compressedImageSize = 0; // 0 as we're not using image compression
-        if (toReturn == FileHandlingErrors::OK) { toReturn = writeValue<unsigned int>(file, compressedImageSize); }
+        packValue<unsigned int>(header, compressedImageSize);
 
         // 4 bytes - representing the horizontal resolution of the target device. This parameter will be adjusted by the image 
         // processing application but should be set to '0' in decimal to indicate no preference
         int xPixelsPerM = 0;
-        if (toReturn == FileHandlingErrors::OK) { toReturn = writeValue<int>(file, xPixelsPerM); }
+        packValue<int>(header, xPixelsPerM);
 
         // 4 bytes - representing the verical resolution of the target device (same as the above for horizontal)
         int yPixelsPerM = 0;
-        if (toReturn == FileHandlingErrors::OK) { toReturn = writeValue<int>(file, yPixelsPerM); }
+        packValue<int>(header, yPixelsPerM);
 
         // 4 bytes - number of colours used. Set to zero so it uses 2^bitsPerPixel
         unsigned int coloursUsed = 0;
-        if (toReturn == FileHandlingErrors::OK) { toReturn = writeValue<unsigned int>(file, coloursUsed); }
+        packValue<unsigned int>(header, coloursUsed);
 
         // 4 bytes for number of colours. We can ignore this and set it to zero
         unsigned int importantColours = 0;
-        if (toReturn == FileHandlingErrors::OK) { toReturn = writeValue<unsigned int>(file, importantColours); }
-
-        return toReturn;
+        packValue<unsigned int>(header, importantColours);
     }
 
-    FileHandlingErrors ImageFile::writeFileHeader(FILE& file, int totalImageWidth, int totalImageHeight)
+    void ImageFile::writeFileHeader(unsigned char*& header, int totalImageWidth, int totalImageHeight)
     {
-        FileHandlingErrors toReturn = FileHandlingErrors::OK;
-
         // 2 bytes
-        if (toReturn == FileHandlingErrors::OK) { toReturn = writeValue<char>(file, c_bitmapFormatSpecifier[0]); }
-        if (toReturn == FileHandlingErrors::OK) { toReturn = writeValue<char>(file, c_bitmapFormatSpecifier[1]); }
+        packValue<char>(header, c_bitmapFormatSpecifier[0]);
+        packValue<char>(header, c_bitmapFormatSpecifier[1]);
 
         // 4 bytes
         unsigned int fileSize = calculateTotalFileSize(totalImageWidth, totalImageHeight);
-        if (toReturn == FileHandlingErrors::OK) { toReturn = writeValue<unsigned int>(file, fileSize); }
+        packValue<unsigned int>(header, fileSize);
 
         // 4 bytes - reserved to be utilised by an image processing application. Initialise to zero,
         unsigned int unused = 0;
-        if (toReturn == FileHandlingErrors::OK) { toReturn = writeValue<unsigned int>(file, unused); }
+        packValue<unsigned int>(header, unused);
 
         // 4 bytes to point to the start of the bit map data
         unsigned int offsetToBitmapData = calculateOffsetIntoFileForStartOfPixelData();
-        if (toReturn == FileHandlingErrors::OK) { toReturn = writeValue<unsigned int>(file, offsetToBitmapData); }
-
-        return toReturn;
+        packValue<unsigned int>(header, offsetToBitmapData);
     }
 
     FILE* ImageFile::openFileStream(char const* const filename, FileMode fileMode)
@@ -402,10 +980,120 @@ namespace Bitmap
         return paddingBytes;
     }
 
+    size_t ImageFile::calculateScanlineLength(unsigned int width, unsigned int bitsPerPixel) const
+    {
+        // rounded up to a whole number of 4 byte words
+        return (static_cast<size_t>(width) * bitsPerPixel + 31) / 32 * 4;
+    }
+
+    FileHandlingErrors ImageFile::checkPixelDataSize(FileInfoHeader const& infoHeader, size_t availableSize) const
+    {
+        FileHandlingErrors toReturn = FileHandlingErrors::OK;
+
+        unsigned int const height = infoHeader.imageHeight;
+
+        // worked out wide enough that no width can overflow it, and divided rather than multiplied out by the height
+        unsigned long long const rowStride = (static_cast<unsigned long long>(infoHeader.imageWidth) * infoHeader.bitsPerPixel + 31) / 32 * 4;
+
+        if (infoHeader.isRunLengthEncoded())
+        {
+            // a run is two bytes and covers at most 255 pixels. Anything bigger than the runs could cover has to be mostly
+            // skipped, which past a point is taken as corrupt or a few bytes could ask for any size of canvas
+            unsigned long long const pixelCount = static_cast<unsigned long long>(infoHeader.imageWidth) * height;
+            unsigned long long const coverablePixels = static_cast<unsigned long long>(infoHeader.imageDataSize / 2) * 255;
+
+            if (infoHeader.imageDataSize > availableSize)
+            {
+                toReturn = FileHandlingErrors::UnexpectedEndOfFile;
+            }
+            else if (pixelCount > coverablePixels && pixelCount > c_largestSparseRunLengthImage)
+            {
+                toReturn = FileHandlingErrors::FileCorrupt;
+            }
+        }
+        else if (height > 0 && availableSize / height < rowStride)
+        {
+            toReturn = FileHandlingErrors::UnexpectedEndOfFile;
+        }
+
+        return toReturn;
+    }
+
+    FileHandlingErrors ImageFile::checkPixelDataSize(FILE& file, FileTypeHeader const& typeHeader, FileInfoHeader const& infoHeader)
+    {
+        FileHandlingErrors toReturn = seekTo(file, typeHeader.offsetToBitmapData);
+
+        if (toReturn == FileHandlingErrors::OK) { toReturn = checkPixelDataSize(infoHeader, getRemainingSize(file)); }
+
+        return toReturn;
+    }
+
+    FileHandlingErrors ImageFile::checkPixelDataSize(unsigned char const* data, size_t size)
+    {
+        FileTypeHeader typeHeader;
+        FileInfoHeader infoHeader;
+
+        FileHandlingErrors toReturn = loadHeaders(data, size, typeHeader, infoHeader);
+
+        if (toReturn == FileHandlingErrors::OK && typeHeader.offsetToBitmapData > size)
+        {
+            toReturn = FileHandlingErrors::UnexpectedEndOfFile;
+        }
+
+        if (toReturn == FileHandlingErrors::OK) { toReturn = checkPixelDataSize(infoHeader, size - typeHeader.offsetToBitmapData); }
+
+        return toReturn;
+    }
+
+    FileHandlingErrors ImageFile::seekTo(FILE& file, size_t offset)
+    {
+#ifdef _WIN32
+        int const seekResult = _fseeki64(&file, static_cast<long long>(offset), SEEK_SET);
+#else
+        int const seekResult = fseeko(&file, static_cast<off_t>(offset), SEEK_SET);
+#endif
+
+        return seekResult == 0 ? FileHandlingErrors::OK : FileHandlingErrors::UnexpectedEndOfFile;
+    }
+
+    FileHandlingErrors ImageFile::seekTo(MemoryReader& reader, size_t offset)
+    {
+        if (offset > reader.size)
+        {
+            return FileHandlingErrors::UnexpectedEndOfFile;
+        }
+
+        reader.position = offset;
+
+        return FileHandlingErrors::OK;
+    }
+
+    size_t ImageFile::getRemainingSize(FILE& file)
+    {
+#ifdef _WIN32
+        long long const position = _ftelli64(&file);
+        _fseeki64(&file, 0, SEEK_END);
+        long long const end = _ftelli64(&file);
+        _fseeki64(&file, position, SEEK_SET);
+#else
+        off_t const position = ftello(&file);
+        fseeko(&file, 0, SEEK_END);
+        off_t const end = ftello(&file);
+        fseeko(&file, position, SEEK_SET);
+#endif
+
+        return end > position ? static_cast<size_t>(end - position) : 0;
+    }
+
+    size_t ImageFile::getRemainingSize(MemoryReader& reader)
+    {
+        return reader.size - reader.position;
+    }
+
     int ImageFile::calculateTotalFileSize(int totalImageWidth, int totalImageHeight) const
     {
         // 3 colour channels at 1 byte each and round up to nearest 4 byte boundary
-        int const pixelRowLength = totalImageWidth * sizeof(unsigned int) * 3;
+        int const pixelRowLength = totalImageWidth * sizeof(unsigned char) * 3;
 
         int const paddingBytes = calculateNumberOfScanlinePaddingBytes(totalImageWidth);
         int const totalRowLength = pixelRowLength + paddingBytes;
@@ -2,7 +2,10 @@
 #define BITMAP_H
 
 #include <stdio.h>
+#include <string.h>
 #include "FileHandlingErrors.h"
+#include "ImageRegion.h"
+#include "../Instrumentation/StageMetrics.h"
 
 // forward declarations
 namespace Bitmap
@@ -21,18 +24,85 @@ namespace Bitmap
         ImageFile();
 
         FileHandlingErrors write(char const* const filename, ImageCanvas const& canvas);
+        // decodes into whatever storage mode the canvas is already set up with. Palettised bitmaps, 8 or 4 bits per pixel
+        // and uncompressed or run length encoded, are expanded through their palette unless the canvas is Indexed
         FileHandlingErrors load(char const* const filename, ImageCanvas& canvas);
 
+        // the same for a bitmap that's already in memory
+        FileHandlingErrors load(unsigned char const* data, size_t size, ImageCanvas& canvas);
+
+        // only the region is kept, and the canvas ends up its size clipped to the image. Only the rows it covers are read,
+        // and when it's narrower than the image each row is seeked to so only its columns are too. Run length encoded
+        // bitmaps can't be read that way, they're decoded whole and then cropped
+        FileHandlingErrors load(char const* const filename, ImageRegion const& region, ImageCanvas& canvas);
+        FileHandlingErrors load(unsigned char const* data, size_t size, ImageRegion const& region, ImageCanvas& canvas);
+
+        // where the region's bytes are in an uncompressed pixel array, found from the start of the pixel data and the padded
+        // length of a scanline
+        RegionLayout calculateRegionLayout(FileTypeHeader const& typeHeader, FileInfoHeader const& infoHeader, ImageRegion const& region) const;
+
+        // parses and validates both headers, leaving the file positioned just after the info header and any channel masks
+        // that follow it. The V4 and V5 info headers are read too, past the masks they only add colour space details
+        FileHandlingErrors loadHeaders(FILE& file, FileTypeHeader& typeHeader, FileInfoHeader& infoHeader);
+
+        // the same for a bitmap that's already in memory, mapped or received whole
+        FileHandlingErrors loadHeaders(unsigned char const* data, size_t size, FileTypeHeader& typeHeader, FileInfoHeader& infoHeader);
+
+        // reads the colour table of a palettised bitmap, which follows straight on from the info header. The palette needs
+        // room for ImageCanvas::c_maximumPaletteSize colours, any the file doesn't have are left black
+        FileHandlingErrors loadPalette(FILE& file, FileInfoHeader const& infoHeader, Colour* palette);
+
+        int calculateNumberOfScanlinePaddingBytes(int totalImageWidth) const;
+
+        // one row of an uncompressed pixel array at any bit depth, padding included
+        size_t calculateScanlineLength(unsigned int width, unsigned int bitsPerPixel) const;
+
+        // whether the bytes left from the start of the pixel data can hold the pixel array the headers describe. Checked
+        // before anything is sized from them, so a made up width or height fails here rather than in the allocator
+        FileHandlingErrors checkPixelDataSize(FileInfoHeader const& infoHeader, size_t availableSize) const;
+
+        // the same for an open file, which is left positioned at the start of the pixel data
+        FileHandlingErrors checkPixelDataSize(FILE& file, FileTypeHeader const& typeHeader, FileInfoHeader const& infoHeader);
+
+        // and for a whole bitmap in memory, read from its own headers
+        FileHandlingErrors checkPixelDataSize(unsigned char const* data, size_t size);
+
     private:
-        FileHandlingErrors writeFileHeader(FILE& file, int totalImageWidth, int totalImageHeight);
-        FileHandlingErrors writeInfoHeader(FILE& file, int totalImageWidth, int totalImageHeight);
+        void writeFileHeader(unsigned char*& header, int totalImageWidth, int totalImageHeight);
+        void writeInfoHeader(unsigned char*& header, int totalImageWidth, int totalImageHeight);
         FileHandlingErrors writeCanvasColourData(FILE& file, ImageCanvas const& canvas);
-        FileHandlingErrors writeColour(FILE& file, Colour const& colour);
+        void packScanline(Colour const* pixels, int width, unsigned char* scanline) const;
 
-        FileHandlingErrors loadFileHeader(FILE& file, FileTypeHeader& typeHeader);
-        FileHandlingErrors loadInfoHeader(FILE& file, FileInfoHeader& infoHeader);
-        FileHandlingErrors loadCanvasColourData(FILE& file, ImageCanvas& canvas);
-        FileHandlingErrors loadColour(FILE& file, Colour& colour);
+        // everything is read through readValue and readValues, so it loads the same from a FILE or a MemoryReader
+        template<typename SOURCE>
+        FileHandlingErrors loadImage(SOURCE& source, ImageRegion const& region, ImageCanvas& canvas);
+        template<typename SOURCE>
+        FileHandlingErrors loadHeadersFrom(SOURCE& source, FileTypeHeader& typeHeader, FileInfoHeader& infoHeader);
+        template<typename SOURCE>
+        FileHandlingErrors loadFileHeader(SOURCE& source, FileTypeHeader& typeHeader);
+        template<typename SOURCE>
+        FileHandlingErrors loadInfoHeader(SOURCE& source, FileInfoHeader& infoHeader);
+        // a channel of a bit fields bitmap is one unbroken run of bits, inside the pixel
+        bool isValidChannelMask(unsigned int mask, unsigned int bitsPerPixel) const;
+        template<typename SOURCE>
+        FileHandlingErrors loadPaletteFrom(SOURCE& source, FileInfoHeader const& infoHeader, Colour* palette);
+        template<typename SOURCE>
+        FileHandlingErrors readRegionRow(SOURCE& source, RegionLayout const& layout, unsigned int fileRow, unsigned char* destination);
+        template<typename SOURCE>
+        FileHandlingErrors loadCanvasColourData(SOURCE& source, FileInfoHeader const& infoHeader, RegionLayout const& layout, ImageCanvas& canvas);
+        template<typename SOURCE>
+        FileHandlingErrors loadMaskedColourData(SOURCE& source, FileInfoHeader const& infoHeader, RegionLayout const& layout, ImageCanvas& canvas);
+        template<typename SOURCE>
+        FileHandlingErrors loadIndexedColourData(SOURCE& source, FileInfoHeader const& infoHeader, RegionLayout const& layout, Colour const* palette, ImageCanvas& canvas);
+
+        // rows of indices are rowStride apart, in the same bottom to top order as the file. Pixels the runs skip over or
+        // never reach are left as they were, anything that would land outside the image is dropped
+        void decodeRunLengths(unsigned char const* data, size_t size, unsigned int bitsPerPixel, unsigned int width, unsigned int height, unsigned char* indices, size_t rowStride) const;
+        // firstNibble is 1 to start on the low half of the first byte
+        void unpackNibbles(unsigned char const* scanline, unsigned int firstNibble, unsigned int width, unsigned char* indices) const;
+        void storeIndexedRow(unsigned char const* indices, unsigned int storageRow, Colour const* palette, unsigned char const* paletteLumas, ImageCanvas& canvas) const;
+
+        void unpackScanlineToLuma(unsigned char const* scanline, int width, unsigned char* luma) const;
 
         enum class FileMode
         {
@@ -43,8 +113,6 @@ namespace Bitmap
         FILE* openFileStream(char const* const filename, FileMode fileMode);
         void closeFileStream(FILE& file);
 
-        int calculateNumberOfScanlinePaddingBytes(int totalImageWidth) const;
-
         int calculateTotalFileSize(int totalImageWidth, int totalImageHeight) const;
 
         int calculateOffsetIntoFileForStartOfPixelData();
@@ -53,6 +121,7 @@ namespace Bitmap
         FileHandlingErrors readValue(FILE& file, TYPE& value)
         {
             size_t elementsRead = fread(&value, sizeof(TYPE), 1, &file);
+            Instrumentation::StageTimer::recordIo(elementsRead * sizeof(TYPE));
 
             int error = ferror(&file);
 
@@ -70,16 +139,85 @@ namespace Bitmap
             return toReturn;
         }
 
+        struct MemoryReader
+        {
+            unsigned char const* data;
+            size_t size;
+            size_t position;
+        };
+
+        template<typename TYPE>
+        FileHandlingErrors readValue(MemoryReader& reader, TYPE& value)
+        {
+            FileHandlingErrors toReturn = FileHandlingErrors::UnexpectedEndOfFile;
+
+            if (reader.size - reader.position >= sizeof(TYPE))
+            {
+                memcpy(&value, reader.data + reader.position, sizeof(TYPE));
+                reader.position += sizeof(TYPE);
+
+                toReturn = FileHandlingErrors::OK;
+            }
+
+            return toReturn;
+        }
+
         template<typename TYPE>
-        FileHandlingErrors writeValue(FILE& file, TYPE const& value)
+        FileHandlingErrors readValues(MemoryReader& reader, TYPE* values, size_t count)
         {
-            size_t elementswritted = fwrite(&value, sizeof(TYPE), 1, &file);
+            FileHandlingErrors toReturn = FileHandlingErrors::UnexpectedEndOfFile;
+
+            if ((reader.size - reader.position) / sizeof(TYPE) >= count)
+            {
+                memcpy(values, reader.data + reader.position, count * sizeof(TYPE));
+                reader.position += count * sizeof(TYPE);
+
+                toReturn = FileHandlingErrors::OK;
+            }
+
+            return toReturn;
+        }
+
+        FileHandlingErrors seekTo(FILE& file, size_t offset);
+        FileHandlingErrors seekTo(MemoryReader& reader, size_t offset);
+
+        // bytes between the current position and the end
+        size_t getRemainingSize(FILE& file);
+        size_t getRemainingSize(MemoryReader& reader);
+
+        template<typename TYPE>
+        FileHandlingErrors readValues(FILE& file, TYPE* values, size_t count)
+        {
+            // bulk version of readValue - a short read is reported the same way as a single missing value
+            size_t elementsRead = fread(values, sizeof(TYPE), count, &file);
+            Instrumentation::StageTimer::recordIo(elementsRead * sizeof(TYPE));
 
             int error = ferror(&file);
 
             FileHandlingErrors toReturn = FileHandlingErrors::OK;
 
-            if (error != 0 || elementswritted != 1)
+            if (error == 0)
+            {
+                toReturn = (elementsRead == count) ? FileHandlingErrors::OK : FileHandlingErrors::UnexpectedEndOfFile;
+            }
+            else
+            {
+                toReturn = FileHandlingErrors::UnknownReadError;
+            }
+
+            return toReturn;
+        }
+
+        template<typename TYPE>
+        FileHandlingErrors writeValues(FILE& file, TYPE const* values, size_t count)
+        {
+            size_t elementsWritten = fwrite(values, sizeof(TYPE), count, &file);
+
+            int error = ferror(&file);
+
+            FileHandlingErrors toReturn = FileHandlingErrors::OK;
+
+            if (error != 0 || elementsWritten != count)
             {
                 toReturn = FileHandlingErrors::UnknownWriteError;
             }
@@ -87,13 +225,31 @@ namespace Bitmap
             return toReturn;
         }
 
+        // appends the value to a header being assembled in memory and moves past it
+        template<typename TYPE>
+        void packValue(unsigned char*& destination, TYPE const& value)
+        {
+            memcpy(destination, &value, sizeof(TYPE));
+            destination += sizeof(TYPE);
+        }
+
     private:
         static int const c_fileTypeSize;
         static unsigned int const c_imageInfoSize;
+        static unsigned int const c_imageInfoV2Size;
+        static unsigned int const c_imageInfoV3Size;
+        static unsigned int const c_imageInfoV4Size;
+        static unsigned int const c_imageInfoV5Size;
+        static int const c_headersSize;
         static char const c_bitmapFormatSpecifier[];
         static unsigned short c_numberOfPlanes;
         static unsigned short const c_bitsPerPixel;
         static unsigned int const c_compressionLevel;
+        static unsigned int const c_compressionRle8;
+        static unsigned int const c_compressionRle4;
+        static unsigned int const c_compressionBitfields;
+        static unsigned int const c_compressionAlphaBitfields;
+        static unsigned long long const c_largestSparseRunLengthImage;
     };
 }
 
@@ -0,0 +1,92 @@
+#ifndef IMAGEREGION_H
+#define IMAGEREGION_H
+
+#include <stddef.h>
+
+namespace Bitmap
+{
+    // a rectangle of an image, measured from its top left corner whichever way up the file stores it. A width or height
+    // of 0 means the whole image, which is what the default is
+    struct ImageRegion
+    {
+        ImageRegion()
+            : x(0)
+            , y(0)
+            , width(0)
+            , height(0)
+        {
+        }
+
+        ImageRegion(unsigned int x, unsigned int y, unsigned int width, unsigned int height)
+            : x(x)
+            , y(y)
+            , width(width)
+            , height(height)
+        {
+        }
+
+        unsigned int x;
+        unsigned int y;
+        unsigned int width;
+        unsigned int height;
+
+        inline bool isWholeImage() const { return width == 0 || height == 0; }
+
+        // the part of the region inside an image this size, spelled out in full even for the whole image. Empty if the
+        // region is entirely off the edge
+        inline ImageRegion clippedTo(unsigned int imageWidth, unsigned int imageHeight) const
+        {
+            if (isWholeImage())
+            {
+                return ImageRegion(0, 0, imageWidth, imageHeight);
+            }
+
+            unsigned int const clippedX = x < imageWidth ? x : imageWidth;
+            unsigned int const clippedY = y < imageHeight ? y : imageHeight;
+            unsigned int const clippedWidth = width < imageWidth - clippedX ? width : imageWidth - clippedX;
+            unsigned int const clippedHeight = height < imageHeight - clippedY ? height : imageHeight - clippedY;
+
+            // nothing left in one direction leaves nothing in the other either
+            if (clippedWidth == 0 || clippedHeight == 0)
+            {
+                return ImageRegion(clippedX, clippedY, 0, 0);
+            }
+
+            return ImageRegion(clippedX, clippedY, clippedWidth, clippedHeight);
+        }
+    };
+
+    // where a region's pixels are in an uncompressed pixel array, from ImageFile::calculateRegionLayout. Rows are read in
+    // file order, straight through when the region is the full width of the image and with a seek to each one when it
+    // isn't, so only the columns that are needed come off disk
+    struct RegionLayout
+    {
+        RegionLayout()
+            : firstRowOffset(0)
+            , rowStride(0)
+            , rowLength(0)
+            , firstNibble(0)
+            , seekEachRow(false)
+        {
+        }
+
+        // clipped to the image
+        ImageRegion region;
+
+        // from the start of the file to the region's first byte, in whichever of its rows comes first in the file
+        size_t firstRowOffset;
+
+        // a whole scanline of the image, padding included
+        size_t rowStride;
+
+        // bytes read from each row
+        size_t rowLength;
+
+        // 4 bit pixels share bytes, this is 1 when the region starts on the low half of its first one
+        unsigned int firstNibble;
+
+        bool seekEachRow;
+    };
+}
+
+#endif // IMAGEREGION_H
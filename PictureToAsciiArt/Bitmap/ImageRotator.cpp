@@ -0,0 +1,66 @@
+#include "ImageRotator.h"
+
+#include "Colour.h"
+#include "ImageCanvas.h"
+
+namespace Bitmap
+{
+    // 32 rows of 32 pixels is 3KB a tile, read and written that's well inside L1 and each row of it is a couple of lines
+    unsigned int const ImageRotator::c_tileSize = 32;
+
+    ImageView ImageRotator::rotate(ImageView const& source, Rotation rotation, ImageCanvas& destination)
+    {
+        switch (rotation)
+        {
+        case Rotation::Clockwise:
+            // the bottom row of the source becomes the left hand column
+            transpose(source.flippedVertically(), destination);
+            return destination.getTopDownView();
+
+        case Rotation::Anticlockwise:
+            // the right hand column of the source becomes the top row
+            transpose(source, destination);
+            return destination.getTopDownView().flippedVertically();
+
+        case Rotation::None:
+        default:
+            return source;
+        }
+    }
+
+    void ImageRotator::transpose(ImageView const& source, ImageCanvas& destination)
+    {
+        unsigned int const width = source.getWidth();
+        unsigned int const height = source.getHeight();
+
+        destination.resize(height, width, ImageCanvas::StorageMode::Interleaved);
+
+        if (width == 0 || height == 0)
+        {
+            return;
+        }
+
+        Colour* const pixels = destination.getRawColourData();
+
+        for (unsigned int tileY = 0; tileY < height; tileY += c_tileSize)
+        {
+            unsigned int const tileBottom = tileY + c_tileSize < height ? tileY + c_tileSize : height;
+
+            for (unsigned int tileX = 0; tileX < width; tileX += c_tileSize)
+            {
+                unsigned int const tileRight = tileX + c_tileSize < width ? tileX + c_tileSize : width;
+
+                for (unsigned int x = tileX; x < tileRight; ++x)
+                {
+                    // destination rows are stored bottom up like any canvas, row x from the top is width - 1 - x in storage
+                    Colour* const destinationRow = pixels + static_cast<size_t>(width - 1 - x) * height;
+
+                    for (unsigned int y = tileY; y < tileBottom; ++y)
+                    {
+                        destinationRow[y] = source.getRow(y)[x];
+                    }
+                }
+            }
+        }
+    }
+}
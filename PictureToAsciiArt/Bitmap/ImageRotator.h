@@ -0,0 +1,41 @@
+#ifndef IMAGEROTATOR_H
+#define IMAGEROTATOR_H
+
+#include "ImageView.h"
+
+// forward declarations
+namespace Bitmap
+{
+    class ImageCanvas;
+}
+
+namespace Bitmap
+{
+    // quarter turns of an image. Unlike a flip or a crop a rotation can't be expressed as a view, the rows of the result
+    // are columns of the source, so the pixels are copied through a transpose. Both turns are the same transpose with a
+    // flip, on the way in for clockwise and on the way out for anticlockwise, and the flips are free
+    class ImageRotator
+    {
+    public:
+        enum class Rotation
+        {
+            None
+            , Clockwise         // 90 degrees
+            , Anticlockwise     // 270 degrees
+        };
+
+        // returns a top to bottom view of the rotated image. The pixels live in destination, which is resized and made
+        // Interleaved. With no rotation the source comes straight back and destination isn't touched
+        static ImageView rotate(ImageView const& source, Rotation rotation, ImageCanvas& destination);
+
+        // destination row x is source column x. Done a tile at a time, the naive loop writes one row of the destination
+        // while reading one pixel from each row of the source, and on anything wide every one of those reads is a cache
+        // miss. Within a tile the source rows being read and the destination rows being written all stay in L1
+        static void transpose(ImageView const& source, ImageCanvas& destination);
+
+    private:
+        static unsigned int const c_tileSize;
+    };
+}
+
+#endif // IMAGEROTATOR_H
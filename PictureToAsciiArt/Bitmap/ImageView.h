@@ -0,0 +1,80 @@
+#ifndef IMAGEVIEW_H
+#define IMAGEVIEW_H
+
+#include <stddef.h>
+
+#include "Colour.h"
+
+namespace Bitmap
+{
+    // non-owning view over 24-bit pixel data that lives somewhere else (a canvas, a memory mapped file, ...)
+    // rows are rowStride bytes apart, which lets the view skip scanline padding and walk rows in either direction
+    class ImageView
+    {
+    public:
+        ImageView()
+            : m_origin(nullptr)
+            , m_width(0)
+            , m_height(0)
+            , m_rowStride(0)
+        {
+        }
+
+        ImageView(unsigned char const* origin, unsigned int width, unsigned int height, ptrdiff_t rowStride)
+            : m_origin(origin)
+            , m_width(width)
+            , m_height(height)
+            , m_rowStride(rowStride)
+        {
+        }
+
+        inline unsigned int getWidth() const { return m_width; }
+        inline unsigned int getHeight() const { return m_height; }
+        inline ptrdiff_t getRowStride() const { return m_rowStride; }
+
+        // y == 0 is the first row of the view, whichever way round the underlying storage is
+        inline Colour const* getRow(unsigned int y) const
+        {
+            return reinterpret_cast<Colour const*>(m_origin + static_cast<ptrdiff_t>(y) * m_rowStride);
+        }
+
+        inline Colour const& getPixel(unsigned int x, unsigned int y) const { return getRow(y)[x]; }
+
+        // the same pixels upside down, nothing is copied
+        inline ImageView flippedVertically() const
+        {
+            if (m_height == 0)
+            {
+                return *this;
+            }
+
+            return ImageView(m_origin + static_cast<ptrdiff_t>(m_height - 1) * m_rowStride, m_width, m_height, -m_rowStride);
+        }
+
+        // a rectangle of this view, clipped to fit inside it. The rows keep their stride, so nothing is copied here either
+        inline ImageView cropped(unsigned int x, unsigned int y, unsigned int width, unsigned int height) const
+        {
+            x = x < m_width ? x : m_width;
+            y = y < m_height ? y : m_height;
+            width = width < m_width - x ? width : m_width - x;
+            height = height < m_height - y ? height : m_height - y;
+
+            if (width == 0 || height == 0)
+            {
+                return ImageView();
+            }
+
+            return ImageView(m_origin + static_cast<ptrdiff_t>(y) * m_rowStride + static_cast<ptrdiff_t>(x) * sizeof(Colour), width, height, m_rowStride);
+        }
+
+    private:
+        unsigned char const* m_origin;
+
+        unsigned int m_width;
+        unsigned int m_height;
+
+        ptrdiff_t m_rowStride;
+    };
+}
+
+#endif // IMAGEVIEW_H
@@ -0,0 +1,110 @@
+#include "LoadedImage.h"
+
+#include "CanvasPool.h"
+#include "ImageFile.h"
+
+#include <utility>
+
+namespace Bitmap
+{
+    LoadedImage::LoadedImage()
+        : m_canvasPool(nullptr)
+        , m_canvas(0, 0)
+    {
+    }
+
+    LoadedImage::LoadedImage(CanvasPool& canvasPool)
+        : m_canvasPool(&canvasPool)
+        , m_canvas(canvasPool.acquire())
+    {
+    }
+
+    LoadedImage::~LoadedImage()
+    {
+        close();
+
+        if (m_canvasPool)
+        {
+            m_canvasPool->release(std::move(m_canvas));
+        }
+    }
+
+    FileHandlingErrors LoadedImage::open(char const* const filename, Method method)
+    {
+        return open(filename, method, ImageRegion());
+    }
+
+    FileHandlingErrors LoadedImage::open(char const* const filename, Method method, ImageRegion const& region)
+    {
+        close();
+
+        FileHandlingErrors toReturn = FileHandlingErrors::OK;
+
+        if (method == Method::MapFile)
+        {
+            toReturn = m_mappedFile.open(filename, region);
+
+            if (toReturn == FileHandlingErrors::OK)
+            {
+                ImageView const& wholeImage = m_mappedFile.getView();
+                ImageRegion const clipped = region.clippedTo(wholeImage.getWidth(), wholeImage.getHeight());
+
+                m_view = wholeImage.cropped(clipped.x, clipped.y, clipped.width, clipped.height);
+            }
+        }
+
+        if (method == Method::LoadIntoCanvas || cannotBeMapped(toReturn))
+        {
+            // the view needs colours, whatever the canvas was last used for
+            m_canvas.resize(0, 0, ImageCanvas::StorageMode::Interleaved);
+
+            ImageFile imageFile;
+            toReturn = imageFile.load(filename, region, m_canvas);
+
+            if (toReturn == FileHandlingErrors::OK) { m_view = m_canvas.getTopDownView(); }
+        }
+
+        return toReturn;
+    }
+
+    FileHandlingErrors LoadedImage::openMemory(unsigned char const* data, size_t size, Method method)
+    {
+        close();
+
+        FileHandlingErrors toReturn = FileHandlingErrors::OK;
+
+        if (method == Method::MapFile)
+        {
+            toReturn = m_mappedFile.openMemory(data, size);
+
+            if (toReturn == FileHandlingErrors::OK) { m_view = m_mappedFile.getView(); }
+        }
+
+        if (method == Method::LoadIntoCanvas || cannotBeMapped(toReturn))
+        {
+            m_canvas.resize(0, 0, ImageCanvas::StorageMode::Interleaved);
+
+            // the bitmap came off the wire, so its width and height are checked against what was actually sent before
+            // the canvas is sized from them
+            ImageFile imageFile;
+            toReturn = imageFile.checkPixelDataSize(data, size);
+
+            if (toReturn == FileHandlingErrors::OK) { toReturn = imageFile.load(data, size, m_canvas); }
+
+            if (toReturn == FileHandlingErrors::OK) { m_view = m_canvas.getTopDownView(); }
+        }
+
+        return toReturn;
+    }
+
+    bool LoadedImage::cannotBeMapped(FileHandlingErrors error)
+    {
+        return error == FileHandlingErrors::PalettisedBitmapNotSupported || error == FileHandlingErrors::Not24BitColourBitmap;
+    }
+
+    void LoadedImage::close()
+    {
+        m_mappedFile.close();
+        m_view = ImageView();
+    }
+}
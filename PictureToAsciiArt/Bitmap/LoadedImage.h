@@ -0,0 +1,65 @@
+#ifndef LOADEDIMAGE_H
+#define LOADEDIMAGE_H
+
+#include "FileHandlingErrors.h"
+#include "ImageCanvas.h"
+#include "ImageRegion.h"
+#include "ImageView.h"
+#include "MappedImageFile.h"
+
+// forward declarations
+namespace Bitmap
+{
+    class CanvasPool;
+}
+
+namespace Bitmap
+{
+    // a bitmap opened either by loading it into a canvas or by mapping it, handed out the same way as a top down view
+    class LoadedImage
+    {
+    public:
+        enum class Method
+        {
+            LoadIntoCanvas  // ImageFile::load into an ImageCanvas
+            , MapFile       // MappedImageFile, read in place
+        };
+
+        LoadedImage();
+
+        // loads into a canvas borrowed from the pool, which goes back when the image is destroyed
+        explicit LoadedImage(CanvasPool& canvasPool);
+        ~LoadedImage();
+
+        LoadedImage(LoadedImage const&) = delete;
+        LoadedImage& operator=(LoadedImage const&) = delete;
+
+        // only 24-bit bitmaps can be mapped, anything else is always loaded into the canvas
+        FileHandlingErrors open(char const* const filename, Method method);
+
+        // just the region, clipped to the image. Loading only reads the rows and columns it covers, and a mapping only
+        // reads ahead the pages under it and is viewed through it, so the pages outside it are never touched
+        FileHandlingErrors open(char const* const filename, Method method, ImageRegion const& region);
+
+        // the same for a whole bitmap file already in memory, which has to outlive the image when it's viewed in place
+        FileHandlingErrors openMemory(unsigned char const* data, size_t size, Method method);
+        void close();
+
+        // only valid while the image stays open
+        inline ImageView const& getView() const { return m_view; }
+
+    private:
+        // the mapping turned down a format that loading can still decode
+        static bool cannotBeMapped(FileHandlingErrors error);
+
+    private:
+        CanvasPool* m_canvasPool;
+
+        ImageCanvas m_canvas;
+        MappedImageFile m_mappedFile;
+
+        ImageView m_view;
+    };
+}
+
+#endif // LOADEDIMAGE_H
@@ -0,0 +1,272 @@
+#include "MappedImageFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <io.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "ImageFile.h"
+#include "PortableStdio.h"
+#include "../Instrumentation/StageMetrics.h"
+
+namespace Bitmap
+{
+    MappedImageFile::MappedImageFile()
+        : m_mappedData(nullptr)
+        , m_mappedSize(0)
+        , m_ownsMapping(false)
+    {
+    }
+
+    MappedImageFile::~MappedImageFile()
+    {
+        close();
+    }
+
+    FileHandlingErrors MappedImageFile::open(char const* const filename)
+    {
+        return open(filename, ImageRegion());
+    }
+
+    FileHandlingErrors MappedImageFile::open(char const* const filename, ImageRegion const& region)
+    {
+        close();
+
+        FILE* file = nullptr;
+        errno_t errNum = fopen_s(&file, filename, "rb");
+
+        if (errNum != 0 || file == nullptr)
+        {
+            return FileHandlingErrors::UnableToOpenFile;
+        }
+
+        //////////////////////////////////////////////////////////////////////////
+        // Headers - parsed with the same rules as ImageFile::load
+        //////////////////////////////////////////////////////////////////////////
+
+        ImageFile imageFile;
+        FileHandlingErrors toReturn = imageFile.loadHeaders(*file, m_typeHeader, m_infoHeader);
+
+        //////////////////////////////////////////////////////////////////////////
+        // Pixel data
+        //////////////////////////////////////////////////////////////////////////
+
+        if (toReturn == FileHandlingErrors::OK)
+        {
+            // only the mapping itself, pages are faulted in later on as the rows are converted
+            Instrumentation::StageTimer timer(Instrumentation::Stage::PixelRead);
+
+            toReturn = mapFile(*file);
+            m_ownsMapping = toReturn == FileHandlingErrors::OK;
+
+            timer.addIo(m_mappedSize);
+            timer.addPixels(static_cast<unsigned long long>(m_infoHeader.imageWidth) * m_infoHeader.imageHeight);
+        }
+
+        // the mapping keeps its own reference to the file
+        fclose(file);
+
+        if (toReturn == FileHandlingErrors::OK) { toReturn = createView(); }
+
+        if (toReturn == FileHandlingErrors::OK)
+        {
+            adviseRegion(region);
+        }
+        else
+        {
+            close();
+        }
+
+        return toReturn;
+    }
+
+    FileHandlingErrors MappedImageFile::openMemory(unsigned char const* data, size_t size)
+    {
+        close();
+
+        m_mappedData = data;
+        m_mappedSize = size;
+
+        ImageFile imageFile;
+        FileHandlingErrors toReturn = imageFile.loadHeaders(m_mappedData, m_mappedSize, m_typeHeader, m_infoHeader);
+
+        if (toReturn == FileHandlingErrors::OK) { toReturn = createView(); }
+
+        if (toReturn != FileHandlingErrors::OK)
+        {
+            close();
+        }
+
+        return toReturn;
+    }
+
+    void MappedImageFile::close()
+    {
+        if (m_ownsMapping)
+        {
+            unmapFile();
+        }
+
+        m_mappedData = nullptr;
+        m_mappedSize = 0;
+        m_ownsMapping = false;
+
+        m_typeHeader = FileTypeHeader();
+        m_infoHeader = FileInfoHeader();
+        m_view = ImageView();
+    }
+
+    FileHandlingErrors MappedImageFile::createView()
+    {
+        FileHandlingErrors toReturn = FileHandlingErrors::OK;
+
+        unsigned int const width = m_infoHeader.imageWidth;
+        unsigned int const height = m_infoHeader.imageHeight;
+
+        // zero byte padding up to nearest 4 byte boundary
+        ImageFile imageFile;
+        size_t const rowStride = static_cast<size_t>(width) * 3 + imageFile.calculateNumberOfScanlinePaddingBytes(width);
+
+        // divided rather than multiplied out, made up dimensions can't overflow their way past the check
+        if (m_infoHeader.isPalettised())
+        {
+            toReturn = FileHandlingErrors::PalettisedBitmapNotSupported;
+        }
+        else if (m_infoHeader.isMasked())
+        {
+            toReturn = FileHandlingErrors::Not24BitColourBitmap;
+        }
+        else if (m_typeHeader.offsetToBitmapData > m_mappedSize || (height > 0 && (m_mappedSize - m_typeHeader.offsetToBitmapData) / height < rowStride))
+        {
+            toReturn = FileHandlingErrors::UnexpectedEndOfFile;
+        }
+        else
+        {
+            ImageView const fileOrder(m_mappedData + m_typeHeader.offsetToBitmapData, width, height, static_cast<ptrdiff_t>(rowStride));
+
+            // rows are stored bottom to top unless the bitmap is top down, either way the view starts at the top
+            m_view = m_infoHeader.topDown ? fileOrder : fileOrder.flippedVertically();
+        }
+
+        return toReturn;
+    }
+
+#ifdef _WIN32
+
+    FileHandlingErrors MappedImageFile::mapFile(FILE& file)
+    {
+        FileHandlingErrors toReturn = FileHandlingErrors::FileMappingFailed;
+
+        HANDLE fileHandle = reinterpret_cast<HANDLE>(_get_osfhandle(_fileno(&file)));
+
+        LARGE_INTEGER fileSize;
+
+        if (fileHandle != INVALID_HANDLE_VALUE && GetFileSizeEx(fileHandle, &fileSize) && fileSize.QuadPart > 0)
+        {
+            HANDLE mappingHandle = CreateFileMappingW(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+            if (mappingHandle)
+            {
+                void* view = MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+
+                // the view keeps the mapping object alive
+                CloseHandle(mappingHandle);
+
+                if (view)
+                {
+                    m_mappedData = static_cast<unsigned char const*>(view);
+                    m_mappedSize = static_cast<size_t>(fileSize.QuadPart);
+                    toReturn = FileHandlingErrors::OK;
+                }
+            }
+        }
+
+        return toReturn;
+    }
+
+    void MappedImageFile::adviseRegion(ImageRegion const&)
+    {
+        // pages are only faulted in as the view touches them, there's no read ahead over the whole file to scope down
+    }
+
+    void MappedImageFile::unmapFile()
+    {
+        if (m_mappedData)
+        {
+            UnmapViewOfFile(m_mappedData);
+            m_mappedData = nullptr;
+            m_mappedSize = 0;
+        }
+    }
+
+#else
+
+    FileHandlingErrors MappedImageFile::mapFile(FILE& file)
+    {
+        FileHandlingErrors toReturn = FileHandlingErrors::FileMappingFailed;
+
+        int const fileDescriptor = fileno(&file);
+
+        struct stat fileStatus;
+
+        if (fstat(fileDescriptor, &fileStatus) == 0 && fileStatus.st_size > 0)
+        {
+            size_t const fileSize = static_cast<size_t>(fileStatus.st_size);
+
+            void* view = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+
+            if (view != MAP_FAILED)
+            {
+                m_mappedData = static_cast<unsigned char const*>(view);
+                m_mappedSize = fileSize;
+                toReturn = FileHandlingErrors::OK;
+            }
+        }
+
+        return toReturn;
+    }
+
+    void MappedImageFile::adviseRegion(ImageRegion const& region)
+    {
+        ImageFile imageFile;
+        RegionLayout const layout = imageFile.calculateRegionLayout(m_typeHeader, m_infoHeader, region);
+
+        // faults anywhere else only bring in the page they hit, not the ones around it
+        madvise(const_cast<unsigned char*>(m_mappedData), m_mappedSize, MADV_RANDOM);
+
+        // a full width region is one run of bytes, a narrower one is a run in each of its rows
+        size_t const runCount = layout.seekEachRow ? layout.region.height : (layout.region.height > 0 ? 1 : 0);
+        size_t const runLength = layout.seekEachRow ? layout.rowLength : layout.region.height * layout.rowStride;
+
+        // madvise only takes whole pages
+        size_t const pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+
+        for (size_t run = 0; run < runCount; ++run)
+        {
+            size_t const runStart = layout.firstRowOffset + run * layout.rowStride;
+            size_t const runEnd = runStart + runLength < m_mappedSize ? runStart + runLength : m_mappedSize;
+            size_t const pageStart = runStart - runStart % pageSize;
+
+            madvise(const_cast<unsigned char*>(m_mappedData) + pageStart, runEnd - pageStart, MADV_WILLNEED);
+        }
+    }
+
+    void MappedImageFile::unmapFile()
+    {
+        if (m_mappedData)
+        {
+            munmap(const_cast<unsigned char*>(m_mappedData), m_mappedSize);
+            m_mappedData = nullptr;
+            m_mappedSize = 0;
+        }
+    }
+
+#endif
+
+}
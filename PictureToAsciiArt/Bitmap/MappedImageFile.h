@@ -0,0 +1,74 @@
+#ifndef MAPPEDIMAGEFILE_H
+#define MAPPEDIMAGEFILE_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include "FileHandlingErrors.h"
+#include "FileInfoHeader.h"
+#include "FileTypeHeader.h"
+#include "ImageRegion.h"
+#include "ImageView.h"
+
+namespace Bitmap
+{
+    // read-only alternative to ImageFile::load + ImageCanvas. The whole file is memory mapped and the pixel
+    // array is exposed in place through an ImageView, so no pixel data is ever copied or allocated
+    class MappedImageFile
+    {
+    public:
+        MappedImageFile();
+        ~MappedImageFile();
+
+        MappedImageFile(MappedImageFile const&) = delete;
+        MappedImageFile& operator=(MappedImageFile const&) = delete;
+
+        // only 24-bit pixels can be viewed in place. Palettised bitmaps come back as PalettisedBitmapNotSupported, 32 and
+        // 16 bit ones as Not24BitColourBitmap
+        FileHandlingErrors open(char const* const filename);
+
+        // the view is still of the whole image, but only the pages holding the region are read ahead. Nothing stops the
+        // rest being faulted in, it just won't be unless something outside the region is looked at
+        FileHandlingErrors open(char const* const filename, ImageRegion const& region);
+
+        // views a whole bitmap file that's already in memory instead, which has to outlive the view. Nothing is copied
+        FileHandlingErrors openMemory(unsigned char const* data, size_t size);
+
+        void close();
+
+        inline bool isOpen() const { return m_mappedData != nullptr; }
+
+        inline FileTypeHeader const& getTypeHeader() const { return m_typeHeader; }
+        inline FileInfoHeader const& getInfoHeader() const { return m_infoHeader; }
+
+        inline unsigned char const* getMappedData() const { return m_mappedData; }
+        inline size_t getMappedSize() const { return m_mappedSize; }
+
+        // top to bottom view of the pixel array - the same orientation as ImageCanvas::getTopDownView
+        inline ImageView const& getView() const { return m_view; }
+
+    private:
+        FileHandlingErrors mapFile(FILE& file);
+        void unmapFile();
+
+        // asks for the rows of the region to be read in ahead of the view and everything else to be left alone
+        void adviseRegion(ImageRegion const& region);
+
+        // points the view at the pixel array the headers describe, once it's checked the data is big enough to hold it
+        FileHandlingErrors createView();
+
+    private:
+        unsigned char const* m_mappedData;
+        size_t m_mappedSize;
+
+        // false when the data belongs to whoever called openMemory
+        bool m_ownsMapping;
+
+        FileTypeHeader m_typeHeader;
+        FileInfoHeader m_infoHeader;
+
+        ImageView m_view;
+    };
+}
+
+#endif // MAPPEDIMAGEFILE_H
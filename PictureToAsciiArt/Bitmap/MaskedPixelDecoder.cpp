@@ -0,0 +1,161 @@
+#include "MaskedPixelDecoder.h"
+
+#include "FileInfoHeader.h"
+#include "../Ascii/CpuFeatures.h"
+
+#if ASCII_X86_KERNELS
+#include <tmmintrin.h>
+#endif
+
+namespace Bitmap
+{
+    MaskedPixelDecoder::MaskedPixelDecoder(FileInfoHeader const& infoHeader)
+        : m_bytesPerPixel(infoHeader.bitsPerPixel / 8)
+        , m_byteAligned(false)
+        , m_blueByte(0)
+        , m_greenByte(0)
+        , m_redByte(0)
+        , m_useSsse3(false)
+    {
+        describeChannel(infoHeader.blueMask, m_blue);
+        describeChannel(infoHeader.greenMask, m_green);
+        describeChannel(infoHeader.redMask, m_red);
+
+        auto isWholeByte = [](unsigned int mask)
+        {
+            return mask == 0x000000FFu || mask == 0x0000FF00u || mask == 0x00FF0000u || mask == 0xFF000000u;
+        };
+
+        m_byteAligned = m_bytesPerPixel == 4 && isWholeByte(infoHeader.blueMask) && isWholeByte(infoHeader.greenMask) && isWholeByte(infoHeader.redMask);
+
+        if (m_byteAligned)
+        {
+            // pixels are little endian, so a mask's shift in bits is its byte offset times 8
+            m_blueByte = m_blue.shift / 8;
+            m_greenByte = m_green.shift / 8;
+            m_redByte = m_red.shift / 8;
+
+#if ASCII_X86_KERNELS
+            m_useSsse3 = Ascii::CpuFeatures::hasSsse3();
+#endif
+        }
+    }
+
+    void MaskedPixelDecoder::describeChannel(unsigned int mask, Channel& channel)
+    {
+        // the mask has been checked to be a single run of bits
+        unsigned int shift = 0;
+        unsigned int bits = 0;
+
+        while (shift < 32 && ((mask >> shift) & 1) == 0)
+        {
+            ++shift;
+        }
+
+        while (shift + bits < 32 && ((mask >> (shift + bits)) & 1) != 0)
+        {
+            ++bits;
+        }
+
+        if (bits > 8)
+        {
+            shift += bits - 8;
+            bits = 8;
+        }
+
+        channel.mask = mask;
+        channel.shift = shift;
+
+        unsigned int const maximum = bits > 0 ? (1u << bits) - 1 : 0;
+
+        for (unsigned int value = 0; value < 256; ++value)
+        {
+            channel.scale[value] = static_cast<unsigned char>(maximum == 0 ? 0 : value >= maximum ? 255 : (value * 255 + maximum / 2) / maximum);
+        }
+    }
+
+    void MaskedPixelDecoder::decodeRow(unsigned char const* pixels, unsigned int width, unsigned char* bgr) const
+    {
+        unsigned int x = 0;
+
+        if (m_byteAligned)
+        {
+            if (m_useSsse3)
+            {
+                x = decodeBytesSsse3(pixels, width, bgr);
+            }
+
+            for (; x < width; ++x)
+            {
+                unsigned char const* pixel = pixels + x * 4;
+
+                bgr[x * 3] = pixel[m_blueByte];
+                bgr[x * 3 + 1] = pixel[m_greenByte];
+                bgr[x * 3 + 2] = pixel[m_redByte];
+            }
+
+            return;
+        }
+
+        for (; x < width; ++x)
+        {
+            unsigned char const* bytes = pixels + x * m_bytesPerPixel;
+
+            // little endian whatever the machine is
+            unsigned int pixel = bytes[0] | (static_cast<unsigned int>(bytes[1]) << 8);
+
+            if (m_bytesPerPixel == 4)
+            {
+                pixel |= (static_cast<unsigned int>(bytes[2]) << 16) | (static_cast<unsigned int>(bytes[3]) << 24);
+            }
+
+            bgr[x * 3] = extract(m_blue, pixel);
+            bgr[x * 3 + 1] = extract(m_green, pixel);
+            bgr[x * 3 + 2] = extract(m_red, pixel);
+        }
+    }
+
+#if ASCII_X86_KERNELS
+
+    ASCII_TARGET_SSSE3 unsigned int MaskedPixelDecoder::decodeBytesSsse3(unsigned char const* pixels, unsigned int width, unsigned char* bgr) const
+    {
+        // picks the three channel bytes out of each of 4 pixels and packs them into the low 12 bytes
+        char shuffleBytes[16];
+
+        for (int i = 0; i < 4; ++i)
+        {
+            shuffleBytes[i * 3] = static_cast<char>(i * 4 + m_blueByte);
+            shuffleBytes[i * 3 + 1] = static_cast<char>(i * 4 + m_greenByte);
+            shuffleBytes[i * 3 + 2] = static_cast<char>(i * 4 + m_redByte);
+        }
+
+        for (int i = 12; i < 16; ++i)
+        {
+            shuffleBytes[i] = static_cast<char>(0x80);
+        }
+
+        __m128i const shuffle = _mm_loadu_si128(reinterpret_cast<__m128i const*>(shuffleBytes));
+
+        unsigned int x = 0;
+
+        // every store is 16 bytes for 12 that count, the next one writes over the rest. Stopping with at least 6 pixels
+        // to go keeps the last store inside the row
+        for (; x + 6 <= width; x += 4)
+        {
+            __m128i const packed = _mm_loadu_si128(reinterpret_cast<__m128i const*>(pixels + x * 4));
+
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(bgr + x * 3), _mm_shuffle_epi8(packed, shuffle));
+        }
+
+        return x;
+    }
+
+#else
+
+    unsigned int MaskedPixelDecoder::decodeBytesSsse3(unsigned char const*, unsigned int, unsigned char*) const
+    {
+        return 0;
+    }
+
+#endif
+}
@@ -0,0 +1,63 @@
+#ifndef MASKEDPIXELDECODER_H
+#define MASKEDPIXELDECODER_H
+
+// forward declarations
+namespace Bitmap
+{
+    struct FileInfoHeader;
+}
+
+namespace Bitmap
+{
+    // turns rows of 32 or 16 bit pixels into the BGR triples of a 24-bit bitmap, using the channel masks from the info
+    // header. When every channel is a whole byte of a 32 bit pixel, as it is for BGRX and BGRA, a row is just a byte
+    // shuffle, done 4 pixels per instruction with SSSE3. Anything else (565, 10 bit channels) is masked, shifted and
+    // scaled a pixel at a time. Alpha is dropped, pixels are taken as opaque
+    class MaskedPixelDecoder
+    {
+    public:
+        explicit MaskedPixelDecoder(FileInfoHeader const& infoHeader);
+
+        // writes width * 3 bytes
+        void decodeRow(unsigned char const* pixels, unsigned int width, unsigned char* bgr) const;
+
+    private:
+        struct Channel
+        {
+            unsigned int mask;
+
+            // channels wider than 8 bits are shifted down to their top 8 on the way out
+            unsigned int shift;
+
+            // the narrowed value stretched out to 0..255, so a 5 bit 31 is 255 rather than 248
+            unsigned char scale[256];
+        };
+
+        static void describeChannel(unsigned int mask, Channel& channel);
+
+        // returns how many pixels it got through, the rest are left to the scalar loop
+        unsigned int decodeBytesSsse3(unsigned char const* pixels, unsigned int width, unsigned char* bgr) const;
+
+        inline unsigned char extract(Channel const& channel, unsigned int pixel) const
+        {
+            return channel.scale[(pixel & channel.mask) >> channel.shift];
+        }
+
+    private:
+        unsigned int m_bytesPerPixel;
+
+        Channel m_blue;
+        Channel m_green;
+        Channel m_red;
+
+        // every channel is a whole byte at these offsets within the pixel
+        bool m_byteAligned;
+        unsigned int m_blueByte;
+        unsigned int m_greenByte;
+        unsigned int m_redByte;
+
+        bool m_useSsse3;
+    };
+}
+
+#endif // MASKEDPIXELDECODER_H
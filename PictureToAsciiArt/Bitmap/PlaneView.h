@@ -0,0 +1,78 @@
+#ifndef PLANEVIEW_H
+#define PLANEVIEW_H
+
+#include <stddef.h>
+
+namespace Bitmap
+{
+    // non-owning view over a single 8-bit plane of a canvas - luma, or palette indices. Rows are rowStride bytes
+    // apart in the same way as an ImageView, so a view can walk a bottom up plane from the top
+    class PlaneView
+    {
+    public:
+        PlaneView()
+            : m_origin(nullptr)
+            , m_width(0)
+            , m_height(0)
+            , m_rowStride(0)
+        {
+        }
+
+        PlaneView(unsigned char const* origin, unsigned int width, unsigned int height, ptrdiff_t rowStride)
+            : m_origin(origin)
+            , m_width(width)
+            , m_height(height)
+            , m_rowStride(rowStride)
+        {
+        }
+
+        inline unsigned int getWidth() const { return m_width; }
+        inline unsigned int getHeight() const { return m_height; }
+        inline ptrdiff_t getRowStride() const { return m_rowStride; }
+
+        // y == 0 is the first row of the view, whichever way round the underlying storage is
+        inline unsigned char const* getRow(unsigned int y) const
+        {
+            return m_origin + static_cast<ptrdiff_t>(y) * m_rowStride;
+        }
+
+        inline unsigned char getValue(unsigned int x, unsigned int y) const { return getRow(y)[x]; }
+
+        // the same pixels upside down, nothing is copied
+        inline PlaneView flippedVertically() const
+        {
+            if (m_height == 0)
+            {
+                return *this;
+            }
+
+            return PlaneView(m_origin + static_cast<ptrdiff_t>(m_height - 1) * m_rowStride, m_width, m_height, -m_rowStride);
+        }
+
+        // a rectangle of this view, clipped to fit inside it. The rows keep their stride, so nothing is copied here either
+        inline PlaneView cropped(unsigned int x, unsigned int y, unsigned int width, unsigned int height) const
+        {
+            x = x < m_width ? x : m_width;
+            y = y < m_height ? y : m_height;
+            width = width < m_width - x ? width : m_width - x;
+            height = height < m_height - y ? height : m_height - y;
+
+            if (width == 0 || height == 0)
+            {
+                return PlaneView();
+            }
+
+            return PlaneView(m_origin + static_cast<ptrdiff_t>(y) * m_rowStride + static_cast<ptrdiff_t>(x), width, height, m_rowStride);
+        }
+
+    private:
+        unsigned char const* m_origin;
+
+        unsigned int m_width;
+        unsigned int m_height;
+
+        ptrdiff_t m_rowStride;
+    };
+}
+
+#endif // PLANEVIEW_H
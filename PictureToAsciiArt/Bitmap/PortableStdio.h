@@ -0,0 +1,20 @@
+#ifndef PORTABLESTDIO_H
+#define PORTABLESTDIO_H
+
+#include <errno.h>
+#include <stdio.h>
+
+// fopen_s comes with the Microsoft CRT but it's an optional part of C11 that glibc doesn't ship. Anywhere it's missing
+// it's filled in on top of fopen, so the file handling builds unchanged on Linux
+#if !defined(_WIN32) && !defined(__STDC_LIB_EXT1__)
+typedef int errno_t;
+
+inline errno_t fopen_s(FILE** file, char const* filename, char const* mode)
+{
+    *file = fopen(filename, mode);
+
+    return *file ? 0 : errno;
+}
+#endif
+
+#endif // PORTABLESTDIO_H
@@ -0,0 +1,246 @@
+#include "ScanlineReader.h"
+
+#include "ImageCanvas.h"
+#include "ImageFile.h"
+#include "MaskedPixelDecoder.h"
+#include "PortableStdio.h"
+#include "../Instrumentation/StageMetrics.h"
+
+namespace Bitmap
+{
+    // big enough to amortise the seek + read per block, small enough to stay in cache while it is converted
+    size_t const ScanlineReader::c_targetBlockSize = 64 * 1024;
+    unsigned int const ScanlineReader::c_rowAlignment = 16;
+
+    ScanlineReader::ScanlineReader()
+        : m_file(nullptr)
+        , m_rowStride(0)
+        , m_rowsPerBlock(0)
+        , m_nextRow(0)
+    {
+    }
+
+    ScanlineReader::~ScanlineReader()
+    {
+        close();
+    }
+
+    FileHandlingErrors ScanlineReader::open(char const* const filename)
+    {
+        return open(filename, ImageRegion());
+    }
+
+    FileHandlingErrors ScanlineReader::open(char const* const filename, ImageRegion const& region)
+    {
+        close();
+
+        errno_t errNum = fopen_s(&m_file, filename, "rb");
+
+        if (errNum != 0 || m_file == nullptr)
+        {
+            m_file = nullptr;
+            return FileHandlingErrors::UnableToOpenFile;
+        }
+
+        // every read is a whole block straight into m_block, so the stdio buffer would only add a copy
+        setvbuf(m_file, nullptr, _IONBF, 0);
+
+        ImageFile imageFile;
+        FileHandlingErrors toReturn = imageFile.loadHeaders(*m_file, m_typeHeader, m_infoHeader);
+
+        if (toReturn == FileHandlingErrors::OK && m_infoHeader.isPalettised())
+        {
+            if (m_infoHeader.isRunLengthEncoded())
+            {
+                toReturn = FileHandlingErrors::CompressionNotSupported;
+            }
+            else
+            {
+                m_palette.resize(ImageCanvas::c_maximumPaletteSize);
+                toReturn = imageFile.loadPalette(*m_file, m_infoHeader, m_palette.data());
+            }
+        }
+        else if (toReturn == FileHandlingErrors::OK && m_infoHeader.isMasked())
+        {
+            m_maskedDecoder.reset(new MaskedPixelDecoder(m_infoHeader));
+        }
+
+        // the block is sized from the width, so a made up one has to fail before it's allocated
+        if (toReturn == FileHandlingErrors::OK) { toReturn = imageFile.checkPixelDataSize(*m_file, m_typeHeader, m_infoHeader); }
+
+        if (toReturn == FileHandlingErrors::OK)
+        {
+            m_layout = imageFile.calculateRegionLayout(m_typeHeader, m_infoHeader, region);
+
+            unsigned int const width = m_layout.region.width;
+
+            // a whole scanline of the file, padding included
+            m_rowStride = m_layout.rowStride;
+
+            m_rowsPerBlock = m_rowStride > 0 ? static_cast<unsigned int>(c_targetBlockSize / m_rowStride) : 1;
+            m_rowsPerBlock = m_rowsPerBlock >= c_rowAlignment ? m_rowsPerBlock / c_rowAlignment * c_rowAlignment : c_rowAlignment;
+
+            m_block.resize(m_rowStride * m_rowsPerBlock);
+
+            if (m_infoHeader.isPalettised() || m_infoHeader.isMasked())
+            {
+                m_expandedBlock.resize(static_cast<size_t>(width) * m_rowsPerBlock);
+            }
+        }
+        else
+        {
+            close();
+        }
+
+        return toReturn;
+    }
+
+    void ScanlineReader::close()
+    {
+        if (m_file)
+        {
+            fclose(m_file);
+            m_file = nullptr;
+        }
+
+        m_typeHeader = FileTypeHeader();
+        m_infoHeader = FileInfoHeader();
+        m_maskedDecoder.reset();
+
+        m_layout = RegionLayout();
+        m_rowStride = 0;
+        m_rowsPerBlock = 0;
+        m_nextRow = 0;
+    }
+
+    void ScanlineReader::expandRow(unsigned char const* scanline, Colour* colours) const
+    {
+        unsigned int const width = m_layout.region.width;
+
+        if (m_maskedDecoder)
+        {
+            m_maskedDecoder->decodeRow(scanline, width, reinterpret_cast<unsigned char*>(colours));
+        }
+        else if (m_infoHeader.bitsPerPixel == 8)
+        {
+            for (unsigned int i = 0; i < width; ++i)
+            {
+                colours[i] = m_palette[scanline[i]];
+            }
+        }
+        else
+        {
+            // high nibble is the left hand pixel
+            for (unsigned int i = 0; i < width; ++i)
+            {
+                unsigned int const nibble = m_layout.firstNibble + i;
+
+                colours[i] = m_palette[(nibble & 1) ? scanline[nibble / 2] & 0x0F : scanline[nibble / 2] >> 4];
+            }
+        }
+    }
+
+    FileHandlingErrors ScanlineReader::readAt(long long offset, unsigned char* destination, size_t size)
+    {
+        FileHandlingErrors toReturn = FileHandlingErrors::OK;
+
+#ifdef _WIN32
+        int const seekResult = _fseeki64(m_file, offset, SEEK_SET);
+#else
+        int const seekResult = fseeko(m_file, static_cast<off_t>(offset), SEEK_SET);
+#endif
+
+        if (seekResult != 0)
+        {
+            toReturn = FileHandlingErrors::UnexpectedEndOfFile;
+        }
+        else
+        {
+            size_t const bytesRead = fread(destination, 1, size, m_file);
+
+            Instrumentation::StageTimer::recordIo(bytesRead);
+
+            if (ferror(m_file) != 0)
+            {
+                toReturn = FileHandlingErrors::UnknownReadError;
+            }
+            else if (bytesRead != size)
+            {
+                toReturn = FileHandlingErrors::UnexpectedEndOfFile;
+            }
+        }
+
+        return toReturn;
+    }
+
+    FileHandlingErrors ScanlineReader::readNextRows(ImageView& rows)
+    {
+        rows = ImageView();
+
+        if (m_file == nullptr || !hasMoreRows())
+        {
+            return FileHandlingErrors::UnexpectedEndOfFile;
+        }
+
+        unsigned int const width = m_layout.region.width;
+        unsigned int const height = m_layout.region.height;
+        unsigned int const remainingRows = height - m_nextRow;
+        unsigned int const rowCount = remainingRows < m_rowsPerBlock ? remainingRows : m_rowsPerBlock;
+
+        // the block holds rows [firstBlockRow, firstBlockRow + rowCount) of the region in file order, which is bottom to
+        // top unless the bitmap is top down
+        unsigned int const firstBlockRow = m_infoHeader.topDown ? m_nextRow : height - m_nextRow - rowCount;
+
+        // a full width region is read a whole block at a time. A narrower one is a seek and read per row for just its
+        // columns, packed together in the block
+        size_t const blockStride = m_layout.seekEachRow ? m_layout.rowLength : m_rowStride;
+
+        FileHandlingErrors toReturn = FileHandlingErrors::OK;
+
+        Instrumentation::StageTimer timer(Instrumentation::Stage::PixelRead);
+
+        if (m_layout.seekEachRow)
+        {
+            for (unsigned int i = 0; i < rowCount && toReturn == FileHandlingErrors::OK; ++i)
+            {
+                long long const rowOffset = static_cast<long long>(m_layout.firstRowOffset) + static_cast<long long>(firstBlockRow + i) * m_rowStride;
+
+                toReturn = readAt(rowOffset, m_block.data() + i * blockStride, m_layout.rowLength);
+            }
+        }
+        else
+        {
+            long long const blockOffset = static_cast<long long>(m_layout.firstRowOffset) + static_cast<long long>(firstBlockRow) * m_rowStride;
+
+            toReturn = readAt(blockOffset, m_block.data(), m_rowStride * rowCount);
+        }
+
+        if (toReturn == FileHandlingErrors::OK)
+        {
+            unsigned char const* firstRow = m_block.data();
+            size_t rowStride = blockStride;
+
+            if (m_infoHeader.isPalettised() || m_infoHeader.isMasked())
+            {
+                for (unsigned int i = 0; i < rowCount; ++i)
+                {
+                    expandRow(m_block.data() + i * blockStride, m_expandedBlock.data() + static_cast<size_t>(i) * width);
+                }
+
+                firstRow = reinterpret_cast<unsigned char const*>(m_expandedBlock.data());
+                rowStride = static_cast<size_t>(width) * sizeof(Colour);
+            }
+
+            ImageView const fileOrder(firstRow, width, rowCount, static_cast<ptrdiff_t>(rowStride));
+
+            // in a bottom up bitmap the last row of the block is the top most one
+            rows = m_infoHeader.topDown ? fileOrder : fileOrder.flippedVertically();
+
+            m_nextRow += rowCount;
+
+            timer.addPixels(static_cast<unsigned long long>(width) * rowCount);
+        }
+
+        return toReturn;
+    }
+}
@@ -0,0 +1,82 @@
+#ifndef SCANLINEREADER_H
+#define SCANLINEREADER_H
+
+#include <stddef.h>
+#include <stdio.h>
+#include <memory>
+#include <vector>
+
+#include "FileHandlingErrors.h"
+#include "FileInfoHeader.h"
+#include "FileTypeHeader.h"
+#include "ImageRegion.h"
+#include "ImageView.h"
+
+// forward declarations
+namespace Bitmap
+{
+    class MaskedPixelDecoder;
+}
+
+namespace Bitmap
+{
+    // streams the pixel array of a bitmap a few scanlines at a time, top to bottom, without ever holding the whole
+    // image. Bitmaps are usually stored bottom to top, so the file is read backwards in small blocks of rows (forwards
+    // for a top down one) which keeps memory use proportional to the image width no matter how tall it is.
+    // Uncompressed palettised bitmaps are expanded through their palette a block at a time, and 32 and 16 bit ones
+    // through their channel masks. Run length encoded ones can't be read backwards and aren't supported.
+    // a region reads only the rows it covers, and if it's narrower than the image only its columns of each row
+    class ScanlineReader
+    {
+    public:
+        ScanlineReader();
+        ~ScanlineReader();
+
+        ScanlineReader(ScanlineReader const&) = delete;
+        ScanlineReader& operator=(ScanlineReader const&) = delete;
+
+        FileHandlingErrors open(char const* const filename);
+        FileHandlingErrors open(char const* const filename, ImageRegion const& region);
+        void close();
+
+        // the size of what's being read, the region clipped to the image or the whole image when there isn't one
+        inline unsigned int getWidth() const { return m_layout.region.width; }
+        inline unsigned int getHeight() const { return m_layout.region.height; }
+
+        inline bool hasMoreRows() const { return m_nextRow < m_layout.region.height; }
+
+        // fills rows with a top to bottom view of the next block of scanlines. The view is only valid until the next call
+        FileHandlingErrors readNextRows(ImageView& rows);
+
+    private:
+        FileHandlingErrors readAt(long long offset, unsigned char* destination, size_t size);
+        void expandRow(unsigned char const* scanline, Colour* colours) const;
+
+    private:
+        static size_t const c_targetBlockSize;
+
+        // blocks are a whole number of these rows tall, so anything tiled 8 or 16 rows high (the ordered dither pattern,
+        // shape matching's glyph cells) lines up from one block to the next
+        static unsigned int const c_rowAlignment;
+
+        FILE* m_file;
+
+        FileTypeHeader m_typeHeader;
+        FileInfoHeader m_infoHeader;
+
+        RegionLayout m_layout;
+
+        size_t m_rowStride;
+        unsigned int m_rowsPerBlock;
+        unsigned int m_nextRow;
+
+        std::vector<unsigned char> m_block;
+
+        // only used for palettised and masked bitmaps, the block once it's been through the palette or the masks
+        std::vector<Colour> m_palette;
+        std::unique_ptr<MaskedPixelDecoder> m_maskedDecoder;
+        std::vector<Colour> m_expandedBlock;
+    };
+}
+
+#endif // SCANLINEREADER_H
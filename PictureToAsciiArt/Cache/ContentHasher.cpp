@@ -0,0 +1,171 @@
+#include "ContentHasher.h"
+
+#include <string.h>
+
+namespace
+{
+    unsigned long long const c_prime1 = 0x9E3779B185EBCA87ull;
+    unsigned long long const c_prime2 = 0xC2B2AE3D27D4EB4Full;
+    unsigned long long const c_prime3 = 0x165667B19E3779F9ull;
+    unsigned long long const c_prime4 = 0x85EBCA77C2B2AE63ull;
+    unsigned long long const c_prime5 = 0x27D4EB2F165667C5ull;
+
+    inline unsigned long long rotateLeft(unsigned long long value, unsigned int bits)
+    {
+        return (value << bits) | (value >> (64 - bits));
+    }
+
+    // little endian reads, the hash is defined on bytes. A byte at a time so unaligned input is fine, compilers turn it
+    // back into a single load
+    inline unsigned long long read64(unsigned char const* data)
+    {
+        unsigned long long value = 0;
+
+        for (unsigned int i = 0; i < 8; ++i)
+        {
+            value |= static_cast<unsigned long long>(data[i]) << (8 * i);
+        }
+
+        return value;
+    }
+
+    inline unsigned long long read32(unsigned char const* data)
+    {
+        return static_cast<unsigned long long>(data[0]) | (static_cast<unsigned long long>(data[1]) << 8) | (static_cast<unsigned long long>(data[2]) << 16) | (static_cast<unsigned long long>(data[3]) << 24);
+    }
+
+    inline unsigned long long mixRound(unsigned long long accumulator, unsigned long long input)
+    {
+        accumulator += input * c_prime2;
+        accumulator = rotateLeft(accumulator, 31);
+
+        return accumulator * c_prime1;
+    }
+
+    inline unsigned long long mergeRound(unsigned long long hash, unsigned long long accumulator)
+    {
+        hash ^= mixRound(0, accumulator);
+
+        return hash * c_prime1 + c_prime4;
+    }
+}
+
+namespace Cache
+{
+    ContentHasher::ContentHasher(unsigned long long seed)
+        : m_seed(seed)
+        , m_accumulators{ seed + c_prime1 + c_prime2, seed + c_prime2, seed, seed - c_prime1 }
+        , m_totalSize(0)
+        , m_buffer{}
+        , m_bufferedSize(0)
+    {
+    }
+
+    void ContentHasher::update(void const* data, size_t size)
+    {
+        unsigned char const* bytes = static_cast<unsigned char const*>(data);
+
+        m_totalSize += size;
+
+        // top up a part stripe left from last time first
+        if (m_bufferedSize > 0)
+        {
+            size_t const toCopy = size < c_stripeSize - m_bufferedSize ? size : c_stripeSize - m_bufferedSize;
+
+            memcpy(m_buffer + m_bufferedSize, bytes, toCopy);
+            m_bufferedSize += toCopy;
+            bytes += toCopy;
+            size -= toCopy;
+
+            if (m_bufferedSize < c_stripeSize)
+            {
+                return;
+            }
+
+            consumeStripe(m_buffer);
+            m_bufferedSize = 0;
+        }
+
+        for (; size >= c_stripeSize; bytes += c_stripeSize, size -= c_stripeSize)
+        {
+            consumeStripe(bytes);
+        }
+
+        if (size > 0)
+        {
+            memcpy(m_buffer, bytes, size);
+            m_bufferedSize = size;
+        }
+    }
+
+    unsigned long long ContentHasher::getDigest() const
+    {
+        unsigned long long hash = 0;
+
+        if (m_totalSize >= c_stripeSize)
+        {
+            hash = rotateLeft(m_accumulators[0], 1) + rotateLeft(m_accumulators[1], 7) + rotateLeft(m_accumulators[2], 12) + rotateLeft(m_accumulators[3], 18);
+
+            for (unsigned long long const accumulator : m_accumulators)
+            {
+                hash = mergeRound(hash, accumulator);
+            }
+        }
+        else
+        {
+            hash = m_seed + c_prime5;
+        }
+
+        hash += m_totalSize;
+
+        // whatever didn't fill a stripe
+        unsigned char const* tail = m_buffer;
+        size_t remaining = m_bufferedSize;
+
+        for (; remaining >= 8; tail += 8, remaining -= 8)
+        {
+            hash ^= mixRound(0, read64(tail));
+            hash = rotateLeft(hash, 27) * c_prime1 + c_prime4;
+        }
+
+        if (remaining >= 4)
+        {
+            hash ^= read32(tail) * c_prime1;
+            hash = rotateLeft(hash, 23) * c_prime2 + c_prime3;
+
+            tail += 4;
+            remaining -= 4;
+        }
+
+        for (; remaining > 0; ++tail, --remaining)
+        {
+            hash ^= *tail * c_prime5;
+            hash = rotateLeft(hash, 11) * c_prime1;
+        }
+
+        // final avalanche
+        hash ^= hash >> 33;
+        hash *= c_prime2;
+        hash ^= hash >> 29;
+        hash *= c_prime3;
+        hash ^= hash >> 32;
+
+        return hash;
+    }
+
+    unsigned long long ContentHasher::hash(void const* data, size_t size, unsigned long long seed)
+    {
+        ContentHasher hasher(seed);
+        hasher.update(data, size);
+
+        return hasher.getDigest();
+    }
+
+    void ContentHasher::consumeStripe(unsigned char const* stripe)
+    {
+        for (unsigned int lane = 0; lane < 4; ++lane)
+        {
+            m_accumulators[lane] = mixRound(m_accumulators[lane], read64(stripe + 8 * lane));
+        }
+    }
+}
@@ -0,0 +1,38 @@
+#ifndef CONTENTHASHER_H
+#define CONTENTHASHER_H
+
+#include <stddef.h>
+
+namespace Cache
+{
+    // XXH64, fed a piece at a time. Fast enough to hash a mapped image at memory bandwidth, and far from cryptographic -
+    // it's for telling inputs apart, not for anything an attacker gets to pick
+    class ContentHasher
+    {
+    public:
+        explicit ContentHasher(unsigned long long seed = 0);
+
+        void update(void const* data, size_t size);
+
+        // the hash of everything so far. Doesn't change the state, more can be added after
+        unsigned long long getDigest() const;
+
+        static unsigned long long hash(void const* data, size_t size, unsigned long long seed = 0);
+
+    private:
+        void consumeStripe(unsigned char const* stripe);
+
+    private:
+        static size_t const c_stripeSize = 32;
+
+        unsigned long long m_seed;
+        unsigned long long m_accumulators[4];
+        unsigned long long m_totalSize;
+
+        // the start of a stripe that hasn't been filled yet
+        unsigned char m_buffer[c_stripeSize];
+        size_t m_bufferedSize;
+    };
+}
+
+#endif // CONTENTHASHER_H
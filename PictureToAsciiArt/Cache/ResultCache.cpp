@@ -0,0 +1,198 @@
+#include "ResultCache.h"
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <thread>
+#include <vector>
+
+#include "ContentHasher.h"
+#include "../Bitmap/ImageView.h"
+#include "../Bitmap/LoadedImage.h"
+
+namespace Cache
+{
+    char const* const ResultCache::c_entryExtension = ".txt";
+
+    ResultCache::ResultCache(unsigned long long settingsHash, unsigned long long capacityBytes)
+        : m_settingsHash(settingsHash)
+        , m_capacityBytes(capacityBytes)
+        , m_hitCount(0)
+        , m_missCount(0)
+        , m_evictionCount(0)
+    {
+    }
+
+    bool ResultCache::open(char const* const directory)
+    {
+        std::error_code errorCode;
+
+        std::filesystem::create_directories(directory, errorCode);
+
+        m_directory = directory;
+
+        return std::filesystem::is_directory(directory, errorCode);
+    }
+
+    bool ResultCache::fetch(char const* const sourceFileName, char const* const outputFileName, std::string& key)
+    {
+        namespace fs = std::filesystem;
+
+        key.clear();
+
+        unsigned long long pixelHash = 0;
+
+        if (!hashImageFile(sourceFileName, m_region, pixelHash))
+        {
+            ++m_missCount;
+            return false;
+        }
+
+        // 128 bits between the two hashes, an accidental collision isn't worth worrying about
+        char keyText[33];
+        snprintf(keyText, sizeof(keyText), "%016llx%016llx", pixelHash, m_settingsHash);
+
+        key = keyText;
+
+        fs::path const entryPath = getEntryPath(key);
+        std::error_code errorCode;
+
+        // can lose a race with an eviction, which is just a miss
+        if (!fs::copy_file(entryPath, outputFileName, fs::copy_options::overwrite_existing, errorCode) || errorCode)
+        {
+            ++m_missCount;
+            return false;
+        }
+
+        // a hit is a use, for the eviction order
+        fs::last_write_time(entryPath, fs::file_time_type::clock::now(), errorCode);
+
+        ++m_hitCount;
+
+        return true;
+    }
+
+    void ResultCache::store(std::string const& key, char const* const outputFileName)
+    {
+        namespace fs = std::filesystem;
+
+        if (key.empty())
+        {
+            return;
+        }
+
+        fs::path const entryPath = getEntryPath(key);
+
+        // copied in under a name of its own and renamed into place, so nobody ever fetches half an entry
+        std::hash<std::thread::id> const hashThread;
+        fs::path const temporaryPath = fs::path(m_directory) / (key + "." + std::to_string(hashThread(std::this_thread::get_id())) + ".tmp");
+
+        std::error_code errorCode;
+
+        if (fs::copy_file(outputFileName, temporaryPath, fs::copy_options::overwrite_existing, errorCode) && !errorCode)
+        {
+            fs::rename(temporaryPath, entryPath, errorCode);
+        }
+
+        if (errorCode)
+        {
+            fs::remove(temporaryPath, errorCode);
+            return;
+        }
+
+        evict();
+    }
+
+    bool ResultCache::hashImageFile(char const* const sourceFileName, Bitmap::ImageRegion const& region, unsigned long long& pixelHash)
+    {
+        // palettised bitmaps are expanded into a canvas, so they share entries with the same pixels stored as 24-bit
+        Bitmap::LoadedImage loadedImage;
+
+        if (loadedImage.open(sourceFileName, Bitmap::LoadedImage::Method::MapFile, region) != Bitmap::FileHandlingErrors::OK)
+        {
+            return false;
+        }
+
+        Bitmap::ImageView const& image = loadedImage.getView();
+
+        unsigned int const size[2] = { image.getWidth(), image.getHeight() };
+        size_t const rowSize = static_cast<size_t>(image.getWidth()) * 3;
+
+        ContentHasher hasher;
+        hasher.update(size, sizeof(size));
+
+        for (unsigned int y = 0; y < image.getHeight(); ++y)
+        {
+            hasher.update(image.getRow(y), rowSize);
+        }
+
+        pixelHash = hasher.getDigest();
+
+        return true;
+    }
+
+    std::string ResultCache::getEntryPath(std::string const& key) const
+    {
+        return (std::filesystem::path(m_directory) / (key + c_entryExtension)).string();
+    }
+
+    void ResultCache::evict()
+    {
+        namespace fs = std::filesystem;
+
+        struct Entry
+        {
+            fs::path path;
+            fs::file_time_type lastUsed;
+            unsigned long long size;
+        };
+
+        std::lock_guard<std::mutex> lock(m_evictionMutex);
+
+        // the directory is the index, so other processes' entries count towards the capacity too
+        std::vector<Entry> entries;
+        unsigned long long totalSize = 0;
+
+        std::error_code errorCode;
+
+        for (fs::directory_entry const& directoryEntry : fs::directory_iterator(m_directory, errorCode))
+        {
+            std::error_code entryError;
+
+            if (directoryEntry.path().extension() != c_entryExtension || !directoryEntry.is_regular_file(entryError))
+            {
+                continue;
+            }
+
+            Entry entry = { directoryEntry.path(), directoryEntry.last_write_time(entryError), directoryEntry.file_size(entryError) };
+
+            if (!entryError)
+            {
+                totalSize += entry.size;
+                entries.push_back(entry);
+            }
+        }
+
+        if (totalSize <= m_capacityBytes)
+        {
+            return;
+        }
+
+        std::sort(entries.begin(), entries.end(), [](Entry const& a, Entry const& b) { return a.lastUsed < b.lastUsed; });
+
+        for (Entry const& entry : entries)
+        {
+            if (totalSize <= m_capacityBytes)
+            {
+                break;
+            }
+
+            if (fs::remove(entry.path, errorCode))
+            {
+                totalSize -= entry.size;
+                ++m_evictionCount;
+            }
+        }
+    }
+}
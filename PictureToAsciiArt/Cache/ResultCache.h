@@ -0,0 +1,74 @@
+#ifndef RESULTCACHE_H
+#define RESULTCACHE_H
+
+#include <atomic>
+#include <mutex>
+#include <string>
+
+#include "../Bitmap/ImageRegion.h"
+
+namespace Cache
+{
+    // converted text kept on disk, keyed by the source's pixels and the settings it was converted with. Every entry is a
+    // file named after its key, so a hit is a file copy and nothing is decoded or converted. The pixels are hashed
+    // through a memory mapping of the source, so even a miss only costs reading the file once more.
+    // entries are evicted least recently used first once the directory is over its capacity, a hit counts as a use.
+    // Safe to use from several threads, and from several processes sharing a directory - the worst a race can do is
+    // turn a hit into a miss
+    class ResultCache
+    {
+    public:
+        // settingsHash covers everything other than the pixels that changes the text - ramp, size, mode and so on
+        ResultCache(unsigned long long settingsHash, unsigned long long capacityBytes);
+
+        ResultCache(ResultCache const&) = delete;
+        ResultCache& operator=(ResultCache const&) = delete;
+
+        // the directory is created if it isn't there
+        bool open(char const* const directory);
+
+        // when only a region of each source is converted only that region is hashed, so none of the rest is read. The
+        // region has to be part of the settings hash too
+        inline void setRegion(Bitmap::ImageRegion const& region) { m_region = region; }
+
+        // looks the source up by its pixels. On a hit the cached text is copied to outputFileName and true is returned.
+        // On a miss key is set ready for store, or left empty if the source couldn't be mapped
+        bool fetch(char const* const sourceFileName, char const* const outputFileName, std::string& key);
+
+        // copies a freshly written output in under the key, then evicts until the directory is back under capacity
+        void store(std::string const& key, char const* const outputFileName);
+
+        inline unsigned long long getHitCount() const { return m_hitCount; }
+        inline unsigned long long getMissCount() const { return m_missCount; }
+        inline unsigned long long getEvictionCount() const { return m_evictionCount; }
+
+        // hashes the pixels of a bitmap (or the region of it) through a memory mapping, rows only so padding never changes
+        // the hash. False if the file couldn't be opened
+        static bool hashImageFile(char const* const sourceFileName, Bitmap::ImageRegion const& region, unsigned long long& pixelHash);
+
+    private:
+        std::string getEntryPath(std::string const& key) const;
+
+        // oldest first until the entries fit. Holds m_evictionMutex
+        void evict();
+
+    private:
+        static char const* const c_entryExtension;
+
+        unsigned long long m_settingsHash;
+        unsigned long long m_capacityBytes;
+
+        Bitmap::ImageRegion m_region;
+
+        std::string m_directory;
+
+        std::atomic<unsigned long long> m_hitCount;
+        std::atomic<unsigned long long> m_missCount;
+        std::atomic<unsigned long long> m_evictionCount;
+
+        // one eviction scan at a time, stores carry on meanwhile
+        std::mutex m_evictionMutex;
+    };
+}
+
+#endif // RESULTCACHE_H
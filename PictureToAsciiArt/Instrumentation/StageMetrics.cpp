@@ -0,0 +1,280 @@
+#include "StageMetrics.h"
+
+#include "../Bitmap/PortableStdio.h"
+
+namespace
+{
+    // what's collecting on this thread, and the innermost timer running on it
+    thread_local Instrumentation::StageMetrics* t_currentMetrics = nullptr;
+    thread_local Instrumentation::StageTimer* t_activeTimer = nullptr;
+}
+
+namespace Instrumentation
+{
+    char const* getStageName(Stage stage)
+    {
+        switch (stage)
+        {
+        case Stage::HeaderParse: return "header_parse";
+        case Stage::PixelRead: return "pixel_read";
+        case Stage::Downscale: return "downscale";
+        case Stage::GlyphMapping: return "glyph_mapping";
+        case Stage::OutputWrite: return "output_write";
+        default: return "unknown";
+        }
+    }
+
+    StageMetrics::StageMetrics()
+        : m_images(0)
+        , m_wallNanoseconds(0)
+    {
+        for (AtomicTotals& stage : m_stages)
+        {
+            stage.calls = 0;
+            stage.nanoseconds = 0;
+            stage.bytes = 0;
+            stage.ioCalls = 0;
+            stage.pixels = 0;
+        }
+    }
+
+    void StageMetrics::add(Stage stage, StageTotals const& totals)
+    {
+        // only ever read once everything has finished, so nothing needs ordering
+        AtomicTotals& target = m_stages[static_cast<int>(stage)];
+
+        target.calls.fetch_add(totals.calls, std::memory_order_relaxed);
+        target.nanoseconds.fetch_add(totals.nanoseconds, std::memory_order_relaxed);
+        target.bytes.fetch_add(totals.bytes, std::memory_order_relaxed);
+        target.ioCalls.fetch_add(totals.ioCalls, std::memory_order_relaxed);
+        target.pixels.fetch_add(totals.pixels, std::memory_order_relaxed);
+    }
+
+    void StageMetrics::addImage(unsigned long long wallNanoseconds)
+    {
+        m_images.fetch_add(1, std::memory_order_relaxed);
+        m_wallNanoseconds.fetch_add(wallNanoseconds, std::memory_order_relaxed);
+    }
+
+    void StageMetrics::merge(StageMetrics const& other)
+    {
+        for (int i = 0; i < static_cast<int>(Stage::Count); ++i)
+        {
+            add(static_cast<Stage>(i), other.getTotals(static_cast<Stage>(i)));
+        }
+
+        m_images.fetch_add(other.getImageCount(), std::memory_order_relaxed);
+        m_wallNanoseconds.fetch_add(other.getWallNanoseconds(), std::memory_order_relaxed);
+    }
+
+    StageTotals StageMetrics::getTotals(Stage stage) const
+    {
+        AtomicTotals const& source = m_stages[static_cast<int>(stage)];
+
+        StageTotals totals;
+        totals.calls = source.calls.load(std::memory_order_relaxed);
+        totals.nanoseconds = source.nanoseconds.load(std::memory_order_relaxed);
+        totals.bytes = source.bytes.load(std::memory_order_relaxed);
+        totals.ioCalls = source.ioCalls.load(std::memory_order_relaxed);
+        totals.pixels = source.pixels.load(std::memory_order_relaxed);
+
+        return totals;
+    }
+
+    void StageMetrics::writeJson(FILE& file, char const* indent) const
+    {
+        fprintf(&file, "{\n%s  \"images\": %llu,\n%s  \"wall_seconds\": %.6f,\n%s  \"stages\": {\n"
+            , indent, getImageCount()
+            , indent, getWallNanoseconds() / 1e9
+            , indent);
+
+        for (int i = 0; i < static_cast<int>(Stage::Count); ++i)
+        {
+            StageTotals const totals = getTotals(static_cast<Stage>(i));
+
+            fprintf(&file, "%s    \"%s\": { \"calls\": %llu, \"seconds\": %.6f, \"bytes\": %llu, \"io_calls\": %llu, \"pixels\": %llu }%s\n"
+                , indent
+                , getStageName(static_cast<Stage>(i))
+                , totals.calls
+                , totals.nanoseconds / 1e9
+                , totals.bytes
+                , totals.ioCalls
+                , totals.pixels
+                , i + 1 < static_cast<int>(Stage::Count) ? "," : "");
+        }
+
+        fprintf(&file, "%s  }\n%s}", indent, indent);
+    }
+
+    ScopedCollection::ScopedCollection(StageMetrics* metrics)
+        : m_previous(t_currentMetrics)
+    {
+        t_currentMetrics = metrics;
+    }
+
+    ScopedCollection::~ScopedCollection()
+    {
+        t_currentMetrics = m_previous;
+    }
+
+    StageMetrics* ScopedCollection::getCurrent()
+    {
+        return t_currentMetrics;
+    }
+
+    ImageScope::ImageScope(StageMetrics* metrics)
+        : m_collection(metrics)
+        , m_metrics(metrics)
+    {
+        if (m_metrics)
+        {
+            m_startTime = std::chrono::steady_clock::now();
+        }
+    }
+
+    ImageScope::~ImageScope()
+    {
+        if (m_metrics)
+        {
+            m_metrics->addImage(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_startTime).count());
+        }
+    }
+
+    StageTimer::StageTimer(Stage stage)
+        : m_metrics(t_currentMetrics)
+        , m_stage(stage)
+        , m_totals()
+        , m_previous(nullptr)
+    {
+        if (m_metrics)
+        {
+            m_previous = t_activeTimer;
+            t_activeTimer = this;
+
+            m_startTime = std::chrono::steady_clock::now();
+        }
+    }
+
+    StageTimer::~StageTimer()
+    {
+        if (m_metrics)
+        {
+            m_totals.calls = 1;
+            m_totals.nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_startTime).count();
+
+            m_metrics->add(m_stage, m_totals);
+
+            t_activeTimer = m_previous;
+        }
+    }
+
+    void StageTimer::recordIo(unsigned long long bytes)
+    {
+        if (t_activeTimer)
+        {
+            t_activeTimer->addIo(bytes);
+        }
+    }
+
+    MetricsReport::MetricsReport(bool includeImages)
+        : m_file(nullptr)
+        , m_includeImages(includeImages)
+        , m_firstImage(true)
+    {
+    }
+
+    MetricsReport::~MetricsReport()
+    {
+        if (m_file)
+        {
+            fclose(m_file);
+        }
+    }
+
+    bool MetricsReport::open(char const* const filename)
+    {
+        errno_t fileError = fopen_s(&m_file, filename, "w");
+
+        if (m_file == nullptr || fileError != 0)
+        {
+            m_file = nullptr;
+            return false;
+        }
+
+        fprintf(m_file, "{\n");
+
+        if (m_includeImages)
+        {
+            fprintf(m_file, "  \"images\": [");
+        }
+
+        return true;
+    }
+
+    void MetricsReport::addImage(char const* const sourceFileName, StageMetrics const& metrics)
+    {
+        m_total.merge(metrics);
+
+        if (m_file && m_includeImages)
+        {
+            fprintf(m_file, "%s\n    { \"source\": ", m_firstImage ? "" : ",");
+            writeJsonString(*m_file, sourceFileName);
+            fprintf(m_file, ", \"metrics\": ");
+            metrics.writeJson(*m_file, "    ");
+            fprintf(m_file, " }");
+
+            m_firstImage = false;
+        }
+    }
+
+    bool MetricsReport::close(double elapsedSeconds)
+    {
+        if (m_file == nullptr)
+        {
+            return false;
+        }
+
+        if (m_includeImages)
+        {
+            fprintf(m_file, "\n  ],\n");
+        }
+
+        fprintf(m_file, "  \"total\": ");
+        m_total.writeJson(*m_file, "  ");
+        fprintf(m_file, ",\n  \"elapsed_seconds\": %.6f\n}\n", elapsedSeconds);
+
+        bool const succeeded = ferror(m_file) == 0;
+
+        fclose(m_file);
+        m_file = nullptr;
+
+        return succeeded;
+    }
+
+    void MetricsReport::writeJsonString(FILE& file, char const* text)
+    {
+        // windows paths are full of backslashes
+        fputc('"', &file);
+
+        for (; *text != '\0'; ++text)
+        {
+            unsigned char const c = static_cast<unsigned char>(*text);
+
+            if (c == '"' || c == '\\')
+            {
+                fputc('\\', &file);
+                fputc(c, &file);
+            }
+            else if (c < 0x20)
+            {
+                fprintf(&file, "\\u%04x", c);
+            }
+            else
+            {
+                fputc(c, &file);
+            }
+        }
+
+        fputc('"', &file);
+    }
+}
@@ -0,0 +1,167 @@
+#ifndef STAGEMETRICS_H
+#define STAGEMETRICS_H
+
+#include <stdio.h>
+
+#include <atomic>
+#include <chrono>
+
+namespace Instrumentation
+{
+    enum class Stage
+    {
+        HeaderParse     // reading and validating the bitmap headers
+        , PixelRead     // pixel data coming off disk, or being mapped in
+        , Downscale     // box filtering down to the target size
+        , GlyphMapping  // pixels to glyphs
+        , OutputWrite   // the text going out to the file
+        , Count
+    };
+
+    // snake case, as it appears in the JSON
+    char const* getStageName(Stage stage);
+
+    struct StageTotals
+    {
+        unsigned long long calls;
+        unsigned long long nanoseconds;
+        unsigned long long bytes;
+        unsigned long long ioCalls;
+        unsigned long long pixels;
+    };
+
+    // counters for every stage of one image, or of a whole batch once they're merged together. Stages that run on several
+    // threads at once can add to the same metrics, their time is summed over every thread that worked on them
+    class StageMetrics
+    {
+    public:
+        StageMetrics();
+
+        StageMetrics(StageMetrics const&) = delete;
+        StageMetrics& operator=(StageMetrics const&) = delete;
+
+        void add(Stage stage, StageTotals const& totals);
+
+        // counts an image and the wall time it took from start to finish
+        void addImage(unsigned long long wallNanoseconds);
+
+        void merge(StageMetrics const& other);
+
+        StageTotals getTotals(Stage stage) const;
+        inline unsigned long long getImageCount() const { return m_images.load(std::memory_order_relaxed); }
+        inline unsigned long long getWallNanoseconds() const { return m_wallNanoseconds.load(std::memory_order_relaxed); }
+
+        // a single JSON object, every line after the first starts with the indent
+        void writeJson(FILE& file, char const* indent) const;
+
+    private:
+        struct AtomicTotals
+        {
+            std::atomic<unsigned long long> calls;
+            std::atomic<unsigned long long> nanoseconds;
+            std::atomic<unsigned long long> bytes;
+            std::atomic<unsigned long long> ioCalls;
+            std::atomic<unsigned long long> pixels;
+        };
+
+        AtomicTotals m_stages[static_cast<int>(Stage::Count)];
+
+        std::atomic<unsigned long long> m_images;
+        std::atomic<unsigned long long> m_wallNanoseconds;
+    };
+
+    // sends every StageTimer on this thread to the metrics while it's in scope. Null turns collection off, which is what a
+    // task wants when the worker it lands on was collecting for some other image
+    class ScopedCollection
+    {
+    public:
+        explicit ScopedCollection(StageMetrics* metrics);
+        ~ScopedCollection();
+
+        ScopedCollection(ScopedCollection const&) = delete;
+        ScopedCollection& operator=(ScopedCollection const&) = delete;
+
+        // what this thread is collecting into, if anything. Tasks handed to other threads take this with them
+        static StageMetrics* getCurrent();
+
+    private:
+        StageMetrics* m_previous;
+    };
+
+    // collects for one image from start to finish, then counts the image and its wall time into the metrics
+    class ImageScope
+    {
+    public:
+        explicit ImageScope(StageMetrics* metrics);
+        ~ImageScope();
+
+        ImageScope(ImageScope const&) = delete;
+        ImageScope& operator=(ImageScope const&) = delete;
+
+    private:
+        ScopedCollection m_collection;
+
+        StageMetrics* m_metrics;
+        std::chrono::steady_clock::time_point m_startTime;
+    };
+
+    // times a stage from construction to destruction. When nothing is collecting on this thread it never reads the clock,
+    // so all it costs is a thread local lookup
+    class StageTimer
+    {
+    public:
+        explicit StageTimer(Stage stage);
+        ~StageTimer();
+
+        StageTimer(StageTimer const&) = delete;
+        StageTimer& operator=(StageTimer const&) = delete;
+
+        inline void addPixels(unsigned long long pixels) { m_totals.pixels += pixels; }
+        inline void addIo(unsigned long long bytes) { m_totals.bytes += bytes; ++m_totals.ioCalls; }
+
+        // charges a read or write to whichever timer is running on this thread, if there is one
+        static void recordIo(unsigned long long bytes);
+
+    private:
+        StageMetrics* m_metrics;
+        Stage m_stage;
+
+        StageTotals m_totals;
+        std::chrono::steady_clock::time_point m_startTime;
+
+        StageTimer* m_previous;
+    };
+
+    // the metrics file. Images are written as they're added, then the total for the whole run when it's closed:
+    // { "images": [ { "source": ..., "metrics": {...} }, ... ], "total": {...}, "elapsed_seconds": ... }
+    class MetricsReport
+    {
+    public:
+        // without per image entries only the total is written
+        explicit MetricsReport(bool includeImages);
+        ~MetricsReport();
+
+        MetricsReport(MetricsReport const&) = delete;
+        MetricsReport& operator=(MetricsReport const&) = delete;
+
+        bool open(char const* const filename);
+
+        // merged into the total whether or not it's written out on its own
+        void addImage(char const* const sourceFileName, StageMetrics const& metrics);
+
+        // elapsedSeconds is the wall time of the whole run, which isn't the sum of the images once they run in parallel
+        bool close(double elapsedSeconds);
+
+    private:
+        static void writeJsonString(FILE& file, char const* text);
+
+    private:
+        FILE* m_file;
+        bool m_includeImages;
+        bool m_firstImage;
+
+        StageMetrics m_total;
+    };
+}
+
+#endif // STAGEMETRICS_H
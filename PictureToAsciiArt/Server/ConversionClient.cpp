@@ -0,0 +1,28 @@
+#include "ConversionClient.h"
+
+namespace Server
+{
+    ConversionClient::ConversionClient()
+    {
+    }
+
+    bool ConversionClient::connect(char const* const socketPath)
+    {
+        return m_socket.connect(socketPath);
+    }
+
+    void ConversionClient::close()
+    {
+        m_socket.close();
+    }
+
+    bool ConversionClient::send(Request const& request, Response& response)
+    {
+        unsigned char header[c_requestHeaderSize];
+        encodeRequestHeader(request, header);
+
+        return sendFrame(m_socket, header, c_requestHeaderSize, request.body, request.bodySize)
+            && receiveFrame(m_socket, m_payload)
+            && decodeResponse(m_payload, response);
+    }
+}
@@ -0,0 +1,36 @@
+#ifndef CONVERSIONCLIENT_H
+#define CONVERSIONCLIENT_H
+
+#include <vector>
+
+#include "LocalSocket.h"
+#include "Protocol.h"
+
+namespace Server
+{
+    // the other end of a ConversionServer. Requests go one at a time down a single connection, which stays open
+    // between them so only the first pays for connecting
+    class ConversionClient
+    {
+    public:
+        ConversionClient();
+
+        ConversionClient(ConversionClient const&) = delete;
+        ConversionClient& operator=(ConversionClient const&) = delete;
+
+        bool connect(char const* const socketPath);
+        void close();
+
+        // sends the request with its body and waits for the answer. The response's text is only valid until the next
+        // request. False if the connection failed, or the answer didn't decode
+        bool send(Request const& request, Response& response);
+
+    private:
+        LocalSocket m_socket;
+
+        // kept so responses of a similar size don't allocate
+        std::vector<unsigned char> m_payload;
+    };
+}
+
+#endif // CONVERSIONCLIENT_H
@@ -0,0 +1,329 @@
+#include "ConversionServer.h"
+
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <new>
+#include <thread>
+#include <utility>
+
+#include "../Ascii/ErrorDiffusionConverter.h"
+#include "../Ascii/GlyphAtlas.h"
+#include "../Ascii/GlyphRamp.h"
+#include "../Ascii/OutputWriter.h"
+#include "../Bitmap/AreaDownscaler.h"
+#include "../Bitmap/ImageCanvas.h"
+#include "../Bitmap/ImageView.h"
+#include "../Bitmap/LoadedImage.h"
+
+namespace Server
+{
+    ConversionServer::ConversionServer(Ascii::GlyphRamp const& ramp, unsigned int charactersPerPixel, Ascii::GlyphRowKernel::InstructionSet instructionSet, unsigned int threadCount)
+        : m_ramp(&ramp)
+        , m_charactersPerPixel(charactersPerPixel)
+        , m_plainKernel(ramp, charactersPerPixel, instructionSet, Ascii::GlyphRowKernel::Dithering::None)
+        , m_orderedKernel(ramp, charactersPerPixel, instructionSet, Ascii::GlyphRowKernel::Dithering::Ordered)
+        , m_palette256Converter(ramp, charactersPerPixel, Ascii::AnsiColourConverter::ColourMode::Palette256)
+        , m_trueColourConverter(ramp, charactersPerPixel, Ascii::AnsiColourConverter::ColourMode::TrueColour)
+        , m_shapeConverter(Ascii::GlyphAtlas::getDefault())
+        , m_threadPool(threadCount)
+        , m_stopping(false)
+        , m_connectionCount(0)
+        , m_requestCount(0)
+        , m_totalMicroseconds(0)
+    {
+    }
+
+    ConversionServer::~ConversionServer()
+    {
+    }
+
+    bool ConversionServer::run(char const* const socketPath)
+    {
+        m_socketPath = socketPath;
+
+        if (!m_listener.listen(socketPath))
+        {
+            return false;
+        }
+
+        printf("Listening on \"%s\" with %u conversion threads\n", socketPath, m_threadPool.getThreadCount());
+        fflush(stdout);
+
+        while (true)
+        {
+            LocalSocket client = m_listener.accept();
+
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+
+                // stop wakes the accept up by connecting to it, that connection is just dropped
+                if (m_stopping)
+                {
+                    break;
+                }
+
+                if (!client.isValid())
+                {
+                    continue;
+                }
+
+                ++m_connectionCount;
+            }
+
+            std::thread([this](LocalSocket client)
+            {
+                serveClient(client);
+                client.close();
+
+                std::lock_guard<std::mutex> lock(m_mutex);
+                --m_connectionCount;
+                m_connectionFinished.notify_all();
+            }, std::move(client)).detach();
+        }
+
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_connectionFinished.wait(lock, [this]() { return m_connectionCount == 0; });
+        }
+
+        m_listener.close();
+        remove(socketPath);
+
+        unsigned long long const requestCount = m_requestCount.load();
+        double const meanMilliseconds = requestCount > 0 ? m_totalMicroseconds.load() / 1000.0 / requestCount : 0.0;
+
+        printf("Served %llu requests, %.3f ms each on average\n", requestCount, meanMilliseconds);
+
+        return true;
+    }
+
+    void ConversionServer::serveClient(LocalSocket& client)
+    {
+        // both kept for the connection's next request
+        std::vector<unsigned char> payload;
+        std::vector<char> text;
+
+        bool keepServing = true;
+
+        while (keepServing && beginWaiting(client))
+        {
+            bool const received = receiveFrame(client, payload);
+
+            endWaiting(client);
+
+            if (!received)
+            {
+                break;
+            }
+
+            std::chrono::steady_clock::time_point const startTime = std::chrono::steady_clock::now();
+
+            Request request = {};
+            Response response = { Status::OK, Bitmap::FileHandlingErrors::OK, 0, nullptr, 0 };
+
+            unsigned int width = 0;
+            unsigned int height = 0;
+
+            text.clear();
+
+            if (!decodeRequest(payload, request))
+            {
+                // there's no telling where the next frame starts after a bad one
+                response.status = Status::BadRequest;
+                keepServing = false;
+            }
+            else if (request.command == Command::Shutdown)
+            {
+                stop();
+            }
+            else
+            {
+                // waited for here, the connection has nothing else to do until it's answered. get() rethrows whatever the
+                // conversion threw, which fails this request rather than answering it with whatever text was left
+                std::future<void> converted = m_threadPool.submit([&]()
+                {
+                    response.error = convert(request, text, width, height);
+                });
+
+                try
+                {
+                    converted.get();
+                }
+                catch (std::bad_alloc const&)
+                {
+                    response.error = Bitmap::FileHandlingErrors::OutOfMemory;
+                }
+                catch (...)
+                {
+                    response.error = Bitmap::FileHandlingErrors::UnknownReadError;
+                }
+
+                if (response.error != Bitmap::FileHandlingErrors::OK)
+                {
+                    text.clear();
+                }
+
+                response.status = response.error == Bitmap::FileHandlingErrors::OK ? Status::OK : Status::ConversionFailed;
+            }
+
+            response.serverMicroseconds = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime).count();
+
+            if (response.status == Status::BadRequest)
+            {
+                printf("Dropped a client after a bad request\n");
+            }
+            else if (request.command != Command::Shutdown)
+            {
+                m_requestCount += 1;
+                m_totalMicroseconds += response.serverMicroseconds;
+
+                if (response.status == Status::OK)
+                {
+                    printf("Converted %u x %u into %zu bytes in %.3f ms\n", width, height, text.size(), response.serverMicroseconds / 1000.0);
+                }
+                else
+                {
+                    printf("Failed to convert: %s\n", Bitmap::getFileHandlingErrorName(response.error));
+                }
+            }
+
+            unsigned char header[c_responseHeaderSize];
+            encodeResponseHeader(response, header);
+
+            keepServing = sendFrame(client, header, c_responseHeaderSize, text.data(), text.size()) && keepServing;
+        }
+    }
+
+    Bitmap::FileHandlingErrors ConversionServer::convert(Request const& request, std::vector<char>& text, unsigned int& width, unsigned int& height)
+    {
+        ConversionOptions const& options = request.options;
+
+        // bitmaps sent whole are viewed where they landed, paths are loaded into a canvas from the pool. Palettised
+        // bitmaps have nothing to view in place, so they go into a canvas either way
+        Bitmap::LoadedImage loadedImage(m_canvasPool);
+
+        Bitmap::FileHandlingErrors error = Bitmap::FileHandlingErrors::OK;
+
+        if (request.command == Command::ConvertBitmap)
+        {
+            error = loadedImage.openMemory(request.body, request.bodySize, Bitmap::LoadedImage::Method::MapFile);
+        }
+        else
+        {
+            std::string const path(reinterpret_cast<char const*>(request.body), request.bodySize);
+
+            error = loadedImage.open(path.c_str(), Bitmap::LoadedImage::Method::LoadIntoCanvas);
+        }
+
+        Bitmap::ImageView const& image = loadedImage.getView();
+
+        if (error != Bitmap::FileHandlingErrors::OK)
+        {
+            return error;
+        }
+
+        width = image.getWidth();
+        height = image.getHeight();
+
+        // each worker keeps its own, so their buffers and tables stay warm between requests
+        thread_local Ascii::OutputWriter writer;
+        thread_local Bitmap::AreaDownscaler downscaler;
+
+        // a conversion that threw left it open on another request's text, which may not even be there any more
+        writer.discard();
+        writer.openMemory(text);
+
+        if (options.targetColumns > 0)
+        {
+            unsigned int targetWidth = 0;
+            unsigned int targetHeight = 0;
+
+            if (options.shapeMatching)
+            {
+                Ascii::ShapeMatchConverter::calculateTargetSize(width, height, options.targetColumns, options.cellAspect, targetWidth, targetHeight);
+            }
+            else
+            {
+                Bitmap::AreaDownscaler::calculateTargetSize(width, height, options.targetColumns, m_charactersPerPixel, options.cellAspect, targetWidth, targetHeight);
+            }
+
+            Bitmap::PooledCanvas downscaled(m_canvasPool);
+            downscaler.downscale(image, targetWidth, targetHeight, downscaled.get());
+
+            writeAsciiArt(options, downscaled.get().getTopDownView(), writer);
+        }
+        else
+        {
+            writeAsciiArt(options, image, writer);
+        }
+
+        return writer.close();
+    }
+
+    void ConversionServer::writeAsciiArt(ConversionOptions const& options, Bitmap::ImageView const& image, Ascii::OutputWriter& writer)
+    {
+        // the same order of precedence as the command line
+        if (options.shapeMatching)
+        {
+            m_shapeConverter.writeLines(image, 0, image.getHeight(), writer);
+        }
+        else if (options.colourOutput == ColourOutput::Palette256)
+        {
+            m_palette256Converter.writeLines(image, 0, image.getHeight(), writer);
+        }
+        else if (options.colourOutput == ColourOutput::TrueColour)
+        {
+            m_trueColourConverter.writeLines(image, 0, image.getHeight(), writer);
+        }
+        else if (options.dithering == Dithering::FloydSteinberg)
+        {
+            // carries error from row to row so it can't be shared. Its table is only the size of a few rows of text
+            Ascii::ErrorDiffusionConverter errorDiffusion(*m_ramp, m_charactersPerPixel);
+            errorDiffusion.begin();
+            errorDiffusion.writeLines(image, 0, image.getHeight(), writer);
+        }
+        else
+        {
+            writer.writeLines(options.dithering == Dithering::Ordered ? m_orderedKernel : m_plainKernel, image, 0, image.getHeight());
+        }
+    }
+
+    void ConversionServer::stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            m_stopping = true;
+
+            for (LocalSocket* connection : m_waitingConnections)
+            {
+                connection->shutdown();
+            }
+        }
+
+        // accept only comes back when something connects
+        LocalSocket wakeUp;
+        wakeUp.connect(m_socketPath.c_str());
+    }
+
+    bool ConversionServer::beginWaiting(LocalSocket& client)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        if (!m_stopping)
+        {
+            m_waitingConnections.push_back(&client);
+        }
+
+        return !m_stopping;
+    }
+
+    void ConversionServer::endWaiting(LocalSocket& client)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        m_waitingConnections.erase(std::remove(m_waitingConnections.begin(), m_waitingConnections.end(), &client), m_waitingConnections.end());
+    }
+}
@@ -0,0 +1,93 @@
+#ifndef CONVERSIONSERVER_H
+#define CONVERSIONSERVER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "LocalSocket.h"
+#include "Protocol.h"
+#include "../Ascii/AnsiColourConverter.h"
+#include "../Ascii/GlyphRowKernel.h"
+#include "../Ascii/ShapeMatchConverter.h"
+#include "../Bitmap/CanvasPool.h"
+#include "../Bitmap/FileHandlingErrors.h"
+#include "../Threading/ThreadPool.h"
+
+// forward declarations
+namespace Ascii
+{
+    class GlyphRamp;
+    class OutputWriter;
+}
+
+namespace Bitmap
+{
+    class ImageView;
+}
+
+namespace Server
+{
+    // converts images for clients on a Unix domain socket, so a caller converting lots of small images only pays for
+    // the conversion and not for starting a process, building tables and growing buffers every time. Every converter is
+    // built once up front and shared, canvases come from one pool and each worker keeps its own writer and downscaler.
+    // Each connection has a thread of its own that only reads and answers, the conversions themselves are queued onto
+    // the pool so however many clients there are the machine's cores are never oversubscribed. The ramp must outlive it
+    class ConversionServer
+    {
+    public:
+        // 0 threads means one per hardware thread
+        ConversionServer(Ascii::GlyphRamp const& ramp, unsigned int charactersPerPixel, Ascii::GlyphRowKernel::InstructionSet instructionSet, unsigned int threadCount);
+        ~ConversionServer();
+
+        ConversionServer(ConversionServer const&) = delete;
+        ConversionServer& operator=(ConversionServer const&) = delete;
+
+        // serves until a client sends Command::Shutdown, then waits for every connection to finish. False if it
+        // couldn't listen on the path
+        bool run(char const* const socketPath);
+
+    private:
+        void serveClient(LocalSocket& client);
+
+        // runs on the pool. The text is appended, the image size is reported for the log
+        Bitmap::FileHandlingErrors convert(Request const& request, std::vector<char>& text, unsigned int& width, unsigned int& height);
+        void writeAsciiArt(ConversionOptions const& options, Bitmap::ImageView const& image, Ascii::OutputWriter& writer);
+
+        // stops accepting, wakes idle connections and lets everything in flight finish
+        void stop();
+
+        // a connection waiting for its next request can be woken by stop. False if the server is already stopping
+        bool beginWaiting(LocalSocket& client);
+        void endWaiting(LocalSocket& client);
+
+    private:
+        Ascii::GlyphRamp const* m_ramp;
+        unsigned int m_charactersPerPixel;
+
+        Ascii::GlyphRowKernel const m_plainKernel;
+        Ascii::GlyphRowKernel const m_orderedKernel;
+        Ascii::AnsiColourConverter const m_palette256Converter;
+        Ascii::AnsiColourConverter const m_trueColourConverter;
+        Ascii::ShapeMatchConverter const m_shapeConverter;
+
+        Bitmap::CanvasPool m_canvasPool;
+        Threading::ThreadPool m_threadPool;
+
+        std::string m_socketPath;
+        LocalSocket m_listener;
+
+        std::mutex m_mutex;
+        std::condition_variable m_connectionFinished;
+        bool m_stopping;
+        unsigned int m_connectionCount;
+        std::vector<LocalSocket*> m_waitingConnections;
+
+        std::atomic<unsigned long long> m_requestCount;
+        std::atomic<unsigned long long> m_totalMicroseconds;
+    };
+}
+
+#endif // CONVERSIONSERVER_H
@@ -0,0 +1,269 @@
+#include "LocalSocket.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <winsock2.h>
+#include <afunix.h>
+#pragma comment(lib, "Ws2_32.lib")
+#else
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace Server
+{
+    namespace
+    {
+#ifdef _WIN32
+        typedef SOCKET SocketHandle;
+        typedef int TransferSize;
+
+        int const c_sendFlags = 0;
+
+        // winsock has to be started before the first socket, once for the whole process
+        void startSockets()
+        {
+            struct Startup
+            {
+                Startup()
+                {
+                    WSADATA data;
+                    WSAStartup(MAKEWORD(2, 2), &data);
+                }
+
+                ~Startup()
+                {
+                    WSACleanup();
+                }
+            };
+
+            static Startup startup;
+        }
+
+        void closeHandle(SocketHandle handle) { closesocket(handle); }
+        int const c_shutdownBoth = SD_BOTH;
+#else
+        typedef int SocketHandle;
+        typedef size_t TransferSize;
+
+        // a client hanging up mid response is a failed send, not a SIGPIPE that takes the whole server down
+#ifdef MSG_NOSIGNAL
+        int const c_sendFlags = MSG_NOSIGNAL;
+#else
+        int const c_sendFlags = 0;
+#endif
+
+        void startSockets()
+        {
+        }
+
+        void closeHandle(SocketHandle handle) { ::close(handle); }
+        int const c_shutdownBoth = SHUT_RDWR;
+#endif
+
+        // sends and receives are split up so a count never overflows what the platform takes in one call
+        size_t const c_maximumTransfer = 1 << 30;
+
+        SocketHandle createSocket()
+        {
+            startSockets();
+
+            SocketHandle const handle = socket(AF_UNIX, SOCK_STREAM, 0);
+
+#if defined(SO_NOSIGPIPE)
+            // platforms without MSG_NOSIGNAL set it on the socket instead
+            int const enable = 1;
+            setsockopt(handle, SOL_SOCKET, SO_NOSIGPIPE, &enable, sizeof(enable));
+#endif
+
+            return handle;
+        }
+
+        bool fillAddress(char const* const path, sockaddr_un& address)
+        {
+            memset(&address, 0, sizeof(address));
+            address.sun_family = AF_UNIX;
+
+            size_t const length = strlen(path);
+
+            // the path has to fit with its terminator
+            if (length >= sizeof(address.sun_path))
+            {
+                return false;
+            }
+
+            memcpy(address.sun_path, path, length);
+
+            return true;
+        }
+    }
+
+    LocalSocket::LocalSocket()
+        : m_handle(c_invalidHandle)
+    {
+    }
+
+    LocalSocket::LocalSocket(long long handle)
+        : m_handle(handle)
+    {
+    }
+
+    LocalSocket::~LocalSocket()
+    {
+        close();
+    }
+
+    LocalSocket::LocalSocket(LocalSocket&& other)
+        : m_handle(other.m_handle)
+    {
+        other.m_handle = c_invalidHandle;
+    }
+
+    LocalSocket& LocalSocket::operator=(LocalSocket&& other)
+    {
+        if (this != &other)
+        {
+            close();
+
+            m_handle = other.m_handle;
+            other.m_handle = c_invalidHandle;
+        }
+
+        return *this;
+    }
+
+    bool LocalSocket::listen(char const* const path)
+    {
+        close();
+
+        sockaddr_un address;
+
+        if (!fillAddress(path, address))
+        {
+            return false;
+        }
+
+        SocketHandle const handle = createSocket();
+        m_handle = static_cast<long long>(handle);
+
+        if (!isValid())
+        {
+            return false;
+        }
+
+        // binding fails if the path exists, even when nothing is listening on it any more
+        remove(path);
+
+        bool const listening = bind(handle, reinterpret_cast<sockaddr const*>(&address), sizeof(address)) == 0 && ::listen(handle, SOMAXCONN) == 0;
+
+        if (!listening)
+        {
+            close();
+        }
+
+        return listening;
+    }
+
+    bool LocalSocket::connect(char const* const path)
+    {
+        close();
+
+        sockaddr_un address;
+
+        if (!fillAddress(path, address))
+        {
+            return false;
+        }
+
+        SocketHandle const handle = createSocket();
+        m_handle = static_cast<long long>(handle);
+
+        if (!isValid())
+        {
+            return false;
+        }
+
+        bool const connected = ::connect(handle, reinterpret_cast<sockaddr const*>(&address), sizeof(address)) == 0;
+
+        if (!connected)
+        {
+            close();
+        }
+
+        return connected;
+    }
+
+    LocalSocket LocalSocket::accept()
+    {
+        SocketHandle const client = ::accept(static_cast<SocketHandle>(m_handle), nullptr, nullptr);
+
+        return LocalSocket(static_cast<long long>(client));
+    }
+
+    bool LocalSocket::send(void const* data, size_t size)
+    {
+        char const* next = static_cast<char const*>(data);
+
+        while (size > 0 && isValid())
+        {
+            size_t const chunk = size < c_maximumTransfer ? size : c_maximumTransfer;
+
+            auto const sent = ::send(static_cast<SocketHandle>(m_handle), next, static_cast<TransferSize>(chunk), c_sendFlags);
+
+            if (sent <= 0)
+            {
+                return false;
+            }
+
+            next += sent;
+            size -= static_cast<size_t>(sent);
+        }
+
+        return size == 0;
+    }
+
+    bool LocalSocket::receive(void* data, size_t size)
+    {
+        char* next = static_cast<char*>(data);
+
+        while (size > 0 && isValid())
+        {
+            size_t const chunk = size < c_maximumTransfer ? size : c_maximumTransfer;
+
+            auto const received = recv(static_cast<SocketHandle>(m_handle), next, static_cast<TransferSize>(chunk), 0);
+
+            // 0 is the other end closing
+            if (received <= 0)
+            {
+                return false;
+            }
+
+            next += received;
+            size -= static_cast<size_t>(received);
+        }
+
+        return size == 0;
+    }
+
+    void LocalSocket::shutdown()
+    {
+        if (isValid())
+        {
+            ::shutdown(static_cast<SocketHandle>(m_handle), c_shutdownBoth);
+        }
+    }
+
+    void LocalSocket::close()
+    {
+        if (isValid())
+        {
+            closeHandle(static_cast<SocketHandle>(m_handle));
+            m_handle = c_invalidHandle;
+        }
+    }
+}
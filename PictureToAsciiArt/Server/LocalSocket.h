@@ -0,0 +1,50 @@
+#ifndef LOCALSOCKET_H
+#define LOCALSOCKET_H
+
+#include <stddef.h>
+
+namespace Server
+{
+    // a Unix domain stream socket, either listening on a path or connected to one. Windows has had AF_UNIX since
+    // Windows 10 1803, so it's the same socket everywhere and only the calls around it differ. Moves but doesn't copy
+    class LocalSocket
+    {
+    public:
+        LocalSocket();
+        ~LocalSocket();
+
+        LocalSocket(LocalSocket&& other);
+        LocalSocket& operator=(LocalSocket&& other);
+
+        LocalSocket(LocalSocket const&) = delete;
+        LocalSocket& operator=(LocalSocket const&) = delete;
+
+        // replaces anything left at the path by a server that didn't get to clean up after itself
+        bool listen(char const* const path);
+        bool connect(char const* const path);
+
+        // the next client to connect, or an invalid socket if accepting failed
+        LocalSocket accept();
+
+        // both only return true once every byte has gone or arrived. Receiving fails when the other end hangs up
+        bool send(void const* data, size_t size);
+        bool receive(void* data, size_t size);
+
+        // stops both directions without closing, so another thread blocked in receive wakes up and sees it fail
+        void shutdown();
+        void close();
+
+        inline bool isValid() const { return m_handle != c_invalidHandle; }
+
+    private:
+        explicit LocalSocket(long long handle);
+
+    private:
+        static long long const c_invalidHandle = -1;
+
+        // an int file descriptor, or a SOCKET on Windows, whose INVALID_SOCKET is ~0 so comes out as -1 here too
+        long long m_handle;
+    };
+}
+
+#endif // LOCALSOCKET_H
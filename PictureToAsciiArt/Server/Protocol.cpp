@@ -0,0 +1,178 @@
+#include "Protocol.h"
+
+#include "LocalSocket.h"
+
+namespace Server
+{
+    namespace
+    {
+        // the first byte of every header, bumped whenever the layout changes
+        unsigned char const c_protocolVersion = 1;
+
+        // the aspect goes over the wire in thousandths so the header stays integers
+        float const c_aspectScale = 1000.0f;
+
+        size_t const c_lengthSize = 4;
+
+        // little endian whatever the machine is
+        void packUnsigned(unsigned char* destination, unsigned long long value, size_t byteCount)
+        {
+            for (size_t i = 0; i < byteCount; ++i)
+            {
+                destination[i] = static_cast<unsigned char>(value >> (8 * i));
+            }
+        }
+
+        unsigned long long unpackUnsigned(unsigned char const* source, size_t byteCount)
+        {
+            unsigned long long value = 0;
+
+            for (size_t i = 0; i < byteCount; ++i)
+            {
+                value |= static_cast<unsigned long long>(source[i]) << (8 * i);
+            }
+
+            return value;
+        }
+    }
+
+    //////////////////////////////////////////////////////////////////////////
+    // Request header
+    // 0 version, 1 command, 2 dithering, 3 colour output, 4 shape matching, 5-7 zero,
+    // 8-11 target columns, 12-15 cell aspect in thousandths
+    //////////////////////////////////////////////////////////////////////////
+
+    void encodeRequestHeader(Request const& request, unsigned char (&header)[c_requestHeaderSize])
+    {
+        ConversionOptions const& options = request.options;
+
+        float const aspect = options.cellAspect > 0.0f ? options.cellAspect * c_aspectScale + 0.5f : 0.0f;
+
+        packUnsigned(header, 0, c_requestHeaderSize);
+
+        header[0] = c_protocolVersion;
+        header[1] = static_cast<unsigned char>(request.command);
+        header[2] = static_cast<unsigned char>(options.dithering);
+        header[3] = static_cast<unsigned char>(options.colourOutput);
+        header[4] = options.shapeMatching ? 1 : 0;
+
+        packUnsigned(header + 8, options.targetColumns, 4);
+        packUnsigned(header + 12, static_cast<unsigned int>(aspect), 4);
+    }
+
+    bool decodeRequest(std::vector<unsigned char> const& payload, Request& request)
+    {
+        if (payload.size() < c_requestHeaderSize || payload[0] != c_protocolVersion)
+        {
+            return false;
+        }
+
+        unsigned char const* header = payload.data();
+
+        if (header[1] > static_cast<unsigned char>(Command::Shutdown)
+            || header[2] > static_cast<unsigned char>(Dithering::FloydSteinberg)
+            || header[3] > static_cast<unsigned char>(ColourOutput::TrueColour)
+            || header[4] > 1)
+        {
+            return false;
+        }
+
+        request.command = static_cast<Command>(header[1]);
+        request.options.dithering = static_cast<Dithering>(header[2]);
+        request.options.colourOutput = static_cast<ColourOutput>(header[3]);
+        request.options.shapeMatching = header[4] != 0;
+        request.options.targetColumns = static_cast<unsigned int>(unpackUnsigned(header + 8, 4));
+        request.options.cellAspect = static_cast<float>(unpackUnsigned(header + 12, 4)) / c_aspectScale;
+
+        // downscaling divides by it
+        if (request.command != Command::Shutdown && request.options.cellAspect <= 0.0f)
+        {
+            return false;
+        }
+
+        request.body = header + c_requestHeaderSize;
+        request.bodySize = payload.size() - c_requestHeaderSize;
+
+        return true;
+    }
+
+    //////////////////////////////////////////////////////////////////////////
+    // Response header
+    // 0 version, 1 status, 2 file handling error, 3-7 zero, 8-15 server microseconds
+    //////////////////////////////////////////////////////////////////////////
+
+    void encodeResponseHeader(Response const& response, unsigned char (&header)[c_responseHeaderSize])
+    {
+        packUnsigned(header, 0, c_responseHeaderSize);
+
+        header[0] = c_protocolVersion;
+        header[1] = static_cast<unsigned char>(response.status);
+        header[2] = static_cast<unsigned char>(response.error);
+
+        packUnsigned(header + 8, response.serverMicroseconds, 8);
+    }
+
+    bool decodeResponse(std::vector<unsigned char> const& payload, Response& response)
+    {
+        if (payload.size() < c_responseHeaderSize || payload[0] != c_protocolVersion)
+        {
+            return false;
+        }
+
+        unsigned char const* header = payload.data();
+
+        if (header[1] > static_cast<unsigned char>(Status::ConversionFailed) || header[2] > static_cast<unsigned char>(Bitmap::FileHandlingErrors::OutOfMemory))
+        {
+            return false;
+        }
+
+        response.status = static_cast<Status>(header[1]);
+        response.error = static_cast<Bitmap::FileHandlingErrors>(header[2]);
+        response.serverMicroseconds = unpackUnsigned(header + 8, 8);
+
+        response.text = reinterpret_cast<char const*>(header + c_responseHeaderSize);
+        response.textSize = payload.size() - c_responseHeaderSize;
+
+        return true;
+    }
+
+    //////////////////////////////////////////////////////////////////////////
+    // Frames
+    //////////////////////////////////////////////////////////////////////////
+
+    bool sendFrame(LocalSocket& socket, unsigned char const* header, size_t headerSize, void const* body, size_t bodySize)
+    {
+        size_t const payloadSize = headerSize + bodySize;
+
+        if (payloadSize > c_maximumFrameSize)
+        {
+            return false;
+        }
+
+        unsigned char length[c_lengthSize];
+        packUnsigned(length, payloadSize, c_lengthSize);
+
+        return socket.send(length, c_lengthSize) && socket.send(header, headerSize) && (bodySize == 0 || socket.send(body, bodySize));
+    }
+
+    bool receiveFrame(LocalSocket& socket, std::vector<unsigned char>& payload)
+    {
+        unsigned char length[c_lengthSize];
+
+        if (!socket.receive(length, c_lengthSize))
+        {
+            return false;
+        }
+
+        size_t const payloadSize = static_cast<size_t>(unpackUnsigned(length, c_lengthSize));
+
+        if (payloadSize > c_maximumFrameSize)
+        {
+            return false;
+        }
+
+        payload.resize(payloadSize);
+
+        return payloadSize == 0 || socket.receive(payload.data(), payloadSize);
+    }
+}
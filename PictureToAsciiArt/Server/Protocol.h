@@ -0,0 +1,104 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <stddef.h>
+#include <vector>
+
+#include "../Bitmap/FileHandlingErrors.h"
+
+// forward declarations
+namespace Server
+{
+    class LocalSocket;
+}
+
+namespace Server
+{
+    // everything crossing the socket is a frame - a 32 bit little endian length then that many bytes. A request frame is
+    // a fixed size header then its body, the path to convert or a whole bitmap file. A response frame is a fixed size
+    // header then the converted text. Clients can send any number of requests down one connection, one at a time
+
+    enum class Command : unsigned char
+    {
+        ConvertFile         // the body is the path of a bitmap the server can open itself
+        , ConvertBitmap     // the body is a whole bitmap file, for clients with the image already in memory
+        , Shutdown          // the server finishes whatever's in flight, answers and exits
+    };
+
+    enum class Dithering : unsigned char
+    {
+        None
+        , Ordered
+        , FloydSteinberg
+    };
+
+    enum class ColourOutput : unsigned char
+    {
+        None
+        , Palette256
+        , TrueColour
+    };
+
+    struct ConversionOptions
+    {
+        Dithering dithering;
+        ColourOutput colourOutput;
+        bool shapeMatching;
+
+        // 0 converts every source pixel, as it does on the command line
+        unsigned int targetColumns;
+        float cellAspect;
+    };
+
+    struct Request
+    {
+        Command command;
+        ConversionOptions options;
+
+        // points into the frame the request was decoded from
+        unsigned char const* body;
+        size_t bodySize;
+    };
+
+    enum class Status : unsigned char
+    {
+        OK
+        , BadRequest            // the frame didn't decode, the connection is closed after answering
+        , ConversionFailed      // see the response's error
+    };
+
+    struct Response
+    {
+        Status status;
+        Bitmap::FileHandlingErrors error;
+
+        // from the request arriving to its response being ready, so it leaves out the time spent on the socket
+        unsigned long long serverMicroseconds;
+
+        // points into the frame the response was decoded from
+        char const* text;
+        size_t textSize;
+    };
+
+    // sized for a 16k x 16k bitmap, anything bigger is taken to be a broken or hostile client rather than allocated
+    size_t const c_maximumFrameSize = 1024u * 1024u * 1024u;
+
+    size_t const c_requestHeaderSize = 16;
+    size_t const c_responseHeaderSize = 16;
+
+    // writes the header only, the body follows it in the same frame
+    void encodeRequestHeader(Request const& request, unsigned char (&header)[c_requestHeaderSize]);
+    void encodeResponseHeader(Response const& response, unsigned char (&header)[c_responseHeaderSize]);
+
+    // false if the payload is too short, from another version or holds values out of range
+    bool decodeRequest(std::vector<unsigned char> const& payload, Request& request);
+    bool decodeResponse(std::vector<unsigned char> const& payload, Response& response);
+
+    // header and body go out as one frame without being copied together first
+    bool sendFrame(LocalSocket& socket, unsigned char const* header, size_t headerSize, void const* body, size_t bodySize);
+
+    // false on a closed connection or a frame over c_maximumFrameSize. The payload's capacity is kept between frames
+    bool receiveFrame(LocalSocket& socket, std::vector<unsigned char>& payload);
+}
+
+#endif // PROTOCOL_H
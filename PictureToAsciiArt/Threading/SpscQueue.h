@@ -0,0 +1,117 @@
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+#include <stddef.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+namespace Threading
+{
+    // a fixed size ring of values passed from exactly one producer thread to exactly one consumer thread. Each end only
+    // ever writes its own index, so neither push nor pop takes a lock. A full or empty queue is waited out by yielding and
+    // then napping, which suits stages that hand over a whole image at a time
+    template<typename TYPE>
+    class SpscQueue
+    {
+    public:
+        // rounded up to a power of two so the indices wrap with a mask
+        explicit SpscQueue(size_t capacity)
+            : m_head(0)
+            , m_tail(0)
+        {
+            size_t roundedCapacity = 1;
+
+            while (roundedCapacity < capacity)
+            {
+                roundedCapacity <<= 1;
+            }
+
+            m_values.resize(roundedCapacity);
+            m_mask = roundedCapacity - 1;
+        }
+
+        SpscQueue(SpscQueue const&) = delete;
+        SpscQueue& operator=(SpscQueue const&) = delete;
+
+        inline size_t getCapacity() const { return m_values.size(); }
+
+        // producer only. False if the queue is full
+        bool tryPush(TYPE const& value)
+        {
+            size_t const tail = m_tail.load(std::memory_order_relaxed);
+
+            if (tail - m_head.load(std::memory_order_acquire) == m_values.size())
+            {
+                return false;
+            }
+
+            m_values[tail & m_mask] = value;
+            m_tail.store(tail + 1, std::memory_order_release);
+
+            return true;
+        }
+
+        // consumer only. False if the queue is empty
+        bool tryPop(TYPE& value)
+        {
+            size_t const head = m_head.load(std::memory_order_relaxed);
+
+            if (head == m_tail.load(std::memory_order_acquire))
+            {
+                return false;
+            }
+
+            value = m_values[head & m_mask];
+            m_head.store(head + 1, std::memory_order_release);
+
+            return true;
+        }
+
+        // wait for room, or for a value
+        void push(TYPE const& value)
+        {
+            for (unsigned int attempt = 0; !tryPush(value); ++attempt)
+            {
+                backOff(attempt);
+            }
+        }
+
+        TYPE pop()
+        {
+            TYPE value;
+
+            for (unsigned int attempt = 0; !tryPop(value); ++attempt)
+            {
+                backOff(attempt);
+            }
+
+            return value;
+        }
+
+    private:
+        // the other end is usually only a moment away, unless it's waiting on the disk
+        static void backOff(unsigned int attempt)
+        {
+            if (attempt < 64)
+            {
+                std::this_thread::yield();
+            }
+            else
+            {
+                std::this_thread::sleep_for(std::chrono::microseconds(50));
+            }
+        }
+
+    private:
+        std::vector<TYPE> m_values;
+        size_t m_mask;
+
+        // each on a cache line of its own, so the two ends don't keep taking the line off each other
+        alignas(64) std::atomic<size_t> m_head;
+        alignas(64) std::atomic<size_t> m_tail;
+    };
+}
+
+#endif // SPSCQUEUE_H
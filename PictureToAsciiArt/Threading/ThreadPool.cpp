@@ -0,0 +1,82 @@
+#include "ThreadPool.h"
+
+namespace Threading
+{
+    ThreadPool::ThreadPool(unsigned int threadCount)
+        : m_stopping(false)
+    {
+        threadCount = resolveThreadCount(threadCount);
+
+        m_threads.reserve(threadCount);
+
+        for (unsigned int i = 0; i < threadCount; ++i)
+        {
+            m_threads.emplace_back(&ThreadPool::workerLoop, this);
+        }
+    }
+
+    ThreadPool::~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+
+        m_taskAvailable.notify_all();
+
+        // anything still queued is run before the workers exit
+        for (std::thread& thread : m_threads)
+        {
+            thread.join();
+        }
+    }
+
+    std::future<void> ThreadPool::submit(std::function<void()> task)
+    {
+        std::packaged_task<void()> packagedTask(std::move(task));
+        std::future<void> toReturn = packagedTask.get_future();
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_tasks.push_back(std::move(packagedTask));
+        }
+
+        m_taskAvailable.notify_one();
+
+        return toReturn;
+    }
+
+    unsigned int ThreadPool::resolveThreadCount(unsigned int threadCount)
+    {
+        if (threadCount == 0)
+        {
+            threadCount = std::thread::hardware_concurrency();
+        }
+
+        // hardware_concurrency is allowed to return 0 if it can't tell
+        return threadCount > 0 ? threadCount : 1;
+    }
+
+    void ThreadPool::workerLoop()
+    {
+        for (;;)
+        {
+            std::packaged_task<void()> task;
+
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_taskAvailable.wait(lock, [this]() { return m_stopping || !m_tasks.empty(); });
+
+                if (m_tasks.empty())
+                {
+                    return;
+                }
+
+                task = std::move(m_tasks.front());
+                m_tasks.pop_front();
+            }
+
+            task();
+        }
+    }
+}
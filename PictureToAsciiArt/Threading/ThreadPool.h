@@ -0,0 +1,45 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Threading
+{
+    // fixed set of worker threads pulling tasks off a single shared queue, in the order they were submitted
+    class ThreadPool
+    {
+    public:
+        // 0 threads means one per hardware thread
+        explicit ThreadPool(unsigned int threadCount);
+        ~ThreadPool();
+
+        ThreadPool(ThreadPool const&) = delete;
+        ThreadPool& operator=(ThreadPool const&) = delete;
+
+        inline unsigned int getThreadCount() const { return static_cast<unsigned int>(m_threads.size()); }
+
+        // the future becomes ready once the task has run
+        std::future<void> submit(std::function<void()> task);
+
+        static unsigned int resolveThreadCount(unsigned int threadCount);
+
+    private:
+        void workerLoop();
+
+    private:
+        std::vector<std::thread> m_threads;
+
+        std::mutex m_mutex;
+        std::condition_variable m_taskAvailable;
+        std::deque<std::packaged_task<void()>> m_tasks;
+        bool m_stopping;
+    };
+}
+
+#endif // THREADPOOL_H
@@ -0,0 +1,196 @@
+#include "WorkStealingPool.h"
+
+#include "ThreadPool.h"
+
+namespace
+{
+    // lets submit and runUntilComplete find the calling worker's own deque
+    thread_local Threading::WorkStealingPool const* t_currentPool = nullptr;
+    thread_local int t_workerIndex = -1;
+}
+
+namespace Threading
+{
+    WorkStealingPool::WorkStealingPool(unsigned int threadCount)
+        : m_nextQueue(0)
+        , m_queuedTasks(0)
+        , m_unfinishedTasks(0)
+        , m_stopping(false)
+    {
+        threadCount = ThreadPool::resolveThreadCount(threadCount);
+
+        for (unsigned int i = 0; i < threadCount; ++i)
+        {
+            m_queues.emplace_back(new WorkerQueue());
+        }
+
+        m_threads.reserve(threadCount);
+
+        for (unsigned int i = 0; i < threadCount; ++i)
+        {
+            m_threads.emplace_back(&WorkStealingPool::workerLoop, this, i);
+        }
+    }
+
+    WorkStealingPool::~WorkStealingPool()
+    {
+        waitForAll();
+
+        {
+            std::lock_guard<std::mutex> lock(m_sleepMutex);
+            m_stopping = true;
+        }
+
+        m_workAvailable.notify_all();
+
+        for (std::thread& thread : m_threads)
+        {
+            thread.join();
+        }
+    }
+
+    void WorkStealingPool::submit(Task task)
+    {
+        int const workerIndex = getCurrentWorkerIndex();
+
+        unsigned int const queueIndex = workerIndex >= 0 ? static_cast<unsigned int>(workerIndex) : m_nextQueue++ % m_queues.size();
+
+        m_unfinishedTasks++;
+
+        {
+            // counted before it's queued so the count never drops below the real number of queued tasks. Taken under the
+            // lock so a worker can't miss the wake up between checking the count and going to sleep
+            std::lock_guard<std::mutex> lock(m_sleepMutex);
+            m_queuedTasks++;
+        }
+
+        {
+            WorkerQueue& queue = *m_queues[queueIndex];
+
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.tasks.push_back(std::move(task));
+        }
+
+        m_workAvailable.notify_one();
+    }
+
+    void WorkStealingPool::waitForAll()
+    {
+        std::unique_lock<std::mutex> lock(m_sleepMutex);
+        m_allTasksFinished.wait(lock, [this]() { return m_unfinishedTasks == 0; });
+    }
+
+    void WorkStealingPool::runUntilComplete(std::atomic<unsigned int> const& remainingTasks)
+    {
+        int const workerIndex = getCurrentWorkerIndex();
+
+        while (remainingTasks > 0)
+        {
+            if (!tryRunTask(workerIndex))
+            {
+                // whatever is left is already running on another worker
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    void WorkStealingPool::workerLoop(unsigned int workerIndex)
+    {
+        t_currentPool = this;
+        t_workerIndex = static_cast<int>(workerIndex);
+
+        for (;;)
+        {
+            if (tryRunTask(t_workerIndex))
+            {
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(m_sleepMutex);
+            m_workAvailable.wait(lock, [this]() { return m_stopping || m_queuedTasks > 0; });
+
+            if (m_stopping && m_queuedTasks == 0)
+            {
+                return;
+            }
+        }
+    }
+
+    bool WorkStealingPool::tryRunTask(int workerIndex)
+    {
+        Task task;
+
+        bool const foundTask = (workerIndex >= 0 && tryPopOwnTask(static_cast<unsigned int>(workerIndex), task)) || tryStealTask(workerIndex, task);
+
+        if (foundTask)
+        {
+            m_queuedTasks--;
+
+            task();
+
+            if (--m_unfinishedTasks == 0)
+            {
+                std::lock_guard<std::mutex> lock(m_sleepMutex);
+                m_allTasksFinished.notify_all();
+            }
+        }
+
+        return foundTask;
+    }
+
+    bool WorkStealingPool::tryPopOwnTask(unsigned int workerIndex, Task& task)
+    {
+        WorkerQueue& queue = *m_queues[workerIndex];
+
+        std::lock_guard<std::mutex> lock(queue.mutex);
+
+        if (queue.tasks.empty())
+        {
+            return false;
+        }
+
+        // newest first
+        task = std::move(queue.tasks.back());
+        queue.tasks.pop_back();
+
+        return true;
+    }
+
+    bool WorkStealingPool::tryStealTask(int thiefIndex, Task& task)
+    {
+        unsigned int const queueCount = static_cast<unsigned int>(m_queues.size());
+
+        // start with the next worker along so thieves don't all pile onto the first deque
+        unsigned int const firstVictim = thiefIndex >= 0 ? static_cast<unsigned int>(thiefIndex) + 1 : 0;
+
+        for (unsigned int i = 0; i < queueCount; ++i)
+        {
+            unsigned int const victimIndex = (firstVictim + i) % queueCount;
+
+            if (static_cast<int>(victimIndex) == thiefIndex)
+            {
+                continue;
+            }
+
+            WorkerQueue& queue = *m_queues[victimIndex];
+
+            std::lock_guard<std::mutex> lock(queue.mutex);
+
+            if (!queue.tasks.empty())
+            {
+                // oldest first - for a task that split itself up, that's the biggest remaining piece
+                task = std::move(queue.tasks.front());
+                queue.tasks.pop_front();
+
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    int WorkStealingPool::getCurrentWorkerIndex() const
+    {
+        return t_currentPool == this ? t_workerIndex : -1;
+    }
+}
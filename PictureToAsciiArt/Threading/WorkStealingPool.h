@@ -0,0 +1,74 @@
+#ifndef WORKSTEALINGPOOL_H
+#define WORKSTEALINGPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Threading
+{
+    // every worker owns a deque of tasks. Tasks submitted from a worker go on its own deque and are run newest first,
+    // which keeps a task's children hot in cache. An idle worker steals the oldest task from someone else's deque, so
+    // a few big jobs that split themselves up get spread over every core without a single contended queue
+    class WorkStealingPool
+    {
+    public:
+        using Task = std::function<void()>;
+
+        // 0 threads means one per hardware thread
+        explicit WorkStealingPool(unsigned int threadCount);
+        ~WorkStealingPool();
+
+        WorkStealingPool(WorkStealingPool const&) = delete;
+        WorkStealingPool& operator=(WorkStealingPool const&) = delete;
+
+        inline unsigned int getThreadCount() const { return static_cast<unsigned int>(m_threads.size()); }
+
+        // from a worker the task goes on that worker's deque, from anywhere else the deques are filled round robin
+        void submit(Task task);
+
+        // blocks until every submitted task, including ones submitted by other tasks, has finished. Call from outside the pool
+        void waitForAll();
+
+        // for a task waiting on tasks it submitted itself. Runs other work until remainingTasks drops to zero rather than
+        // blocking the worker
+        void runUntilComplete(std::atomic<unsigned int> const& remainingTasks);
+
+    private:
+        struct WorkerQueue
+        {
+            std::mutex mutex;
+            std::deque<Task> tasks;
+        };
+
+        void workerLoop(unsigned int workerIndex);
+
+        bool tryRunTask(int workerIndex);
+        bool tryPopOwnTask(unsigned int workerIndex, Task& task);
+        bool tryStealTask(int thiefIndex, Task& task);
+
+        int getCurrentWorkerIndex() const;
+
+    private:
+        std::vector<std::unique_ptr<WorkerQueue>> m_queues;
+        std::vector<std::thread> m_threads;
+
+        std::atomic<unsigned int> m_nextQueue;
+
+        // tasks sitting in a deque, and tasks that haven't finished running yet
+        std::atomic<size_t> m_queuedTasks;
+        std::atomic<size_t> m_unfinishedTasks;
+
+        std::mutex m_sleepMutex;
+        std::condition_variable m_workAvailable;
+        std::condition_variable m_allTasksFinished;
+        bool m_stopping;
+    };
+}
+
+#endif // WORKSTEALINGPOOL_H
@@ -1,77 +1,1114 @@
 #include <stdio.h>
 
-#include "Bitmap/ImageFile.h"
+#include "Bitmap/AreaDownscaler.h"
+#include "Bitmap/CanvasPool.h"
 #include "Bitmap/ImageCanvas.h"
-#include "Bitmap/Colour.h"
+#include "Bitmap/ImageFile.h"
+#include "Bitmap/ImageRegion.h"
+#include "Bitmap/ImageRotator.h"
+#include "Bitmap/ImageView.h"
+#include "Bitmap/LoadedImage.h"
+#include "Bitmap/PlaneView.h"
+#include "Bitmap/ScanlineReader.h"
+#include "Ascii/AnsiColourConverter.h"
+#include "Ascii/ErrorDiffusionConverter.h"
+#include "Ascii/FrameSequenceWriter.h"
+#include "Ascii/GlyphAtlas.h"
+#include "Ascii/GlyphRamp.h"
+#include "Ascii/GlyphRowKernel.h"
+#include "Ascii/OutputWriter.h"
+#include "Ascii/PaletteGlyphTable.h"
+#include "Ascii/ParallelConverter.h"
+#include "Ascii/ShapeMatchConverter.h"
+#include "Batch/BatchConverter.h"
+#include "Cache/ContentHasher.h"
+#include "Cache/ResultCache.h"
+#include "Instrumentation/StageMetrics.h"
+#include "Server/ConversionClient.h"
+#include "Server/ConversionServer.h"
+#include "Threading/ThreadPool.h"
+#include "Threading/WorkStealingPool.h"
+#include <stdlib.h>
 #include <string.h>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+// every pixel is written out as two characters to roughly make up for glyphs being twice as tall as they are wide
+unsigned int const c_charactersPerPixel = 2;
+
+// glyphs are roughly twice as tall as they are wide
+float const c_defaultCellAspect = 2.0f;
+
+// what's done to an image before it's converted, in this order. A crop is done by only reading that part of the file,
+// a flip is only a different view of the same pixels and a rotation is copied through a transpose
+struct Orientation
+{
+    Bitmap::ImageRegion crop;
+
+    bool flipVertically;
+    Bitmap::ImageRotator::Rotation rotation;
+
+    inline bool isIdentity() const { return crop.isWholeImage() && !flipVertically && rotation == Bitmap::ImageRotator::Rotation::None; }
+};
+
+struct ConversionSettings
+{
+    Ascii::GlyphRowKernel const* kernel;
+
+    // null when running on a single thread
+    Ascii::ParallelConverter* parallelConverter;
+
+    // null for plain text. Coloured lines vary in length, so they're always converted on the calling thread
+    Ascii::AnsiColourConverter const* colourConverter;
+
+    // null unless dithering with error diffusion, which needs the rows in order so it's on the calling thread too
+    Ascii::ErrorDiffusionConverter* errorDiffusion;
+
+    // null unless picking glyphs by shape, which takes over from the ramp and everything built on it
+    Ascii::ShapeMatchConverter const* shapeConverter;
+
+    // shared by every image so its buffer is only allocated once
+    Ascii::OutputWriter* writer;
+
+    // 0 writes out every source pixel, otherwise images are box filtered down to this many columns first
+    unsigned int targetColumns;
+    float cellAspect;
+
+    // every canvas comes from here so its buffer is reused by the next image
+    Bitmap::CanvasPool* canvasPool;
+
+    // null unless the stages are being timed
+    Instrumentation::MetricsReport* metricsReport;
+
+    // null unless converted text is being cached
+    Cache::ResultCache* resultCache;
+
+    Orientation orientation;
+};
+
+// an ImageView or a PlaneView, the flip doesn't copy anything
+template<typename VIEW>
+VIEW flipIfAsked(Orientation const& orientation, VIEW const& image)
+{
+    return orientation.flipVertically ? image.flippedVertically() : image;
+}
+
+// the image has already been cropped as it was read. rotated holds the pixels when there's a rotation, otherwise it
+// isn't touched
+Bitmap::ImageView orientImage(Orientation const& orientation, Bitmap::ImageView const& image, Bitmap::ImageCanvas& rotated)
+{
+    return Bitmap::ImageRotator::rotate(flipIfAsked(orientation, image), orientation.rotation, rotated);
+}
+
+// sizes the downscaled canvas for the image and reports it
+void beginDownscale(ConversionSettings const& settings, unsigned int sourceWidth, unsigned int sourceHeight, Bitmap::AreaDownscaler& downscaler, Bitmap::ImageCanvas& downscaled)
+{
+    unsigned int targetWidth = 0;
+    unsigned int targetHeight = 0;
+
+    if (settings.shapeConverter)
+    {
+        Ascii::ShapeMatchConverter::calculateTargetSize(sourceWidth, sourceHeight, settings.targetColumns, settings.cellAspect, targetWidth, targetHeight);
+    }
+    else
+    {
+        Bitmap::AreaDownscaler::calculateTargetSize(sourceWidth, sourceHeight, settings.targetColumns, settings.kernel->getCharactersPerPixel(), settings.cellAspect, targetWidth, targetHeight);
+    }
+
+    downscaler.begin(sourceWidth, sourceHeight, targetWidth, targetHeight, downscaled);
+
+    printf("Downscaling to %u x %u\n", downscaled.getWidth(), downscaled.getHeight());
+}
+
+// an ImageView or a luma PlaneView
+template<typename VIEW>
+void writeAsciiArt(ConversionSettings const& settings, VIEW const& image)
+{
+    if (settings.shapeConverter)
+    {
+        settings.shapeConverter->writeLines(image, 0, image.getHeight(), *settings.writer);
+    }
+    else if (settings.colourConverter)
+    {
+        settings.colourConverter->writeLines(image, 0, image.getHeight(), *settings.writer);
+    }
+    else if (settings.errorDiffusion)
+    {
+        settings.errorDiffusion->writeLines(image, 0, image.getHeight(), *settings.writer);
+    }
+    else if (settings.parallelConverter)
+    {
+        settings.parallelConverter->convert(image, *settings.writer);
+    }
+    else
+    {
+        settings.writer->writeLines(*settings.kernel, image, 0, image.getHeight());
+    }
+}
+
+// true if the output was written
+bool reportWriteResult(char const* const outputFileName, Bitmap::FileHandlingErrors error)
+{
+    if (error != Bitmap::FileHandlingErrors::OK)
+    {
+        printf("Failed to write \"%s\": %s\n", outputFileName, Bitmap::getFileHandlingErrorName(error));
+    }
+
+    return error == Bitmap::FileHandlingErrors::OK;
+}
+
+enum class ImageSource
+{
+    LoadedCanvas        // ImageFile::load into an ImageCanvas
+    , MappedFile        // MappedImageFile, read in place
+    , StreamedScanlines // ScanlineReader, a block of rows at a time
+    , LumaCanvas        // ImageFile::load straight into a luma plane
+};
 
-void pixelToAscii(char const* const sourceFileName, char const* const outputFileName)
+bool lumaPixelsToAscii(ConversionSettings const& settings, char const* const sourceFileName, char const* const outputFileName)
 {
-    Bitmap::ImageCanvas myCanvas(2, 2);
-    Bitmap::ImageFile myFile;
+    bool written = false;
 
-    Bitmap::FileHandlingErrors error = myFile.load(sourceFileName, myCanvas);
+    // only the brightness survives loading, so a third of the memory of a colour canvas
+    Bitmap::PooledCanvas pooledCanvas(*settings.canvasPool);
+
+    Bitmap::ImageCanvas& canvas = pooledCanvas.get();
+    canvas.resize(0, 0, Bitmap::ImageCanvas::StorageMode::Luma);
+
+    Bitmap::ImageFile imageFile;
+    Bitmap::FileHandlingErrors error = imageFile.load(sourceFileName, settings.orientation.crop, canvas);
+
+    if (error == Bitmap::FileHandlingErrors::OK)
+    {
+        printf("Successfully read \"%s\". Image size: %d x %d\n", sourceFileName, canvas.getWidth(), canvas.getHeight());
+
+        if (settings.targetColumns > 0)
+        {
+            printf("Downscaling needs the colour channels, converting at full size\n");
+        }
+
+        if (settings.orientation.rotation != Bitmap::ImageRotator::Rotation::None)
+        {
+            printf("Rotating needs the colour channels, converting unrotated\n");
+        }
+
+        Bitmap::FileHandlingErrors writeError = settings.writer->open(outputFileName);
+
+        if (writeError == Bitmap::FileHandlingErrors::OK)
+        {
+            writeAsciiArt(settings, flipIfAsked(settings.orientation, canvas.getTopDownPlaneView(Bitmap::ImageCanvas::Plane::Luma)));
+
+            writeError = settings.writer->close();
+        }
+
+        written = reportWriteResult(outputFileName, writeError);
+    }
+    else
+    {
+        printf("Failed to read \"%s\": %s\n", sourceFileName, Bitmap::getFileHandlingErrorName(error));
+    }
+
+    return written;
+}
+
+// palettised bitmaps keep their indices and go through a glyph per palette entry, anything else is loaded as colours
+bool indexedPixelsToAscii(ConversionSettings const& settings, char const* const sourceFileName, char const* const outputFileName)
+{
+    bool written = false;
+
+    // a byte per pixel rather than three, and nothing is expanded through the palette
+    Bitmap::PooledCanvas pooledCanvas(*settings.canvasPool);
+
+    Bitmap::ImageCanvas& canvas = pooledCanvas.get();
+    canvas.resize(0, 0, Bitmap::ImageCanvas::StorageMode::Indexed);
+
+    Bitmap::ImageFile imageFile;
+    Bitmap::FileHandlingErrors error = imageFile.load(sourceFileName, settings.orientation.crop, canvas);
+
+    if (error == Bitmap::FileHandlingErrors::OK)
+    {
+        printf("Successfully read \"%s\". Image size: %d x %d\n", sourceFileName, canvas.getWidth(), canvas.getHeight());
+
+        Bitmap::FileHandlingErrors writeError = settings.writer->open(outputFileName);
+
+        if (writeError == Bitmap::FileHandlingErrors::OK)
+        {
+            if (canvas.getStorageMode() == Bitmap::ImageCanvas::StorageMode::Indexed)
+            {
+                Ascii::PaletteGlyphTable glyphTable(settings.kernel->getRamp(), settings.kernel->getCharactersPerPixel());
+                glyphTable.build(canvas.getPalette(), canvas.getPaletteSize());
+
+                Bitmap::PlaneView const indices = flipIfAsked(settings.orientation, canvas.getTopDownPlaneView(Bitmap::ImageCanvas::Plane::Index));
+                glyphTable.writeLines(indices, 0, indices.getHeight(), *settings.writer);
+            }
+            else
+            {
+                writeAsciiArt(settings, flipIfAsked(settings.orientation, canvas.getTopDownView()));
+            }
+
+            writeError = settings.writer->close();
+        }
+
+        written = reportWriteResult(outputFileName, writeError);
+    }
+    else
+    {
+        printf("Failed to read \"%s\": %s\n", sourceFileName, Bitmap::getFileHandlingErrorName(error));
+    }
+
+    return written;
+}
+
+bool streamPixelsToAscii(ConversionSettings const& settings, char const* const sourceFileName, char const* const outputFileName)
+{
+    bool written = false;
+
+    Bitmap::ScanlineReader reader;
+
+    Bitmap::FileHandlingErrors error = reader.open(sourceFileName, settings.orientation.crop);
 
     bool shouldContinue = error == Bitmap::FileHandlingErrors::OK;
 
     if (shouldContinue)
     {
-        printf("Successfully read \"%s\". Image size: %d x %d\n", sourceFileName, myCanvas.getWidth(), myCanvas.getHeight());
-
-        unsigned int const width = myCanvas.getWidth();
-        unsigned int const height = myCanvas.getHeight();
+        printf("Successfully opened \"%s\". Image size: %d x %d\n", sourceFileName, reader.getWidth(), reader.getHeight());
 
-        char const* const mappingString = "`^\",:;Il!i~+_-?][}{1)(|\\/tfjrxnuvczXYUJCLQ0OZmwqpdbkhao*#MW&8%B@$";
-        unsigned int const lengthOfString = strlen(mappingString);
+        if (settings.orientation.flipVertically || settings.orientation.rotation != Bitmap::ImageRotator::Rotation::None)
+        {
+            printf("Flipping and rotating need the whole image, converting the right way up\n");
+        }
 
-        FILE* outputFile = nullptr;
-        errno_t fileError = fopen_s(&outputFile, outputFileName, "w");
+        Bitmap::FileHandlingErrors writeError = settings.writer->open(outputFileName);
 
-        if (outputFile && fileError == 0)
+        if (writeError == Bitmap::FileHandlingErrors::OK)
         {
+            // when downscaling, blocks are folded into the downscaled canvas as they arrive and it's written at the end
+            Bitmap::AreaDownscaler downscaler;
+            Bitmap::PooledCanvas downscaled(*settings.canvasPool);
 
+            if (settings.targetColumns > 0)
+            {
+                beginDownscale(settings, reader.getWidth(), reader.getHeight(), downscaler, downscaled.get());
+            }
 
-            for (unsigned y = 0; y < height; ++y)
-                //for (unsigned x = width - 1; x >= 0 && x < width; --x)
+            // each block of rows is converted before the next one is read
+            while (reader.hasMoreRows() && error == Bitmap::FileHandlingErrors::OK)
             {
-                for (unsigned x = 0; x < width; ++x)
-                    //for (unsigned y = height - 1; y >= 0 && y < height; --y)
+                Bitmap::ImageView rows;
+                error = reader.readNextRows(rows);
+
+                if (error == Bitmap::FileHandlingErrors::OK)
                 {
-                    Bitmap::Colour const& pixel = myCanvas.getPixel(x, y);
+                    if (settings.targetColumns > 0)
+                    {
+                        downscaler.addRows(rows);
+                    }
+                    else
+                    {
+                        writeAsciiArt(settings, rows);
+                    }
+                }
+            }
 
-                    float const greyscaleAverage = (static_cast<float>(pixel.blue) + static_cast<float>(pixel.green) + static_cast<float>(pixel.red)) / 3.0f;
+            if (settings.targetColumns > 0 && error == Bitmap::FileHandlingErrors::OK)
+            {
+                writeAsciiArt(settings, downscaled.get().getTopDownView());
+            }
+
+            writeError = settings.writer->close();
+        }
+
+        // a read failing part way leaves a partial output, which doesn't count
+        written = reportWriteResult(outputFileName, writeError) && error == Bitmap::FileHandlingErrors::OK;
+    }
+    else
+    {
+        printf("Failed to read \"%s\": %s\n", sourceFileName, Bitmap::getFileHandlingErrorName(error));
+    }
+
+    return written;
+}
+
+// true if the whole image was converted and written
+bool pixelToAscii(ConversionSettings const& settings, char const* const sourceFileName, char const* const outputFileName, ImageSource imageSource)
+{
+    if (imageSource == ImageSource::StreamedScanlines)
+    {
+        return streamPixelsToAscii(settings, sourceFileName, outputFileName);
+    }
+
+    if (imageSource == ImageSource::LumaCanvas)
+    {
+        return lumaPixelsToAscii(settings, sourceFileName, outputFileName);
+    }
+
+    // the palette fast path only covers the plain mapping at full size and unrotated, everything else needs the colours
+    bool const plainMapping = !settings.shapeConverter && !settings.colourConverter && !settings.errorDiffusion && settings.kernel->getDithering() == Ascii::GlyphRowKernel::Dithering::None;
+    bool const unrotated = settings.orientation.rotation == Bitmap::ImageRotator::Rotation::None;
+
+    if (imageSource == ImageSource::LoadedCanvas && plainMapping && unrotated && settings.targetColumns == 0)
+    {
+        return indexedPixelsToAscii(settings, sourceFileName, outputFileName);
+    }
+
+    bool written = false;
+
+    Bitmap::LoadedImage::Method const loadMethod = imageSource == ImageSource::MappedFile ? Bitmap::LoadedImage::Method::MapFile : Bitmap::LoadedImage::Method::LoadIntoCanvas;
+
+    Bitmap::LoadedImage loadedImage(*settings.canvasPool);
+    Bitmap::FileHandlingErrors error = loadedImage.open(sourceFileName, loadMethod, settings.orientation.crop);
+
+    Bitmap::ImageView const& loadedView = loadedImage.getView();
+
+    bool shouldContinue = error == Bitmap::FileHandlingErrors::OK;
+
+    if (shouldContinue)
+    {
+        printf("Successfully read \"%s\". Image size: %d x %d\n", sourceFileName, loadedView.getWidth(), loadedView.getHeight());
+
+        Bitmap::PooledCanvas rotated(*settings.canvasPool);
+        Bitmap::ImageView const image = orientImage(settings.orientation, loadedView, rotated.get());
+
+        if (!settings.orientation.isIdentity())
+        {
+            printf("Oriented image size: %u x %u\n", image.getWidth(), image.getHeight());
+        }
+
+        Bitmap::FileHandlingErrors writeError = settings.writer->open(outputFileName);
+
+        if (writeError == Bitmap::FileHandlingErrors::OK)
+        {
+            if (settings.targetColumns > 0)
+            {
+                Bitmap::AreaDownscaler downscaler;
+                Bitmap::PooledCanvas downscaled(*settings.canvasPool);
+
+                beginDownscale(settings, image.getWidth(), image.getHeight(), downscaler, downscaled.get());
+                downscaler.addRows(image);
+
+                writeAsciiArt(settings, downscaled.get().getTopDownView());
+            }
+            else
+            {
+                writeAsciiArt(settings, image);
+            }
+
+            writeError = settings.writer->close();
+        }
+
+        written = reportWriteResult(outputFileName, writeError);
+    }
+    else
+    {
+        printf("Failed to read \"%s\": %s\n", sourceFileName, Bitmap::getFileHandlingErrorName(error));
+    }
+
+    return written;
+}
+
+// the stages of the image are timed into metrics of its own, which go into the report once it's done
+// true if the output was written or copied from the cache
+bool convertImage(ConversionSettings const& settings, char const* const sourceFileName, char const* const outputFileName, ImageSource imageSource)
+{
+    Instrumentation::StageMetrics metrics;
+
+    bool converted = false;
+
+    // error from the last image mustn't leak into this one. Streamed blocks all carry on from each other
+    if (settings.errorDiffusion)
+    {
+        settings.errorDiffusion->begin();
+    }
+
+    {
+        Instrumentation::ImageScope imageScope(settings.metricsReport ? &metrics : nullptr);
+
+        std::string cacheKey;
+
+        if (settings.resultCache && settings.resultCache->fetch(sourceFileName, outputFileName, cacheKey))
+        {
+            printf("Copied \"%s\" from the cache\n", outputFileName);
+            converted = true;
+        }
+        else
+        {
+            converted = pixelToAscii(settings, sourceFileName, outputFileName, imageSource);
+
+            if (converted && settings.resultCache)
+            {
+                settings.resultCache->store(cacheKey, outputFileName);
+            }
+        }
+    }
+
+    if (settings.metricsReport)
+    {
+        settings.metricsReport->addImage(sourceFileName, metrics);
+    }
+
+    return converted;
+}
+
+void closeMetricsReport(Instrumentation::MetricsReport* metricsReport, char const* const metricsFileName, std::chrono::steady_clock::time_point startTime)
+{
+    if (metricsReport)
+    {
+        double const elapsedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+        if (!metricsReport->close(elapsedSeconds))
+        {
+            printf("Failed to write the metrics to \"%s\"\n", metricsFileName);
+        }
+    }
+}
+
+// plays a sequence of frames as ANSI art, redrawing only what changed since the frame before. Frames go in file name
+// order, so number them with leading zeros. The frames go to stdout unless there's an output file, so everything
+// else is reported on stderr
+int runSequence(ConversionSettings const& settings, ImageSource imageSource, char const* const frameInput, char const* const outputFileName)
+{
+    std::vector<Batch::BatchItem> frames;
 
-                    float const mappedIndex = (greyscaleAverage / 255.0f) * static_cast<float>(lengthOfString - 1); // -1 off the length of the string as the mapping is inclusive of the limit
+    if (!Batch::BatchConverter::collectItems(frameInput, nullptr, frames))
+    {
+        fprintf(stderr, "Couldn't read the frame sequence \"%s\"\n", frameInput);
+        return 1;
+    }
+
+    Bitmap::FileHandlingErrors error = outputFileName ? settings.writer->open(outputFileName) : settings.writer->openStandardOutput();
+
+    if (error != Bitmap::FileHandlingErrors::OK)
+    {
+        fprintf(stderr, "Failed to open \"%s\": %s\n", outputFileName, Bitmap::getFileHandlingErrorName(error));
+        return 1;
+    }
+
+    Bitmap::LoadedImage::Method const loadMethod = imageSource == ImageSource::MappedFile ? Bitmap::LoadedImage::Method::MapFile : Bitmap::LoadedImage::Method::LoadIntoCanvas;
+
+    Ascii::FrameSequenceWriter sequenceWriter(*settings.kernel);
+    sequenceWriter.begin(*settings.writer);
+
+    Bitmap::AreaDownscaler downscaler;
+    unsigned int failedCount = 0;
+
+    for (Batch::BatchItem const& frame : frames)
+    {
+        Instrumentation::StageMetrics metrics;
+
+        {
+            Instrumentation::ImageScope imageScope(settings.metricsReport ? &metrics : nullptr);
+
+            Bitmap::LoadedImage loadedImage(*settings.canvasPool);
+            error = loadedImage.open(frame.sourceFileName.c_str(), loadMethod, settings.orientation.crop);
 
-                    unsigned char mappedIndexInteger = static_cast<unsigned char>(mappedIndex);
+            if (error == Bitmap::FileHandlingErrors::OK)
+            {
+                Bitmap::PooledCanvas rotated(*settings.canvasPool);
+                Bitmap::ImageView view = orientImage(settings.orientation, loadedImage.getView(), rotated.get());
+                Bitmap::PooledCanvas downscaled(*settings.canvasPool);
+
+                if (settings.targetColumns > 0)
+                {
+                    unsigned int targetWidth = 0;
+                    unsigned int targetHeight = 0;
+
+                    Bitmap::AreaDownscaler::calculateTargetSize(view.getWidth(), view.getHeight(), settings.targetColumns, settings.kernel->getCharactersPerPixel(), settings.cellAspect, targetWidth, targetHeight);
 
-                    fwrite(&mappingString[mappedIndexInteger], sizeof(char), 1, outputFile);
-                    fwrite(&mappingString[mappedIndexInteger], sizeof(char), 1, outputFile);
+                    downscaler.downscale(view, targetWidth, targetHeight, downscaled.get());
+                    view = downscaled.get().getTopDownView();
                 }
 
-                fwrite("\n", sizeof(char), 1, outputFile);
+                sequenceWriter.writeFrame(view, *settings.writer);
             }
+            else
+            {
+                // the last good frame stays up
+                fprintf(stderr, "Failed to read \"%s\": %s\n", frame.sourceFileName.c_str(), Bitmap::getFileHandlingErrorName(error));
+                ++failedCount;
+            }
+        }
+
+        if (settings.metricsReport)
+        {
+            settings.metricsReport->addImage(frame.sourceFileName.c_str(), metrics);
+        }
+    }
+
+    sequenceWriter.end(*settings.writer);
+
+    error = settings.writer->close();
+
+    if (error != Bitmap::FileHandlingErrors::OK)
+    {
+        fprintf(stderr, "Failed to write the frames: %s\n", Bitmap::getFileHandlingErrorName(error));
+        return 1;
+    }
+
+    unsigned long long const fullRedrawBytes = sequenceWriter.getFullRedrawBytes();
+
+    fprintf(stderr, "Played %u frames in %llu bytes, %.1f%% of redrawing every frame in full\n"
+        , sequenceWriter.getFrameCount()
+        , sequenceWriter.getBytesWritten()
+        , fullRedrawBytes > 0 ? 100.0 * sequenceWriter.getBytesWritten() / fullRedrawBytes : 0.0);
+
+    return failedCount == 0 ? 0 : 1;
+}
+
+int runBatch(Ascii::GlyphRowKernel const& kernel, ImageSource imageSource, unsigned int threadCount, unsigned int targetColumns, float cellAspect, bool pipelined, char const* const batchInput, char const* const outputDirectory, Instrumentation::MetricsReport* metricsReport, Cache::ResultCache* resultCache)
+{
+    std::vector<Batch::BatchItem> items;
 
-            fclose(outputFile);
+    if (!Batch::BatchConverter::collectItems(batchInput, outputDirectory, items))
+    {
+        printf("Couldn't read the batch input \"%s\"\n", batchInput);
+        return 1;
+    }
+
+    // batches always convert whole colour images, streaming and luma loading are for one image at a time
+    Bitmap::LoadedImage::Method const loadMethod = imageSource == ImageSource::MappedFile ? Bitmap::LoadedImage::Method::MapFile : Bitmap::LoadedImage::Method::LoadIntoCanvas;
+
+    Threading::WorkStealingPool workerPool(threadCount);
+    Batch::BatchConverter batchConverter(kernel, loadMethod, targetColumns, cellAspect, workerPool);
+    batchConverter.setResultCache(resultCache);
+
+    unsigned int const failedCount = pipelined ? batchConverter.runPipelined(items, metricsReport) : batchConverter.run(items, metricsReport);
+
+    return failedCount == 0 ? 0 : 1;
+}
+
+// everything other than the pixels that changes the text, for the cache keys. colourMode is -1 for plain text. Bump the
+// version whenever a conversion starts writing something different
+unsigned long long hashOutputSettings(Ascii::GlyphRowKernel const& kernel, bool luma, bool errorDiffusion, int colourMode, bool shapeMatching, unsigned int targetColumns, float cellAspect, Orientation const& orientation)
+{
+    Ascii::GlyphRamp const& ramp = kernel.getRamp();
+
+    char description[256];
+
+    snprintf(description, sizeof(description), "v1 characters=%u luma=%d dithering=%d diffusion=%d colour=%d shapes=%d columns=%u aspect=%.4f crop=%u,%u,%u,%u flip=%d rotation=%d ramp="
+        , kernel.getCharactersPerPixel()
+        , luma ? 1 : 0
+        , static_cast<int>(kernel.getDithering())
+        , errorDiffusion ? 1 : 0
+        , colourMode
+        , shapeMatching ? 1 : 0
+        , targetColumns
+        , cellAspect
+        , orientation.crop.isWholeImage() ? 0 : orientation.crop.x
+        , orientation.crop.isWholeImage() ? 0 : orientation.crop.y
+        , orientation.crop.isWholeImage() ? 0 : orientation.crop.width
+        , orientation.crop.isWholeImage() ? 0 : orientation.crop.height
+        , orientation.flipVertically ? 1 : 0
+        , static_cast<int>(orientation.rotation));
+
+    Cache::ContentHasher hasher;
+    hasher.update(description, strlen(description));
+    hasher.update(ramp.getGlyphs(), ramp.getGlyphCount());
+
+    return hasher.getDigest();
+}
+
+void reportResultCache(Cache::ResultCache const* resultCache)
+{
+    if (resultCache)
+    {
+        printf("Cache: %llu hits, %llu misses, %llu entries evicted\n", resultCache->getHitCount(), resultCache->getMissCount(), resultCache->getEvictionCount());
+    }
+}
+
+// sends the image to a server started with --serve and writes out the text that comes back. Repeats go down the same
+// connection, to see what a warm server costs per request. The text goes to stdout unless there's an output file, so
+// everything else is reported on stderr
+int runClient(char const* const socketPath, Server::Command command, Server::ConversionOptions const& options, unsigned int repeatCount, char const* const sourceFileName, char const* const outputFileName)
+{
+    FILE* const log = outputFileName ? stdout : stderr;
+
+    if (command != Server::Command::Shutdown && sourceFileName == nullptr)
+    {
+        fprintf(log, "Nothing to convert, give the client a source file\n");
+        return 1;
+    }
+
+    std::vector<unsigned char> body;
+
+    if (command == Server::Command::ConvertBitmap)
+    {
+        std::ifstream source(sourceFileName, std::ios::binary);
+
+        if (!source)
+        {
+            fprintf(log, "Failed to read \"%s\"\n", sourceFileName);
+            return 1;
         }
+
+        body.assign(std::istreambuf_iterator<char>(source), std::istreambuf_iterator<char>());
+    }
+    else if (command == Server::Command::ConvertFile)
+    {
+        // the server opens the file itself, from wherever it was started
+        std::string const path = std::filesystem::absolute(sourceFileName).string();
+        body.assign(path.begin(), path.end());
+    }
+
+    Server::ConversionClient client;
+
+    if (!client.connect(socketPath))
+    {
+        fprintf(log, "Couldn't connect to \"%s\"\n", socketPath);
+        return 1;
     }
+
+    Server::Request const request = { command, options, body.data(), body.size() };
+    Server::Response response = {};
+
+    double totalMilliseconds = 0.0;
+    double fastestMilliseconds = 0.0;
+    unsigned long long totalServerMicroseconds = 0;
+
+    repeatCount = repeatCount > 0 ? repeatCount : 1;
+
+    for (unsigned int i = 0; i < repeatCount; ++i)
+    {
+        std::chrono::steady_clock::time_point const startTime = std::chrono::steady_clock::now();
+
+        if (!client.send(request, response))
+        {
+            fprintf(log, "Lost the connection to \"%s\"\n", socketPath);
+            return 1;
+        }
+
+        double const milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+
+        totalMilliseconds += milliseconds;
+        fastestMilliseconds = i == 0 || milliseconds < fastestMilliseconds ? milliseconds : fastestMilliseconds;
+        totalServerMicroseconds += response.serverMicroseconds;
+
+        if (response.status != Server::Status::OK || command == Server::Command::Shutdown)
+        {
+            break;
+        }
+    }
+
+    if (response.status == Server::Status::BadRequest)
+    {
+        fprintf(log, "The server didn't understand the request\n");
+        return 1;
+    }
+
+    if (response.status == Server::Status::ConversionFailed)
+    {
+        fprintf(log, "The server failed to convert \"%s\": %s\n", sourceFileName, Bitmap::getFileHandlingErrorName(response.error));
+        return 1;
+    }
+
+    if (command == Server::Command::Shutdown)
+    {
+        fprintf(log, "The server is shutting down\n");
+        return 0;
+    }
+
+    fprintf(log, "%u requests: %.3f ms round trip on average, %.3f ms at best, %.3f ms of it on the server\n"
+        , repeatCount
+        , totalMilliseconds / repeatCount
+        , fastestMilliseconds
+        , totalServerMicroseconds / 1000.0 / repeatCount);
+
+    Ascii::OutputWriter writer;
+    Bitmap::FileHandlingErrors error = outputFileName ? writer.open(outputFileName) : writer.openStandardOutput();
+
+    if (error == Bitmap::FileHandlingErrors::OK)
+    {
+        writer.write(response.text, response.textSize);
+        error = writer.close();
+    }
+
+    return reportWriteResult(outputFileName ? outputFileName : "stdout", error) ? 0 : 1;
 }
 
-int main()
+int main(int argc, char* argv[])
 {
+    // usage: PictureToAsciiArt [--mapped | --stream | --luma] [--kernel scalar|sse2|avx2] [--ramp glyphs] [--threads count]
+    //                          [--colour 256|24bit] [--dither ordered|floyd-steinberg] [--shapes]
+    //                          [--width columns [--aspect glyphHeightOverWidth]] [--crop x,y,width,height] [--flip] [--rotate 90|270]
+    //                          [--metrics file.json [--metrics-total-only]]
+    //                          [--cache directory [--cache-size megabytes]]
+    //                          [sourceFile.bmp outputFile.txt | --batch directoryOrFileList [--output-dir directory] [--pipeline]
+    //                           | --sequence directoryOrFileList [--sequence-output file]]
+    //                          [--serve socketPath | --client socketPath [--send-bitmap] [--repeat count] [--shutdown]]
+    ImageSource imageSource = ImageSource::LoadedCanvas;
+    Ascii::GlyphRowKernel::InstructionSet instructionSet = Ascii::GlyphRowKernel::getBestAvailableInstructionSet();
+    char const* customGlyphs = nullptr;
+    unsigned int threadCount = 0; // one per hardware thread
+    unsigned int targetColumns = 0; // full size
+
+    // ordered dithering is part of the kernel, so it works everywhere the kernel does. Error diffusion is single images only
+    Ascii::GlyphRowKernel::Dithering dithering = Ascii::GlyphRowKernel::Dithering::None;
+    bool errorDiffusion = false;
+
+    // plain text unless a colour mode is asked for
+    bool colourOutput = false;
+    Ascii::AnsiColourConverter::ColourMode colourMode = Ascii::AnsiColourConverter::ColourMode::Palette256;
+    float cellAspect = c_defaultCellAspect;
+
+    // glyphs picked by shape from the built in atlas, one per 8x16 cell of the (downscaled) image
+    bool shapeMatching = false;
+
+    // cropped, flipped and rotated before anything else, crop coordinates are from the top left of the source. Only the
+    // rows and columns of the crop are read
+    Orientation orientation = { Bitmap::ImageRegion(), false, Bitmap::ImageRotator::Rotation::None };
+
+    char const* sourceFileName = nullptr;
+    char const* outputFileName = nullptr;
+
+    char const* batchInput = nullptr;
+    char const* batchOutputDirectory = nullptr;
+    bool pipelinedBatch = false;
+
+    // frames played as a terminal animation, to stdout unless there's an output file
+    char const* sequenceInput = nullptr;
+    char const* sequenceOutputFileName = nullptr;
+
+    // per stage timings and counters, per image unless only the total is wanted
+    char const* metricsFileName = nullptr;
+    bool metricsTotalOnly = false;
+
+    // converted text kept between runs, least recently used evicted past the size
+    char const* cacheDirectory = nullptr;
+    unsigned long long cacheSizeMegabytes = 256;
+
+    // run as a server that stays up between images, or send images to one
+    char const* serveSocketPath = nullptr;
+    char const* clientSocketPath = nullptr;
+    Server::Command clientCommand = Server::Command::ConvertFile;
+    unsigned int clientRepeatCount = 1;
+
+    for (int i = 1; i < argc; ++i)
     {
-        char const* const sourceFileName = "TestImages\\imageToLoad.bmp";
-        char const* const outputFileName = "TestImages\\imageToLoad.txt";
+        if (strcmp(argv[i], "--mapped") == 0)
+        {
+            imageSource = ImageSource::MappedFile;
+        }
+        else if (strcmp(argv[i], "--stream") == 0)
+        {
+            imageSource = ImageSource::StreamedScanlines;
+        }
+        else if (strcmp(argv[i], "--luma") == 0)
+        {
+            imageSource = ImageSource::LumaCanvas;
+        }
+        else if (strcmp(argv[i], "--kernel") == 0 && i + 1 < argc)
+        {
+            char const* const kernelName = argv[++i];
+
+            if (strcmp(kernelName, "scalar") == 0) { instructionSet = Ascii::GlyphRowKernel::InstructionSet::Scalar; }
+            else if (strcmp(kernelName, "sse2") == 0) { instructionSet = Ascii::GlyphRowKernel::InstructionSet::Sse2; }
+            else if (strcmp(kernelName, "avx2") == 0) { instructionSet = Ascii::GlyphRowKernel::InstructionSet::Avx2; }
+            else
+            {
+                printf("Unknown kernel \"%s\", expected scalar, sse2 or avx2\n", kernelName);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--colour") == 0 && i + 1 < argc)
+        {
+            char const* const colourName = argv[++i];
+
+            colourOutput = true;
+
+            if (strcmp(colourName, "256") == 0) { colourMode = Ascii::AnsiColourConverter::ColourMode::Palette256; }
+            else if (strcmp(colourName, "24bit") == 0) { colourMode = Ascii::AnsiColourConverter::ColourMode::TrueColour; }
+            else
+            {
+                printf("Unknown colour mode \"%s\", expected 256 or 24bit\n", colourName);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--dither") == 0 && i + 1 < argc)
+        {
+            char const* const ditherName = argv[++i];
 
-        pixelToAscii(sourceFileName, outputFileName);
+            if (strcmp(ditherName, "ordered") == 0) { dithering = Ascii::GlyphRowKernel::Dithering::Ordered; }
+            else if (strcmp(ditherName, "floyd-steinberg") == 0) { errorDiffusion = true; }
+            else
+            {
+                printf("Unknown dithering \"%s\", expected ordered or floyd-steinberg\n", ditherName);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--shapes") == 0)
+        {
+            shapeMatching = true;
+        }
+        else if (strcmp(argv[i], "--ramp") == 0 && i + 1 < argc)
+        {
+            customGlyphs = argv[++i];
+        }
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+        {
+            threadCount = static_cast<unsigned int>(atoi(argv[++i]));
+        }
+        else if (strcmp(argv[i], "--width") == 0 && i + 1 < argc)
+        {
+            targetColumns = static_cast<unsigned int>(atoi(argv[++i]));
+        }
+        else if (strcmp(argv[i], "--aspect") == 0 && i + 1 < argc)
+        {
+            cellAspect = static_cast<float>(atof(argv[++i]));
+        }
+        else if (strcmp(argv[i], "--crop") == 0 && i + 1 < argc)
+        {
+            char const* const cropText = argv[++i];
+            Bitmap::ImageRegion& crop = orientation.crop;
+
+            if (sscanf(cropText, "%u,%u,%u,%u", &crop.x, &crop.y, &crop.width, &crop.height) != 4)
+            {
+                printf("Couldn't read the crop \"%s\", expected x,y,width,height\n", cropText);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--flip") == 0)
+        {
+            orientation.flipVertically = true;
+        }
+        else if (strcmp(argv[i], "--rotate") == 0 && i + 1 < argc)
+        {
+            char const* const degrees = argv[++i];
+
+            if (strcmp(degrees, "90") == 0) { orientation.rotation = Bitmap::ImageRotator::Rotation::Clockwise; }
+            else if (strcmp(degrees, "270") == 0) { orientation.rotation = Bitmap::ImageRotator::Rotation::Anticlockwise; }
+            else
+            {
+                printf("Can't rotate by \"%s\", only 90 or 270 degrees\n", degrees);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc)
+        {
+            batchInput = argv[++i];
+        }
+        else if (strcmp(argv[i], "--output-dir") == 0 && i + 1 < argc)
+        {
+            batchOutputDirectory = argv[++i];
+        }
+        else if (strcmp(argv[i], "--pipeline") == 0)
+        {
+            pipelinedBatch = true;
+        }
+        else if (strcmp(argv[i], "--sequence") == 0 && i + 1 < argc)
+        {
+            sequenceInput = argv[++i];
+        }
+        else if (strcmp(argv[i], "--sequence-output") == 0 && i + 1 < argc)
+        {
+            sequenceOutputFileName = argv[++i];
+        }
+        else if (strcmp(argv[i], "--metrics") == 0 && i + 1 < argc)
+        {
+            metricsFileName = argv[++i];
+        }
+        else if (strcmp(argv[i], "--metrics-total-only") == 0)
+        {
+            metricsTotalOnly = true;
+        }
+        else if (strcmp(argv[i], "--cache") == 0 && i + 1 < argc)
+        {
+            cacheDirectory = argv[++i];
+        }
+        else if (strcmp(argv[i], "--cache-size") == 0 && i + 1 < argc)
+        {
+            cacheSizeMegabytes = strtoull(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "--serve") == 0 && i + 1 < argc)
+        {
+            serveSocketPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--client") == 0 && i + 1 < argc)
+        {
+            clientSocketPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--send-bitmap") == 0)
+        {
+            clientCommand = Server::Command::ConvertBitmap;
+        }
+        else if (strcmp(argv[i], "--shutdown") == 0)
+        {
+            clientCommand = Server::Command::Shutdown;
+        }
+        else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc)
+        {
+            clientRepeatCount = static_cast<unsigned int>(atoi(argv[++i]));
+        }
+        else if (sourceFileName == nullptr)
+        {
+            sourceFileName = argv[i];
+        }
+        else
+        {
+            outputFileName = argv[i];
+        }
+    }
+
+    // custom ramps have their lookup table built once here, the default one was built at compile time
+    Ascii::GlyphRamp const customRamp(customGlyphs ? customGlyphs : "");
+    Ascii::GlyphRamp const& ramp = customGlyphs ? customRamp : Ascii::GlyphRamp::getDefault();
+
+    if (serveSocketPath)
+    {
+        // builds every converter a request can ask for, up front
+        Server::ConversionServer server(ramp, c_charactersPerPixel, instructionSet, threadCount);
+
+        if (!server.run(serveSocketPath))
+        {
+            printf("Couldn't listen on \"%s\"\n", serveSocketPath);
+            return 1;
+        }
+
+        return 0;
+    }
+
+    if (clientSocketPath)
+    {
+        if (!orientation.isIdentity())
+        {
+            fprintf(stderr, "The server converts images as they are, cropping, flipping and rotating are ignored\n");
+        }
+
+        Server::ConversionOptions options;
+        options.dithering = errorDiffusion ? Server::Dithering::FloydSteinberg : dithering == Ascii::GlyphRowKernel::Dithering::Ordered ? Server::Dithering::Ordered : Server::Dithering::None;
+        options.colourOutput = !colourOutput ? Server::ColourOutput::None : colourMode == Ascii::AnsiColourConverter::ColourMode::Palette256 ? Server::ColourOutput::Palette256 : Server::ColourOutput::TrueColour;
+        options.shapeMatching = shapeMatching;
+        options.targetColumns = targetColumns;
+        options.cellAspect = cellAspect;
+
+        return runClient(clientSocketPath, clientCommand, options, clientRepeatCount, sourceFileName, outputFileName);
+    }
+
+    Ascii::GlyphRowKernel const kernel(ramp, c_charactersPerPixel, instructionSet, dithering);
+
+    // nothing is timed unless there's somewhere to put it
+    Instrumentation::MetricsReport metricsReport(!metricsTotalOnly);
+
+    if (metricsFileName && !metricsReport.open(metricsFileName))
+    {
+        printf("Couldn't open the metrics file \"%s\"\n", metricsFileName);
+        return 1;
+    }
+
+    Instrumentation::MetricsReport* const activeMetricsReport = metricsFileName ? &metricsReport : nullptr;
+    std::chrono::steady_clock::time_point const startTime = std::chrono::steady_clock::now();
+
+    if (shapeMatching && (batchInput || sequenceInput))
+    {
+        // stderr, stdout may be where the frames are going
+        fprintf(stderr, "Shape matching is for single images, converting with the ramp\n");
+        shapeMatching = false;
+    }
+
+    if (!orientation.isIdentity() && batchInput)
+    {
+        printf("Cropping, flipping and rotating are for single images and sequences, converting as they are\n");
+        orientation = Orientation{ Bitmap::ImageRegion(), false, Bitmap::ImageRotator::Rotation::None };
+    }
+
+    // batches only ever convert colour images with the kernel, so that's all that goes into their keys
+    bool const keyedByKernelOnly = batchInput != nullptr;
+
+    unsigned long long const settingsHash = hashOutputSettings(kernel
+        , imageSource == ImageSource::LumaCanvas && !keyedByKernelOnly
+        , errorDiffusion && !keyedByKernelOnly
+        , colourOutput && !keyedByKernelOnly ? static_cast<int>(colourMode) : -1
+        , shapeMatching
+        , targetColumns
+        , cellAspect
+        , orientation);
+
+    Cache::ResultCache resultCache(settingsHash, cacheSizeMegabytes * 1024 * 1024);
+    resultCache.setRegion(orientation.crop);
+
+    if (cacheDirectory && !resultCache.open(cacheDirectory))
+    {
+        printf("Couldn't open the cache directory \"%s\"\n", cacheDirectory);
+        return 1;
+    }
+
+    // frame sequences always convert, there's no output file to copy into
+    Cache::ResultCache* const activeResultCache = cacheDirectory && !sequenceInput ? &resultCache : nullptr;
+
+    if (batchInput)
+    {
+        int const result = runBatch(kernel, imageSource, threadCount, targetColumns, cellAspect, pipelinedBatch, batchInput, batchOutputDirectory, activeMetricsReport, activeResultCache);
+
+        reportResultCache(activeResultCache);
+        closeMetricsReport(activeMetricsReport, metricsFileName, startTime);
+
+        return result;
+    }
+
+    Ascii::OutputWriter writer;
+
+    Bitmap::CanvasPool canvasPool;
+
+    // takes its glyphs from the same ramp as the plain text
+    Ascii::AnsiColourConverter const colourConverter(ramp, c_charactersPerPixel, colourMode);
+
+    Ascii::ErrorDiffusionConverter errorDiffusionConverter(ramp, c_charactersPerPixel);
+
+    Ascii::ShapeMatchConverter const shapeConverter(Ascii::GlyphAtlas::getDefault());
+
+    ConversionSettings settings = { &kernel, nullptr, colourOutput ? &colourConverter : nullptr, errorDiffusion ? &errorDiffusionConverter : nullptr, shapeMatching ? &shapeConverter : nullptr, &writer, targetColumns, cellAspect, &canvasPool, activeMetricsReport, activeResultCache, orientation };
+
+    if (sequenceInput)
+    {
+        int const result = runSequence(settings, imageSource, sequenceInput, sequenceOutputFileName);
+
+        closeMetricsReport(activeMetricsReport, metricsFileName, startTime);
+
+        return result;
+    }
+
+    // the pool and its band buffers live for the whole run and are shared by every image
+    threadCount = Threading::ThreadPool::resolveThreadCount(threadCount);
+
+    std::unique_ptr<Threading::ThreadPool> threadPool;
+    std::unique_ptr<Ascii::ParallelConverter> parallelConverter;
+
+    if (threadCount > 1)
+    {
+        threadPool.reset(new Threading::ThreadPool(threadCount));
+        parallelConverter.reset(new Ascii::ParallelConverter(kernel, *threadPool));
+
+        settings.parallelConverter = parallelConverter.get();
     }
 
+    bool converted = true;
+
+    if (sourceFileName && outputFileName)
+    {
+        converted = convertImage(settings, sourceFileName, outputFileName, imageSource);
+    }
+    else
     {
-        char const* const sourceFileName = "TestImages\\imageToLoad2.bmp";
-        char const* const outputFileName = "TestImages\\imageToLoad2.txt";
+        {
+            char const* const sourceFileName = "TestImages\\imageToLoad.bmp";
+            char const* const outputFileName = "TestImages\\imageToLoad.txt";
+
+            converted = convertImage(settings, sourceFileName, outputFileName, imageSource) && converted;
+        }
 
-        pixelToAscii(sourceFileName, outputFileName);
+        {
+            char const* const sourceFileName = "TestImages\\imageToLoad2.bmp";
+            char const* const outputFileName = "TestImages\\imageToLoad2.txt";
+
+            converted = convertImage(settings, sourceFileName, outputFileName, imageSource) && converted;
+        }
     }
 
-    return 0;
+    reportResultCache(activeResultCache);
+    closeMetricsReport(activeMetricsReport, metricsFileName, startTime);
+
+    return converted ? 0 : 1;
 }
\ No newline at end of file
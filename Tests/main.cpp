@@ -0,0 +1,121 @@
+// checks the converter still gives expected_output: both test images are converted with the default settings, and again
+// through each image source, on several threads and with every instruction set the CPU has. Each result is compared
+// byte for byte with expected_output/*.txt, and any difference exits with 1. The solution runs it after every build,
+// on Linux:
+//   g++ -std=c++17 Tests/main.cpp PictureToAsciiArt/Ascii/CpuFeatures.cpp -o CompareExpectedOutput
+//   ./CompareExpectedOutput path/to/PictureToAsciiArt PictureToAsciiArt
+//
+// usage: Tests converterExecutable projectDirectory
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <fstream>
+#include <iterator>
+#include <string>
+
+#include "../PictureToAsciiArt/Ascii/CpuFeatures.h"
+
+// written to the working directory, and removed again before each conversion
+char const* const c_outputFileName = "CompareExpectedOutput.txt";
+
+#ifdef _WIN32
+char const* const c_nullDevice = "nul";
+#else
+char const* const c_nullDevice = "/dev/null";
+#endif
+
+char const* const c_imageNames[] = { "imageToLoad", "imageToLoad2" };
+
+// no options at all is the default, the rest have to come out the same
+char const* const c_optionSets[] = { "", "--mapped", "--stream", "--threads 4", "--kernel scalar", "--kernel sse2", "--kernel avx2" };
+
+bool readWholeFile(std::string const& fileName, std::string& contents)
+{
+    std::ifstream file(fileName, std::ios::binary);
+
+    if (file)
+    {
+        contents.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+
+    return static_cast<bool>(file);
+}
+
+// an instruction set the CPU doesn't have would just crash the converter
+bool canRun(std::string const& options)
+{
+    bool canRun = true;
+
+    if (options == "--kernel sse2") { canRun = Ascii::CpuFeatures::hasSse2(); }
+    if (options == "--kernel avx2") { canRun = Ascii::CpuFeatures::hasAvx2(); }
+
+    return canRun;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc != 3)
+    {
+        fprintf(stderr, "usage: Tests converterExecutable projectDirectory\n");
+        return 2;
+    }
+
+    std::string const converter = argv[1];
+    std::string const projectDirectory = argv[2];
+
+    unsigned int failures = 0;
+
+    for (char const* const options : c_optionSets)
+    {
+        if (!canRun(options))
+        {
+            printf("skip [%s]: not supported by this CPU\n", options);
+            continue;
+        }
+
+        for (char const* const imageName : c_imageNames)
+        {
+            remove(c_outputFileName);
+
+            std::string command = "\"" + converter + "\" " + options + " \"" + projectDirectory + "/TestImages/" + imageName + ".bmp\" " + c_outputFileName + " > " + c_nullDevice;
+
+#ifdef _WIN32
+            // cmd takes the quotes off either end of a command that starts with one
+            command = "\"" + command + "\"";
+#endif
+
+            std::string output;
+            std::string expectedOutput;
+
+            if (system(command.c_str()) != 0 || !readWholeFile(c_outputFileName, output))
+            {
+                printf("FAIL %s [%s]: the converter failed\n", imageName, options);
+                ++failures;
+            }
+            else if (!readWholeFile(projectDirectory + "/expected_output/" + imageName + ".txt", expectedOutput))
+            {
+                printf("FAIL %s [%s]: can't read expected_output/%s.txt\n", imageName, options, imageName);
+                ++failures;
+            }
+            else if (output != expectedOutput)
+            {
+                printf("FAIL %s [%s]: differs from expected_output/%s.txt\n", imageName, options, imageName);
+                ++failures;
+            }
+            else
+            {
+                printf("ok   %s [%s]\n", imageName, options);
+            }
+        }
+    }
+
+    remove(c_outputFileName);
+
+    if (failures > 0)
+    {
+        printf("%u conversions didn't match\n", failures);
+    }
+
+    return failures > 0 ? 1 : 0;
+}